@@ -0,0 +1,898 @@
+/**
+ * \file BTreeMap.tcc
+ **/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+namespace atl
+{
+
+    /**
+     * \brief Ordered map stored as a B+tree
+     *
+     * Inner nodes hold only keys and child pointers so that a lookup touches
+     * a handful of contiguous nodes instead of one red-black node per level.
+     * Leaves hold the key-value pairs in order and are linked to their
+     * neighbours, so in-order iteration is a walk over contiguous arrays.
+     *
+     * The interface is the subset of std::map used by TSMap. Iterators are
+     * invalidated by any insertion or erasure, except that the iterator
+     * returned by erase(iterator) is valid.
+     *
+     * \tparam Key       Key type; must be default constructible
+     * \tparam Value     Mapped type; must be default constructible
+     * \tparam Compare   Strict weak ordering of keys
+     * \tparam NodeBytes Target size of a node in bytes. The fanout of inner
+     *                   and leaf nodes is derived from it (minimum 4).
+     */
+    template<typename Key, typename Value, typename Compare = std::less<Key>,
+             size_t NodeBytes = 256> class BTreeMap
+    {
+        public:
+            typedef Key                     key_type;
+            typedef Value                   mapped_type;
+            typedef std::pair<Key, Value>   value_type;
+            typedef Compare                 key_compare;
+            typedef size_t                  size_type;
+
+            static const size_t LEAF_SLOTS = NodeBytes / sizeof(value_type) > 4 ?
+                                             NodeBytes / sizeof(value_type) : 4;
+            static const size_t INNER_SLOTS = NodeBytes / (sizeof(Key) + sizeof(void*)) > 4 ?
+                                              NodeBytes / (sizeof(Key) + sizeof(void*)) : 4;
+
+        protected:
+            struct Node {
+                bool     leaf;
+                unsigned count;         //!< Number of keys (pairs for leaves)
+            };
+
+            struct Leaf : public Node {
+                value_type  slots[LEAF_SLOTS];
+                Leaf*       prev;
+                Leaf*       next;
+            };
+
+            struct Inner : public Node {
+                Key         keys[INNER_SLOTS];
+                Node*       children[INNER_SLOTS + 1];
+            };
+
+            template<bool Const> class Iter;
+
+        public:
+            typedef Iter<false> iterator;
+            typedef Iter<true>  const_iterator;
+
+            explicit BTreeMap(const Compare& comp = Compare());
+            BTreeMap(BTreeMap&& other);
+            BTreeMap(const BTreeMap&) = delete;
+            BTreeMap& operator=(const BTreeMap&) = delete;
+            ~BTreeMap();
+
+            iterator        begin();
+            iterator        end();
+            const_iterator  begin() const;
+            const_iterator  end() const;
+            const_iterator  cbegin() const { return begin(); }
+            const_iterator  cend() const { return end(); }
+
+            size_t          size() const { return m_size; }
+            bool            empty() const { return m_size == 0; }
+            size_t          node_count() const { return m_leaves + m_inners; }
+            size_t          memory_usage() const;
+            key_compare     key_comp() const { return m_comp; }
+
+            iterator        find(const Key& k);
+            const_iterator  find(const Key& k) const;
+            size_t          count(const Key& k) const;
+            iterator        lower_bound(const Key& k);
+            const_iterator  lower_bound(const Key& k) const;
+            iterator        upper_bound(const Key& k);
+            const_iterator  upper_bound(const Key& k) const;
+
+            template<typename... Args>
+            std::pair<iterator, bool> emplace(Args&&... args);
+            template<typename... Args>
+            iterator        emplace_hint(const_iterator hint, Args&&... args);
+            std::pair<iterator, bool> insert(value_type v);
+            Value&          operator[](const Key& k);
+
+            size_t          erase(const Key& k);
+            iterator        erase(iterator it);
+            void            clear();
+            void            swap(BTreeMap& other);
+
+        protected:
+            struct Split {
+                Node*   right = nullptr;    //!< New right sibling, null if no split
+                Key     separator;          //!< Smallest key reachable in right
+            };
+
+            bool    less(const Key& a, const Key& b) const { return m_comp(a, b); }
+            bool    equal(const Key& a, const Key& b) const { return !m_comp(a, b) && !m_comp(b, a); }
+            unsigned leafLowerBound(const Leaf* leaf, const Key& k) const;
+            unsigned leafUpperBound(const Leaf* leaf, const Key& k) const;
+            unsigned innerChildIndex(const Inner* inner, const Key& k) const;
+            Leaf*   findLeaf(const Key& k) const;
+
+            Split   insertInto(Node* node, value_type&& v, Leaf*& outLeaf, unsigned& outIdx, bool& inserted);
+            Split   insertIntoLeaf(Leaf* leaf, value_type&& v, Leaf*& outLeaf, unsigned& outIdx, bool& inserted);
+            bool    eraseFrom(Node* node, const Key& k);
+            void    rebalance(Inner* parent, unsigned idx);
+            void    freeNode(Node* node);
+
+            Leaf*   newLeaf();
+            Inner*  newInner();
+
+            Node*   m_root;
+            Leaf*   m_head;         //!< Leftmost leaf
+            Leaf*   m_tail;         //!< Rightmost leaf
+            size_t  m_size = 0;
+            size_t  m_leaves = 0;
+            size_t  m_inners = 0;
+            Compare m_comp;
+
+            static const unsigned LEAF_MIN = LEAF_SLOTS / 2;
+            static const unsigned INNER_MIN = INNER_SLOTS / 2;
+    };
+
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    const size_t BTreeMap<Key, Value, Compare, NodeBytes>::LEAF_SLOTS;
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    const size_t BTreeMap<Key, Value, Compare, NodeBytes>::INNER_SLOTS;
+
+    /**
+     * \brief Bidirectional iterator over the leaf chain
+     *
+     * An iterator is a leaf and a slot index. end() is one past the last
+     * slot of the rightmost leaf so that it can be decremented.
+     */
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    template<bool Const> class BTreeMap<Key, Value, Compare, NodeBytes>::Iter
+    {
+        friend class BTreeMap;
+        public:
+            typedef std::bidirectional_iterator_tag iterator_category;
+            typedef typename BTreeMap::value_type   value_type;
+            typedef std::ptrdiff_t                  difference_type;
+            typedef typename std::conditional<Const, const value_type*, value_type*>::type pointer;
+            typedef typename std::conditional<Const, const value_type&, value_type&>::type reference;
+            typedef typename std::conditional<Const, const Leaf*, Leaf*>::type leaf_pointer;
+
+            Iter() : m_leaf(nullptr), m_idx(0) {}
+            Iter(leaf_pointer leaf, unsigned idx) : m_leaf(leaf), m_idx(idx) {}
+            // Allow iterator -> const_iterator; a template, so it is never
+            // the copy constructor of iterator
+            template<bool C, typename std::enable_if<Const && !C, int>::type = 0>
+            Iter(const Iter<C>& other) : m_leaf(other.m_leaf), m_idx(other.m_idx) {}
+
+            reference operator*() const { return m_leaf->slots[m_idx]; }
+            pointer operator->() const { return &m_leaf->slots[m_idx]; }
+
+            Iter& operator++()
+            {
+                if (++m_idx == m_leaf->count && m_leaf->next) {
+                    m_leaf = m_leaf->next;
+                    m_idx = 0;
+                }
+                return *this;
+            }
+            Iter operator++(int) { Iter t = *this; ++*this; return t; }
+
+            Iter& operator--()
+            {
+                if (m_idx == 0) {
+                    m_leaf = m_leaf->prev;
+                    m_idx = m_leaf->count;
+                }
+                m_idx--;
+                return *this;
+            }
+            Iter operator--(int) { Iter t = *this; --*this; return t; }
+
+            bool operator==(const Iter& o) const { return m_leaf == o.m_leaf && m_idx == o.m_idx; }
+            bool operator!=(const Iter& o) const { return !(*this == o); }
+
+        private:
+            leaf_pointer m_leaf;
+            unsigned     m_idx;
+            friend class Iter<!Const>;
+    };
+
+    /**
+     * \brief Constructor. Creates an empty root leaf.
+     * \param [in] comp The key comparison object
+     **/
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    BTreeMap<Key, Value, Compare, NodeBytes>::BTreeMap(const Compare& comp)
+        : m_comp(comp)
+    {
+        m_head = m_tail = newLeaf();
+        m_root = m_head;
+    }
+
+    /**
+     * \brief Move constructor. Leaves other as a valid empty map.
+     **/
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    BTreeMap<Key, Value, Compare, NodeBytes>::BTreeMap(BTreeMap&& other)
+        : m_comp(other.m_comp)
+    {
+        m_head = m_tail = newLeaf();
+        m_root = m_head;
+        swap(other);
+    }
+
+    /**
+     * \brief Destructor. Frees every node.
+     **/
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    BTreeMap<Key, Value, Compare, NodeBytes>::~BTreeMap()
+    {
+        freeNode(m_root);
+    }
+
+    ////////////////////////////////////////
+    //             ITERATORS              //
+    ////////////////////////////////////////
+
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    typename BTreeMap<Key, Value, Compare, NodeBytes>::iterator
+    BTreeMap<Key, Value, Compare, NodeBytes>::begin()
+    {
+        return m_size ? iterator(m_head, 0) : end();
+    }
+
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    typename BTreeMap<Key, Value, Compare, NodeBytes>::iterator
+    BTreeMap<Key, Value, Compare, NodeBytes>::end()
+    {
+        return iterator(m_tail, m_tail->count);
+    }
+
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    typename BTreeMap<Key, Value, Compare, NodeBytes>::const_iterator
+    BTreeMap<Key, Value, Compare, NodeBytes>::begin() const
+    {
+        return m_size ? const_iterator(m_head, 0) : end();
+    }
+
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    typename BTreeMap<Key, Value, Compare, NodeBytes>::const_iterator
+    BTreeMap<Key, Value, Compare, NodeBytes>::end() const
+    {
+        return const_iterator(m_tail, m_tail->count);
+    }
+
+    ////////////////////////////////////////
+    //              LOOKUP                //
+    ////////////////////////////////////////
+
+    /**
+     * \brief Index of the first slot in the leaf whose key is not less than k
+     **/
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    unsigned BTreeMap<Key, Value, Compare, NodeBytes>::leafLowerBound(const Leaf* leaf, const Key& k) const
+    {
+        unsigned lo = 0, hi = leaf->count;
+        while (lo < hi) {
+            unsigned mid = (lo + hi) / 2;
+            if (less(leaf->slots[mid].first, k)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    /**
+     * \brief Index of the first slot in the leaf whose key is greater than k
+     **/
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    unsigned BTreeMap<Key, Value, Compare, NodeBytes>::leafUpperBound(const Leaf* leaf, const Key& k) const
+    {
+        unsigned lo = 0, hi = leaf->count;
+        while (lo < hi) {
+            unsigned mid = (lo + hi) / 2;
+            if (!less(k, leaf->slots[mid].first)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    /**
+     * \brief Index of the child of an inner node that may contain k
+     *
+     * Separator i is the smallest key reachable through child i+1, so the
+     * child index is the number of separators not greater than k.
+     **/
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    unsigned BTreeMap<Key, Value, Compare, NodeBytes>::innerChildIndex(const Inner* inner, const Key& k) const
+    {
+        unsigned lo = 0, hi = inner->count;
+        while (lo < hi) {
+            unsigned mid = (lo + hi) / 2;
+            if (!less(k, inner->keys[mid])) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    /**
+     * \brief Descends from the root to the leaf that may contain k
+     **/
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    typename BTreeMap<Key, Value, Compare, NodeBytes>::Leaf*
+    BTreeMap<Key, Value, Compare, NodeBytes>::findLeaf(const Key& k) const
+    {
+        Node* node = m_root;
+        while (!node->leaf) {
+            Inner* inner = static_cast<Inner*>(node);
+            node = inner->children[innerChildIndex(inner, k)];
+        }
+        return static_cast<Leaf*>(node);
+    }
+
+    /**
+     * \brief Finds the entry with key k
+     * \return iterator to the entry or end() if not present
+     **/
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    typename BTreeMap<Key, Value, Compare, NodeBytes>::iterator
+    BTreeMap<Key, Value, Compare, NodeBytes>::find(const Key& k)
+    {
+        Leaf* leaf = findLeaf(k);
+        unsigned i = leafLowerBound(leaf, k);
+        if (i < leaf->count && !less(k, leaf->slots[i].first)) {
+            return iterator(leaf, i);
+        }
+        return end();
+    }
+
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    typename BTreeMap<Key, Value, Compare, NodeBytes>::const_iterator
+    BTreeMap<Key, Value, Compare, NodeBytes>::find(const Key& k) const
+    {
+        return const_cast<BTreeMap*>(this)->find(k);
+    }
+
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    size_t BTreeMap<Key, Value, Compare, NodeBytes>::count(const Key& k) const
+    {
+        return find(k) != end() ? 1 : 0;
+    }
+
+    /**
+     * \brief Finds the first entry whose key is not less than k
+     * \return iterator to the entry or end() if there is none
+     **/
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    typename BTreeMap<Key, Value, Compare, NodeBytes>::iterator
+    BTreeMap<Key, Value, Compare, NodeBytes>::lower_bound(const Key& k)
+    {
+        Leaf* leaf = findLeaf(k);
+        unsigned i = leafLowerBound(leaf, k);
+        if (i == leaf->count && leaf->next) {
+            return iterator(leaf->next, 0);
+        }
+        return iterator(leaf, i);
+    }
+
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    typename BTreeMap<Key, Value, Compare, NodeBytes>::const_iterator
+    BTreeMap<Key, Value, Compare, NodeBytes>::lower_bound(const Key& k) const
+    {
+        return const_cast<BTreeMap*>(this)->lower_bound(k);
+    }
+
+    /**
+     * \brief Finds the first entry whose key is greater than k
+     * \return iterator to the entry or end() if there is none
+     **/
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    typename BTreeMap<Key, Value, Compare, NodeBytes>::iterator
+    BTreeMap<Key, Value, Compare, NodeBytes>::upper_bound(const Key& k)
+    {
+        Leaf* leaf = findLeaf(k);
+        unsigned i = leafUpperBound(leaf, k);
+        if (i == leaf->count && leaf->next) {
+            return iterator(leaf->next, 0);
+        }
+        return iterator(leaf, i);
+    }
+
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    typename BTreeMap<Key, Value, Compare, NodeBytes>::const_iterator
+    BTreeMap<Key, Value, Compare, NodeBytes>::upper_bound(const Key& k) const
+    {
+        return const_cast<BTreeMap*>(this)->upper_bound(k);
+    }
+
+    /**
+     * \brief Estimated heap footprint of the tree in bytes
+     **/
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    size_t BTreeMap<Key, Value, Compare, NodeBytes>::memory_usage() const
+    {
+        return sizeof(*this) + m_leaves * sizeof(Leaf) + m_inners * sizeof(Inner);
+    }
+
+    ////////////////////////////////////////
+    //             INSERTION              //
+    ////////////////////////////////////////
+
+    /**
+     * \brief Constructs a value_type from args and inserts it if its key
+     *        is not already present
+     *
+     * Accepts the same arguments as std::map::emplace, including
+     * std::piecewise_construct.
+     *
+     * \return iterator to the entry with that key and true if it was inserted
+     **/
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    template<typename... Args>
+    std::pair<typename BTreeMap<Key, Value, Compare, NodeBytes>::iterator, bool>
+    BTreeMap<Key, Value, Compare, NodeBytes>::emplace(Args&&... args)
+    {
+        return insert(value_type(std::forward<Args>(args)...));
+    }
+
+    /**
+     * \brief Constructs a value_type from args and inserts it at hint
+     *
+     * If hint is lower_bound() of the new key, falls inside a leaf and that
+     * leaf has room, the value is shifted into place without descending
+     * from the root. Otherwise this is the same as emplace().
+     *
+     * \return iterator to the entry with that key
+     **/
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    template<typename... Args>
+    typename BTreeMap<Key, Value, Compare, NodeBytes>::iterator
+    BTreeMap<Key, Value, Compare, NodeBytes>::emplace_hint(const_iterator hint, Args&&... args)
+    {
+        value_type v(std::forward<Args>(args)...);
+        Leaf* leaf = const_cast<Leaf*>(hint.m_leaf);
+        unsigned idx = hint.m_idx;
+
+        // Separators may lag behind deletions, so a key is only known to
+        // belong to this leaf if it lands strictly between two of its slots
+        // or at the open end of the first or last leaf.
+        bool fits = leaf->count < LEAF_SLOTS
+            && (idx > 0 ? less(leaf->slots[idx - 1].first, v.first) : !leaf->prev)
+            && (idx < leaf->count ? less(v.first, leaf->slots[idx].first) : !leaf->next);
+        if (!fits) {
+            return insert(std::move(v)).first;
+        }
+
+        std::move_backward(leaf->slots + idx, leaf->slots + leaf->count,
+                           leaf->slots + leaf->count + 1);
+        leaf->slots[idx] = std::move(v);
+        leaf->count++;
+        m_size++;
+        return iterator(leaf, idx);
+    }
+
+    /**
+     * \brief Inserts v if its key is not already present
+     * \return iterator to the entry with that key and true if it was inserted
+     **/
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    std::pair<typename BTreeMap<Key, Value, Compare, NodeBytes>::iterator, bool>
+    BTreeMap<Key, Value, Compare, NodeBytes>::insert(value_type v)
+    {
+        Leaf* leaf = nullptr;
+        unsigned idx = 0;
+        bool inserted = false;
+
+        Split s = insertInto(m_root, std::move(v), leaf, idx, inserted);
+        if (s.right) {
+            Inner* root = newInner();
+            root->count = 1;
+            root->keys[0] = std::move(s.separator);
+            root->children[0] = m_root;
+            root->children[1] = s.right;
+            m_root = root;
+        }
+        if (inserted) {
+            m_size++;
+        }
+        return std::make_pair(iterator(leaf, idx), inserted);
+    }
+
+    /**
+     * \brief Returns the value for k, default-inserting it if not present
+     **/
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    Value& BTreeMap<Key, Value, Compare, NodeBytes>::operator[](const Key& k)
+    {
+        iterator it = find(k);
+        if (it == end()) {
+            it = insert(value_type(k, Value{})).first;
+        }
+        return it->second;
+    }
+
+    /**
+     * \brief Recursively inserts v below node
+     *
+     * Full nodes on the path are split after the child returns, and the
+     * split is reported to the caller so it can add the new sibling.
+     **/
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    typename BTreeMap<Key, Value, Compare, NodeBytes>::Split
+    BTreeMap<Key, Value, Compare, NodeBytes>::insertInto(Node* node, value_type&& v,
+            Leaf*& outLeaf, unsigned& outIdx, bool& inserted)
+    {
+        if (node->leaf) {
+            return insertIntoLeaf(static_cast<Leaf*>(node), std::move(v), outLeaf, outIdx, inserted);
+        }
+
+        Inner* inner = static_cast<Inner*>(node);
+        unsigned idx = innerChildIndex(inner, v.first);
+        Split child = insertInto(inner->children[idx], std::move(v), outLeaf, outIdx, inserted);
+        Split ret;
+        if (!child.right) {
+            return ret;
+        }
+
+        // Split a full node before adding the new separator
+        Inner* target = inner;
+        if (inner->count == INNER_SLOTS) {
+            unsigned mid = INNER_SLOTS / 2;
+            Inner* right = newInner();
+            right->count = INNER_SLOTS - mid - 1;
+            std::move(inner->keys + mid + 1, inner->keys + INNER_SLOTS, right->keys);
+            std::copy(inner->children + mid + 1, inner->children + INNER_SLOTS + 1, right->children);
+            ret.separator = std::move(inner->keys[mid]);
+            ret.right = right;
+            inner->count = mid;
+
+            if (idx > mid) {
+                target = right;
+                idx -= mid + 1;
+            }
+        }
+
+        std::move_backward(target->keys + idx, target->keys + target->count,
+                           target->keys + target->count + 1);
+        std::copy_backward(target->children + idx + 1, target->children + target->count + 1,
+                           target->children + target->count + 2);
+        target->keys[idx] = std::move(child.separator);
+        target->children[idx + 1] = child.right;
+        target->count++;
+        return ret;
+    }
+
+    /**
+     * \brief Inserts v into a leaf, splitting it if it is full
+     **/
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    typename BTreeMap<Key, Value, Compare, NodeBytes>::Split
+    BTreeMap<Key, Value, Compare, NodeBytes>::insertIntoLeaf(Leaf* leaf, value_type&& v,
+            Leaf*& outLeaf, unsigned& outIdx, bool& inserted)
+    {
+        Split ret;
+        unsigned idx = leafLowerBound(leaf, v.first);
+        if (idx < leaf->count && !less(v.first, leaf->slots[idx].first)) {
+            outLeaf = leaf;
+            outIdx = idx;
+            inserted = false;
+            return ret;
+        }
+
+        Leaf* target = leaf;
+        if (leaf->count == LEAF_SLOTS) {
+            // Appending to the last leaf leaves it full, so ascending inserts
+            // (timestamps, rebuilds) pack leaves instead of half-filling them
+            unsigned mid = (leaf == m_tail && idx == LEAF_SLOTS) ? LEAF_SLOTS : LEAF_SLOTS / 2;
+            Leaf* right = newLeaf();
+            right->count = LEAF_SLOTS - mid;
+            std::move(leaf->slots + mid, leaf->slots + LEAF_SLOTS, right->slots);
+            leaf->count = mid;
+
+            right->next = leaf->next;
+            right->prev = leaf;
+            if (leaf->next) {
+                leaf->next->prev = right;
+            } else {
+                m_tail = right;
+            }
+            leaf->next = right;
+
+            if (idx > mid || mid == LEAF_SLOTS) {
+                target = right;
+                idx -= mid;
+            }
+            ret.right = right;
+        }
+
+        std::move_backward(target->slots + idx, target->slots + target->count,
+                           target->slots + target->count + 1);
+        target->slots[idx] = std::move(v);
+        target->count++;
+
+        if (ret.right) {
+            ret.separator = static_cast<Leaf*>(ret.right)->slots[0].first;
+        }
+        outLeaf = target;
+        outIdx = idx;
+        inserted = true;
+        return ret;
+    }
+
+    ////////////////////////////////////////
+    //              ERASURE               //
+    ////////////////////////////////////////
+
+    /**
+     * \brief Erases the entry with key k
+     * \return the number of entries erased (0 or 1)
+     **/
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    size_t BTreeMap<Key, Value, Compare, NodeBytes>::erase(const Key& k)
+    {
+        if (!eraseFrom(m_root, k)) {
+            return 0;
+        }
+        m_size--;
+
+        // Collapse a root that has a single child
+        if (!m_root->leaf && m_root->count == 0) {
+            Inner* old = static_cast<Inner*>(m_root);
+            m_root = old->children[0];
+            delete old;
+            m_inners--;
+        }
+        return 1;
+    }
+
+    /**
+     * \brief Erases the entry at it
+     *
+     * When the leaf stays at least half full this is a shift within the leaf;
+     * otherwise the tree is rebalanced and the successor is looked up again.
+     *
+     * \return iterator to the entry following the erased one
+     **/
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    typename BTreeMap<Key, Value, Compare, NodeBytes>::iterator
+    BTreeMap<Key, Value, Compare, NodeBytes>::erase(iterator it)
+    {
+        Leaf* leaf = it.m_leaf;
+        unsigned idx = it.m_idx;
+
+        if (leaf == m_root || leaf->count > LEAF_MIN) {
+            std::move(leaf->slots + idx + 1, leaf->slots + leaf->count, leaf->slots + idx);
+            leaf->count--;
+            leaf->slots[leaf->count] = value_type();
+            m_size--;
+            if (idx == leaf->count && leaf->next) {
+                return iterator(leaf->next, 0);
+            }
+            return iterator(leaf, idx);
+        }
+
+        iterator next = it;
+        ++next;
+        bool hasNext = next != end();
+        Key nextKey = hasNext ? next->first : Key{};
+
+        erase(Key(it->first));
+        return hasNext ? lower_bound(nextKey) : end();
+    }
+
+    /**
+     * \brief Recursively erases k below node, fixing underfull children
+     * \return true if an entry was erased
+     **/
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    bool BTreeMap<Key, Value, Compare, NodeBytes>::eraseFrom(Node* node, const Key& k)
+    {
+        if (node->leaf) {
+            Leaf* leaf = static_cast<Leaf*>(node);
+            unsigned idx = leafLowerBound(leaf, k);
+            if (idx == leaf->count || less(k, leaf->slots[idx].first)) {
+                return false;
+            }
+            std::move(leaf->slots + idx + 1, leaf->slots + leaf->count, leaf->slots + idx);
+            leaf->count--;
+            leaf->slots[leaf->count] = value_type();
+            return true;
+        }
+
+        Inner* inner = static_cast<Inner*>(node);
+        unsigned idx = innerChildIndex(inner, k);
+        Node* child = inner->children[idx];
+        if (!eraseFrom(child, k)) {
+            return false;
+        }
+
+        unsigned minCount = child->leaf ? LEAF_MIN : INNER_MIN;
+        if (child->count < minCount) {
+            rebalance(inner, idx);
+        }
+        return true;
+    }
+
+    /**
+     * \brief Restores the minimum fill of parent's child idx by borrowing
+     *        from a sibling or merging with it
+     **/
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    void BTreeMap<Key, Value, Compare, NodeBytes>::rebalance(Inner* parent, unsigned idx)
+    {
+        Node* child = parent->children[idx];
+        Node* left = idx > 0 ? parent->children[idx - 1] : nullptr;
+        Node* right = idx < parent->count ? parent->children[idx + 1] : nullptr;
+
+        if (child->leaf) {
+            Leaf* c = static_cast<Leaf*>(child);
+            Leaf* l = static_cast<Leaf*>(left);
+            Leaf* r = static_cast<Leaf*>(right);
+
+            if (l && l->count > LEAF_MIN) {
+                std::move_backward(c->slots, c->slots + c->count, c->slots + c->count + 1);
+                c->slots[0] = std::move(l->slots[l->count - 1]);
+                l->slots[l->count - 1] = value_type();
+                l->count--;
+                c->count++;
+                parent->keys[idx - 1] = c->slots[0].first;
+                return;
+            }
+            if (r && r->count > LEAF_MIN) {
+                c->slots[c->count] = std::move(r->slots[0]);
+                std::move(r->slots + 1, r->slots + r->count, r->slots);
+                r->count--;
+                r->slots[r->count] = value_type();
+                c->count++;
+                parent->keys[idx] = r->slots[0].first;
+                return;
+            }
+
+            // Merge the right one of the pair into the left one
+            unsigned sep = l ? idx - 1 : idx;
+            Leaf* dst = l ? l : c;
+            Leaf* src = l ? c : r;
+            std::move(src->slots, src->slots + src->count, dst->slots + dst->count);
+            dst->count += src->count;
+            dst->next = src->next;
+            if (src->next) {
+                src->next->prev = dst;
+            } else {
+                m_tail = dst;
+            }
+            delete src;
+            m_leaves--;
+
+            std::move(parent->keys + sep + 1, parent->keys + parent->count, parent->keys + sep);
+            std::copy(parent->children + sep + 2, parent->children + parent->count + 1,
+                      parent->children + sep + 1);
+            parent->count--;
+            return;
+        }
+
+        Inner* c = static_cast<Inner*>(child);
+        Inner* l = static_cast<Inner*>(left);
+        Inner* r = static_cast<Inner*>(right);
+
+        if (l && l->count > INNER_MIN) {
+            std::move_backward(c->keys, c->keys + c->count, c->keys + c->count + 1);
+            std::copy_backward(c->children, c->children + c->count + 1, c->children + c->count + 2);
+            c->keys[0] = std::move(parent->keys[idx - 1]);
+            c->children[0] = l->children[l->count];
+            parent->keys[idx - 1] = std::move(l->keys[l->count - 1]);
+            l->count--;
+            c->count++;
+            return;
+        }
+        if (r && r->count > INNER_MIN) {
+            c->keys[c->count] = std::move(parent->keys[idx]);
+            c->children[c->count + 1] = r->children[0];
+            parent->keys[idx] = std::move(r->keys[0]);
+            std::move(r->keys + 1, r->keys + r->count, r->keys);
+            std::copy(r->children + 1, r->children + r->count + 1, r->children);
+            r->count--;
+            c->count++;
+            return;
+        }
+
+        // Merge the right one of the pair and the separator into the left one
+        unsigned sep = l ? idx - 1 : idx;
+        Inner* dst = l ? l : c;
+        Inner* src = l ? c : r;
+        dst->keys[dst->count] = std::move(parent->keys[sep]);
+        std::move(src->keys, src->keys + src->count, dst->keys + dst->count + 1);
+        std::copy(src->children, src->children + src->count + 1, dst->children + dst->count + 1);
+        dst->count += src->count + 1;
+        delete src;
+        m_inners--;
+
+        std::move(parent->keys + sep + 1, parent->keys + parent->count, parent->keys + sep);
+        std::copy(parent->children + sep + 2, parent->children + parent->count + 1,
+                  parent->children + sep + 1);
+        parent->count--;
+    }
+
+    /**
+     * \brief Removes every entry, leaving a single empty root leaf
+     **/
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    void BTreeMap<Key, Value, Compare, NodeBytes>::clear()
+    {
+        freeNode(m_root);
+        m_size = 0;
+        m_head = m_tail = newLeaf();
+        m_root = m_head;
+    }
+
+    /**
+     * \brief Exchanges the contents of two maps
+     **/
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    void BTreeMap<Key, Value, Compare, NodeBytes>::swap(BTreeMap& other)
+    {
+        std::swap(m_root, other.m_root);
+        std::swap(m_head, other.m_head);
+        std::swap(m_tail, other.m_tail);
+        std::swap(m_size, other.m_size);
+        std::swap(m_leaves, other.m_leaves);
+        std::swap(m_inners, other.m_inners);
+        std::swap(m_comp, other.m_comp);
+    }
+
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    void BTreeMap<Key, Value, Compare, NodeBytes>::freeNode(Node* node)
+    {
+        if (node->leaf) {
+            delete static_cast<Leaf*>(node);
+            m_leaves--;
+            return;
+        }
+        Inner* inner = static_cast<Inner*>(node);
+        for (unsigned i = 0; i <= inner->count; i++) {
+            freeNode(inner->children[i]);
+        }
+        delete inner;
+        m_inners--;
+    }
+
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    typename BTreeMap<Key, Value, Compare, NodeBytes>::Leaf*
+    BTreeMap<Key, Value, Compare, NodeBytes>::newLeaf()
+    {
+        Leaf* leaf = new Leaf();
+        leaf->leaf = true;
+        leaf->count = 0;
+        leaf->prev = nullptr;
+        leaf->next = nullptr;
+        m_leaves++;
+        return leaf;
+    }
+
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    typename BTreeMap<Key, Value, Compare, NodeBytes>::Inner*
+    BTreeMap<Key, Value, Compare, NodeBytes>::newInner()
+    {
+        Inner* inner = new Inner();
+        inner->leaf = false;
+        inner->count = 0;
+        m_inners++;
+        return inner;
+    }
+}
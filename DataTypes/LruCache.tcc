@@ -73,7 +73,7 @@ template<class K, class V> LruCache<K,V>::
 template<class K, class V> void LruCache<K,V>::
 empty_cache()
 {
-    std::lock_guard<std::recursive_mutex> lock(Q::m);
+    std::lock_guard<AtlRecursiveMutex> lock(Q::m);
     keyMap.clear();
     Q::delete_all();   //Recursive mutex allows for multiple locks from the same thread
 }
@@ -102,7 +102,7 @@ setCleanupHandler(std::function<bool(K,V)> handler)
 template<class K, class V> bool LruCache<K,V>::
 get_value(K key, V& val)
 {
-    std::lock_guard<std::recursive_mutex> lock(Q::m);
+    std::lock_guard<AtlRecursiveMutex> lock(Q::m);
 
     if (!keyMap.count(key)) {
         return false;
@@ -139,7 +139,7 @@ get_value(K key, V& val)
 template<class K, class V> bool LruCache<K,V>::
 get_lower_bound(K key, V& val)
 {
-    std::lock_guard<std::recursive_mutex> lock(Q::m);
+    std::lock_guard<AtlRecursiveMutex> lock(Q::m);
 
     if (keyMap.lower_bound(key) == keyMap.end()) {
         return false;
@@ -178,7 +178,7 @@ get_lower_bound(K key, V& val)
 template<class K, class V> bool LruCache<K,V>::
 add_to_cache(K key, V value)
 {
-    std::unique_lock<std::recursive_mutex> lock(Q::m);
+    std::unique_lock<AtlRecursiveMutex> lock(Q::m);
 
     //Check to see if something needs booted
     int count = 0;
@@ -0,0 +1,171 @@
+/**
+ * \file PoolAllocator.tcc
+ **/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace atl
+{
+
+    /**
+     * \brief Carves small fixed-size objects out of large chunks
+     *
+     * Objects are grouped into size classes with one free list each, so the
+     * nodes of a map are packed into a few chunks instead of being scattered
+     * across the heap with per-allocation malloc overhead. Freed objects are
+     * reused but chunks are only returned when the arena is destroyed.
+     *
+     * Not thread-safe; the owning container must serialize access (TSMap
+     * does so under its write lock).
+     */
+    class NodeArena
+    {
+        public:
+            static const size_t ALIGN = alignof(std::max_align_t);
+            static const size_t MAX_POOLED = 512;   //!< Larger requests use operator new
+
+            explicit NodeArena(size_t chunkBytes = 64 * 1024)
+                : m_chunkBytes(chunkBytes), m_free(MAX_POOLED / ALIGN + 1, nullptr) {}
+            NodeArena(const NodeArena&) = delete;
+            NodeArena& operator=(const NodeArena&) = delete;
+            ~NodeArena();
+
+            void*   allocate(size_t bytes);
+            void    deallocate(void* p, size_t bytes);
+
+            size_t  reserved() const { return m_reserved; }    //!< Bytes obtained from the heap
+            size_t  used() const { return m_used; }            //!< Bytes handed out and not freed
+
+        private:
+            struct FreeNode {
+                FreeNode* next;
+            };
+
+            static size_t roundUp(size_t bytes) { return (bytes + ALIGN - 1) / ALIGN * ALIGN; }
+
+            size_t                  m_chunkBytes;
+            std::vector<FreeNode*>  m_free;             //!< Free list per size class
+            std::vector<char*>      m_chunks;
+            char*                   m_cur = nullptr;    //!< Bump pointer into the newest chunk
+            size_t                  m_left = 0;         //!< Bytes left after m_cur
+            size_t                  m_reserved = 0;
+            size_t                  m_used = 0;
+    };
+
+    inline NodeArena::~NodeArena()
+    {
+        for (char* c : m_chunks) {
+            ::operator delete(c);
+        }
+    }
+
+    /**
+     * \brief Returns storage for an object of the given size
+     **/
+    inline void* NodeArena::allocate(size_t bytes)
+    {
+        bytes = roundUp(bytes);
+        m_used += bytes;
+        if (bytes > MAX_POOLED) {
+            m_reserved += bytes;
+            return ::operator new(bytes);
+        }
+
+        FreeNode*& head = m_free[bytes / ALIGN];
+        if (head) {
+            FreeNode* n = head;
+            head = n->next;
+            return n;
+        }
+
+        if (m_left < bytes) {
+            size_t chunk = std::max(m_chunkBytes, bytes);
+            m_cur = static_cast<char*>(::operator new(chunk));
+            m_left = chunk;
+            m_chunks.push_back(m_cur);
+            m_reserved += chunk;
+        }
+        void* p = m_cur;
+        m_cur += bytes;
+        m_left -= bytes;
+        return p;
+    }
+
+    /**
+     * \brief Returns storage from allocate() to its size class
+     **/
+    inline void NodeArena::deallocate(void* p, size_t bytes)
+    {
+        bytes = roundUp(bytes);
+        m_used -= bytes;
+        if (bytes > MAX_POOLED) {
+            m_reserved -= bytes;
+            ::operator delete(p);
+            return;
+        }
+
+        FreeNode* n = static_cast<FreeNode*>(p);
+        n->next = m_free[bytes / ALIGN];
+        m_free[bytes / ALIGN] = n;
+    }
+
+    /**
+     * \brief Standard allocator that draws nodes from a NodeArena
+     *
+     * Each default-constructed allocator owns a new arena. Copies and
+     * rebinds share it, so a container and its rebound node allocator use
+     * the same arena. Copying a container gives the copy a fresh arena.
+     *
+     * Use as the allocator of a TSMap backend (see PooledTSMap).
+     */
+    template<typename T> class PoolAllocator
+    {
+        public:
+            typedef T               value_type;
+            typedef std::true_type  propagate_on_container_move_assignment;
+            typedef std::true_type  propagate_on_container_swap;
+            typedef std::false_type is_always_equal;
+
+            template<typename U> struct rebind {
+                typedef PoolAllocator<U> other;
+            };
+
+            PoolAllocator() : m_arena(std::make_shared<NodeArena>()) {}
+            template<typename U> PoolAllocator(const PoolAllocator<U>& other)
+                : m_arena(other.arena()) {}
+
+            T* allocate(size_t n)
+            {
+                return static_cast<T*>(m_arena->allocate(n * sizeof(T)));
+            }
+            void deallocate(T* p, size_t n)
+            {
+                m_arena->deallocate(p, n * sizeof(T));
+            }
+
+            PoolAllocator select_on_container_copy_construction() const { return PoolAllocator(); }
+
+            const std::shared_ptr<NodeArena>& arena() const { return m_arena; }
+
+        private:
+            std::shared_ptr<NodeArena> m_arena;
+    };
+
+    template<typename T, typename U>
+    bool operator==(const PoolAllocator<T>& a, const PoolAllocator<U>& b)
+    {
+        return a.arena() == b.arena();
+    }
+
+    template<typename T, typename U>
+    bool operator!=(const PoolAllocator<T>& a, const PoolAllocator<U>& b)
+    {
+        return !(a == b);
+    }
+}
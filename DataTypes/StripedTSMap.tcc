@@ -0,0 +1,480 @@
+/**
+ * \file StripedTSMap.tcc
+ **/
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "TSMap.tcc"
+
+namespace atl
+{
+
+    /**
+     * \brief Ordered thread-safe map split into independently locked stripes
+     *
+     * Each stripe is a TSMap with its own lock, so writers touching different
+     * stripes do not contend. Keys are assigned to stripes either by range
+     * (sorted split keys given at construction) or by hash.
+     *
+     * Single-key operations lock one stripe. Ordered lookups (lower_bound,
+     * findInfimum) and whole-map operations visit several stripes one after
+     * another; each stripe is consistent, but the result is not a snapshot of
+     * the whole map if other threads write concurrently.
+     *
+     * Range striping keeps neighbouring keys together, so ordered lookups
+     * usually touch one stripe; it only spreads writes if they are spread over
+     * the split keys. Hash striping spreads any key pattern, but ordered
+     * lookups must ask every stripe.
+     *
+     * Split keys, stripe routing and merged results follow Map's comparator,
+     * so a custom key order stays consistent with the stripe boundaries.
+     *
+     * \tparam Map The ordered map used by each stripe (see TSMap)
+     * \tparam Mutex Each stripe's reader/writer lock (see TSMap)
+     */
+    template<typename Key, typename Value,
+             typename Map = std::map<Key, Value, std::function<bool(Key,Key)>>,
+             typename Mutex = AtlSharedMutex> class StripedTSMap
+    {
+        public:
+            typedef TSMap<Key, Value, Map, Mutex> Stripe;
+            typedef typename Map::key_compare key_compare;
+
+            explicit StripedTSMap(unsigned stripes = 16);
+            explicit StripedTSMap(std::vector<Key> splitKeys);
+
+            // read functions
+            std::pair<Value, bool>  find(Key k) const;
+            std::pair<Value, bool>  lower_bound(Key k) const;
+            std::pair<std::pair<Key,Value>, bool> lower_bound_key(Key k) const;
+            std::pair<Value, bool>  findInfimum(Key k) const;
+            std::pair<std::pair<Key,Value>, bool>  findInfimum_key(Key k) const;
+            size_t                  size() const;
+            bool                    empty() const;
+            std::vector<Key>        getKeyList() const;
+            size_t                  memory_usage() const;
+            unsigned                stripes() const { return m_stripes.size(); }
+            key_compare             key_comp() const { return m_comp; }
+
+            // write functions
+            bool                    emplace(Key k, Value v, bool force = false);
+            template<typename... Args>
+            bool                    createInPlace(Key k, Args&&... args);
+            template<typename... Args>
+            bool                    try_emplace(Key k, Args&&... args);
+            std::pair<Value,bool>   replace(Key k, Value v, bool force = true);
+            std::pair<Value,bool>   compute(Key k, std::function<bool(Key,Value&,bool)> f);
+            std::pair<Value,bool>   compute_if_absent(Key k, std::function<Value(Key)> factory);
+            std::pair<Value,bool>   upsert(Key k, Value v, std::function<void(Value&,const Value&)> merge = nullptr);
+            bool                    erase(Key k, std::function<bool(Key,Value&)> f = nullptr);
+            std::pair<Value, bool>  remove(Key k);
+
+            bool                    perform(Key k, std::function<bool(Key,Value&)> f = nullptr);
+            bool                    perform_ro(Key k, std::function<bool(Key,const Value&)> f = nullptr) const;
+            void                    clear();
+            size_t                  shrink();
+
+            // function iterators, one stripe locked at a time
+            size_t for_each_ro(std::function<bool(Key k, const Value& v)> f) const;
+            size_t for_each(std::function<bool(Key k, Value& v)> f);
+            size_t delete_if(std::function<bool(Key k, Value& v)> f);
+
+            // function iterators, stripes processed concurrently
+            size_t parallel_for_each_ro(ThreadPool& pool, std::function<bool(Key k, const Value& v)> f) const;
+            size_t parallel_for_each(ThreadPool& pool, std::function<bool(Key k, Value& v)> f);
+            size_t parallel_delete_if(ThreadPool& pool, std::function<bool(Key k, Value& v)> f);
+
+        protected:
+            unsigned        stripeIndex(const Key& k) const;
+            Stripe&         stripe(const Key& k) const { return *m_stripes[stripeIndex(k)]; }
+
+            std::vector<std::unique_ptr<Stripe>> m_stripes;  //!< Independently locked sub-maps
+            std::vector<Key> m_splitKeys;       //!< Range mode: first key of stripes 1..n-1
+            key_compare      m_comp;            //!< The stripes' key order
+            bool             m_byRange;         //!< True for range striping, false for hash
+    };
+
+    /**
+     * \brief Constructor for hash striping
+     * \param [in] stripes The number of independently locked sub-maps
+     **/
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    StripedTSMap<Key, Value, Map, Mutex>::StripedTSMap(unsigned stripes)
+        : m_comp(TSMapCompare<key_compare>::make()), m_byRange(false)
+    {
+        for (unsigned i = 0; i < std::max(1u, stripes); i++) {
+            m_stripes.emplace_back(new Stripe());
+        }
+    }
+
+    /**
+     * \brief Constructor for range striping
+     *
+     * Stripe 0 holds keys less than splitKeys[0], stripe i holds keys in
+     * [splitKeys[i-1], splitKeys[i]) and the last stripe holds the rest,
+     * all in the order of Map's comparator.
+     *
+     * \param [in] splitKeys Boundaries between stripes; sorted on return
+     **/
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    StripedTSMap<Key, Value, Map, Mutex>::StripedTSMap(std::vector<Key> splitKeys)
+        : m_splitKeys(std::move(splitKeys)), m_comp(TSMapCompare<key_compare>::make()), m_byRange(true)
+    {
+        std::sort(m_splitKeys.begin(), m_splitKeys.end(), m_comp);
+        m_splitKeys.erase(std::unique(m_splitKeys.begin(), m_splitKeys.end(),
+                                      [this](const Key& a, const Key& b) { return !m_comp(a, b); }),
+                          m_splitKeys.end());
+        for (size_t i = 0; i <= m_splitKeys.size(); i++) {
+            m_stripes.emplace_back(new Stripe());
+        }
+    }
+
+    /**
+     * \brief Returns the index of the stripe that owns key k
+     **/
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    unsigned StripedTSMap<Key, Value, Map, Mutex>::stripeIndex(const Key& k) const
+    {
+        if (m_byRange) {
+            return std::upper_bound(m_splitKeys.begin(), m_splitKeys.end(), k, m_comp) - m_splitKeys.begin();
+        }
+        return std::hash<Key>()(k) % m_stripes.size();
+    }
+
+    ////////////////////////////////////////
+    //            READ METHODS            //
+    ////////////////////////////////////////
+
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    std::pair<Value, bool> StripedTSMap<Key, Value, Map, Mutex>::find(Key k) const
+    {
+        return stripe(k).find(k);
+    }
+
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    std::pair<Value, bool> StripedTSMap<Key, Value, Map, Mutex>::lower_bound(Key k) const
+    {
+        auto ret = lower_bound_key(k);
+        return std::make_pair(ret.first.second, ret.second);
+    }
+
+    /**
+     * \brief Retrieves the entry with the smallest key not less than k
+     *
+     * With range striping the search continues into the following stripes
+     * only if k's own stripe has no such key. With hash striping every
+     * stripe is asked and the smallest answer wins.
+     *
+     * \return The key-value pair and true if one was found
+     **/
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    std::pair<std::pair<Key, Value>, bool> StripedTSMap<Key, Value, Map, Mutex>::lower_bound_key(Key k) const
+    {
+        if (m_byRange) {
+            for (unsigned i = stripeIndex(k); i < m_stripes.size(); i++) {
+                auto ret = m_stripes[i]->lower_bound_key(k);
+                if (ret.second) {
+                    return ret;
+                }
+            }
+            return std::make_pair(std::make_pair(Key{}, Value{}), false);
+        }
+
+        std::pair<std::pair<Key, Value>, bool> best(std::make_pair(Key{}, Value{}), false);
+        for (auto& s : m_stripes) {
+            auto ret = s->lower_bound_key(k);
+            if (ret.second && (!best.second || m_comp(ret.first.first, best.first.first))) {
+                best = ret;
+            }
+        }
+        return best;
+    }
+
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    std::pair<Value, bool> StripedTSMap<Key, Value, Map, Mutex>::findInfimum(Key k) const
+    {
+        auto ret = findInfimum_key(k);
+        return std::make_pair(ret.first.second, ret.second);
+    }
+
+    /**
+     * \brief Retrieves the entry with the greatest key less than or equal to k
+     *
+     * With range striping the search continues into the preceding stripes
+     * only if k's own stripe has no such key. With hash striping every
+     * stripe is asked and the greatest answer wins.
+     *
+     * \return The key-value pair and true if one was found
+     **/
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    std::pair<std::pair<Key, Value>, bool> StripedTSMap<Key, Value, Map, Mutex>::findInfimum_key(Key k) const
+    {
+        if (m_byRange) {
+            for (int i = stripeIndex(k); i >= 0; i--) {
+                auto ret = m_stripes[i]->findInfimum_key(k);
+                if (ret.second) {
+                    return ret;
+                }
+            }
+            return std::make_pair(std::make_pair(Key{}, Value{}), false);
+        }
+
+        std::pair<std::pair<Key, Value>, bool> best(std::make_pair(Key{}, Value{}), false);
+        for (auto& s : m_stripes) {
+            auto ret = s->findInfimum_key(k);
+            if (ret.second && (!best.second || m_comp(best.first.first, ret.first.first))) {
+                best = ret;
+            }
+        }
+        return best;
+    }
+
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    size_t StripedTSMap<Key, Value, Map, Mutex>::size() const
+    {
+        size_t s = 0;
+        for (auto& st : m_stripes) {
+            s += st->size();
+        }
+        return s;
+    }
+
+    /**
+     * \brief Estimated heap footprint of all stripes in bytes
+     **/
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    size_t StripedTSMap<Key, Value, Map, Mutex>::memory_usage() const
+    {
+        size_t s = 0;
+        for (auto& st : m_stripes) {
+            s += st->memory_usage();
+        }
+        return s;
+    }
+
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    bool StripedTSMap<Key, Value, Map, Mutex>::empty() const
+    {
+        for (auto& st : m_stripes) {
+            if (!st->empty()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * \brief Returns all keys in ascending order
+     *
+     * Range stripes are already ordered relative to each other and are
+     * concatenated; hash stripes are merged pairwise.
+     **/
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    std::vector<Key> StripedTSMap<Key, Value, Map, Mutex>::getKeyList() const
+    {
+        std::vector<Key> keyList;
+        std::vector<size_t> runs(1, 0);
+
+        for (auto& st : m_stripes) {
+            std::vector<Key> part = st->getKeyList();
+            keyList.insert(keyList.end(), part.begin(), part.end());
+            runs.push_back(keyList.size());
+        }
+        if (m_byRange) {
+            return keyList;
+        }
+
+        // Bottom-up merge of the sorted runs
+        for (size_t width = 1; width < m_stripes.size(); width *= 2) {
+            for (size_t i = 0; i + width < m_stripes.size(); i += 2 * width) {
+                size_t end = std::min(i + 2 * width, m_stripes.size());
+                std::inplace_merge(keyList.begin() + runs[i],
+                                   keyList.begin() + runs[i + width],
+                                   keyList.begin() + runs[end], m_comp);
+            }
+        }
+        return keyList;
+    }
+
+    ////////////////////////////////////////
+    //           WRITE METHODS            //
+    ////////////////////////////////////////
+
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    bool StripedTSMap<Key, Value, Map, Mutex>::emplace(Key k, Value v, bool force)
+    {
+        return stripe(k).emplace(k, v, force);
+    }
+
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    template<typename... Args>
+    bool StripedTSMap<Key, Value, Map, Mutex>::createInPlace(Key k, Args&&... args)
+    {
+        return stripe(k).try_emplace(k, std::forward<Args>(args)...);
+    }
+
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    template<typename... Args>
+    bool StripedTSMap<Key, Value, Map, Mutex>::try_emplace(Key k, Args&&... args)
+    {
+        return stripe(k).try_emplace(k, std::forward<Args>(args)...);
+    }
+
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    std::pair<Value, bool> StripedTSMap<Key, Value, Map, Mutex>::compute(Key k,
+            std::function<bool(Key,Value&,bool)> f)
+    {
+        return stripe(k).compute(k, f);
+    }
+
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    std::pair<Value, bool> StripedTSMap<Key, Value, Map, Mutex>::compute_if_absent(Key k,
+            std::function<Value(Key)> factory)
+    {
+        return stripe(k).compute_if_absent(k, factory);
+    }
+
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    std::pair<Value, bool> StripedTSMap<Key, Value, Map, Mutex>::upsert(Key k, Value v,
+            std::function<void(Value&,const Value&)> merge)
+    {
+        return stripe(k).upsert(k, v, merge);
+    }
+
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    std::pair<Value, bool> StripedTSMap<Key, Value, Map, Mutex>::replace(Key k, Value v, bool force)
+    {
+        return stripe(k).replace(k, v, force);
+    }
+
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    bool StripedTSMap<Key, Value, Map, Mutex>::erase(Key k, std::function<bool(Key,Value&)> f)
+    {
+        return stripe(k).erase(k, f);
+    }
+
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    std::pair<Value, bool> StripedTSMap<Key, Value, Map, Mutex>::remove(Key k)
+    {
+        return stripe(k).remove(k);
+    }
+
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    bool StripedTSMap<Key, Value, Map, Mutex>::perform(Key k, std::function<bool(Key,Value&)> f)
+    {
+        return stripe(k).perform(k, f);
+    }
+
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    bool StripedTSMap<Key, Value, Map, Mutex>::perform_ro(Key k, std::function<bool(Key,const Value&)> f) const
+    {
+        return stripe(k).perform_ro(k, f);
+    }
+
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    void StripedTSMap<Key, Value, Map, Mutex>::clear()
+    {
+        for (auto& st : m_stripes) {
+            st->clear();
+        }
+    }
+
+    /**
+     * \brief Compacts each stripe in turn, so only one is locked at a time
+     * \return The number of bytes released according to memory_usage()
+     **/
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    size_t StripedTSMap<Key, Value, Map, Mutex>::shrink()
+    {
+        size_t s = 0;
+        for (auto& st : m_stripes) {
+            s += st->shrink();
+        }
+        return s;
+    }
+
+    ////////////////////////////////////////
+    //         FUNCTION ITERATORS         //
+    ////////////////////////////////////////
+
+    /**
+     * \brief Applies f to all elements; visits keys in order only with
+     *        range striping
+     * \return number of successful returns from f
+     **/
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    size_t StripedTSMap<Key, Value, Map, Mutex>::for_each_ro(std::function<bool(Key k, const Value& v)> f) const
+    {
+        size_t numSuccess = 0;
+        for (auto& st : m_stripes) {
+            numSuccess += st->for_each_ro(f);
+        }
+        return numSuccess;
+    }
+
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    size_t StripedTSMap<Key, Value, Map, Mutex>::for_each(std::function<bool(Key k, Value& v)> f)
+    {
+        size_t numSuccess = 0;
+        for (auto& st : m_stripes) {
+            numSuccess += st->for_each(f);
+        }
+        return numSuccess;
+    }
+
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    size_t StripedTSMap<Key, Value, Map, Mutex>::delete_if(std::function<bool(Key k, Value& v)> f)
+    {
+        size_t numErased = 0;
+        for (auto& st : m_stripes) {
+            numErased += st->delete_if(f);
+        }
+        return numErased;
+    }
+
+    /**
+     * \brief Applies a read-only f to all elements, one pool job per stripe
+     * \return number of successful returns from f
+     **/
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    size_t StripedTSMap<Key, Value, Map, Mutex>::parallel_for_each_ro(ThreadPool& pool,
+            std::function<bool(Key k, const Value& v)> f) const
+    {
+        return pool.run_partitions(m_stripes.size(), [&](size_t i) -> size_t {
+            return m_stripes[i]->for_each_ro(f);
+        });
+    }
+
+    /**
+     * \brief Applies f to all elements, one pool job per stripe; each job
+     *        locks only its own stripe
+     * \return number of successful returns from f
+     **/
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    size_t StripedTSMap<Key, Value, Map, Mutex>::parallel_for_each(ThreadPool& pool,
+            std::function<bool(Key k, Value& v)> f)
+    {
+        return pool.run_partitions(m_stripes.size(), [&](size_t i) -> size_t {
+            return m_stripes[i]->for_each(f);
+        });
+    }
+
+    /**
+     * \brief Deletes each element for which f returns true, one pool job per
+     *        stripe; each job locks only its own stripe
+     * \return the number of entries deleted
+     **/
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    size_t StripedTSMap<Key, Value, Map, Mutex>::parallel_delete_if(ThreadPool& pool,
+            std::function<bool(Key k, Value& v)> f)
+    {
+        return pool.run_partitions(m_stripes.size(), [&](size_t i) -> size_t {
+            return m_stripes[i]->delete_if(f);
+        });
+    }
+}
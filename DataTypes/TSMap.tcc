@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <condition_variable>
 #include <iostream>
 #include <map>
@@ -12,6 +13,10 @@
 #include "JsonBox.h"
 
 #include "shared_mutex.h"
+#include "big_shared_mutex.h"
+#include "BTreeMap.tcc"
+#include "PoolAllocator.tcc"
+#include "ThreadPool.h"
 #include <atomic>
 #include <chrono>
 #include <future>
@@ -22,17 +27,82 @@
 #include <string>
 #include "assert.h"
 
+#define TSMAP_PARTITION_SIZE 16384     //!< Default entries per parallel_delete_if range
+
 namespace atl
 {
 
+    /**
+     * \brief Builds the comparator that the backing map is constructed with
+     *
+     * The default std::map backend holds a std::function comparator that has
+     * to be given a callable. Other backends default-construct theirs.
+     **/
+    template<typename Compare> struct TSMapCompare
+    {
+        static Compare make() { return Compare(); }
+    };
+
+    template<typename Key> struct TSMapCompare<std::function<bool(Key,Key)>>
+    {
+        static std::function<bool(Key,Key)> make()
+        {
+            return [](Key k1, Key k2)->bool { return k1 < k2; };
+        }
+    };
+
+    /**
+     * \brief Estimates the heap footprint of a backing map
+     *
+     * The generic estimate charges each entry a red-black node (three links
+     * and a color) plus typical malloc bookkeeping. Backends that know their
+     * real footprint specialize this. Memory owned by keys and values
+     * themselves (e.g. string buffers) is not counted.
+     **/
+    template<typename Map> struct TSMapMemory
+    {
+        static const size_t NODE_OVERHEAD = 4 * sizeof(void*) + 2 * sizeof(size_t);
+
+        static size_t usage(const Map& m)
+        {
+            return sizeof(Map) + m.size() * (sizeof(typename Map::value_type) + NODE_OVERHEAD);
+        }
+    };
+
+    template<typename Key, typename Value, typename Compare, size_t NodeBytes>
+    struct TSMapMemory<BTreeMap<Key, Value, Compare, NodeBytes>>
+    {
+        static size_t usage(const BTreeMap<Key, Value, Compare, NodeBytes>& m)
+        {
+            return m.memory_usage();
+        }
+    };
+
+    template<typename Key, typename Value, typename Compare, typename T>
+    struct TSMapMemory<std::map<Key, Value, Compare, PoolAllocator<T>>>
+    {
+        static size_t usage(const std::map<Key, Value, Compare, PoolAllocator<T>>& m)
+        {
+            return sizeof(m) + m.get_allocator().arena()->reserved();
+        }
+    };
+
     /*
      * \brief Threadsafe wrapper for standard library ordered map class
+     *
+     * \tparam Map The ordered map used for storage. It must provide the
+     *             std::map members used here; BTreeMap is a drop-in
+     *             cache-friendly alternative (see BTreeTSMap).
+     * \tparam Mutex Reader/writer lock type; big_shared_mutex scales reads
+     *               across cores for maps that are rarely written.
      */
-    template<typename Key, typename Value> class TSMap
+    template<typename Key, typename Value,
+             typename Map = std::map<Key, Value, std::function<bool(Key,Key)>>,
+             typename Mutex = AtlSharedMutex> class TSMap
     {
         protected:
-            std::map<Key, Value, std::function<bool(Key,Key)>> m_map;     //!< Map of objects
-            mutable shared_mutex m_mutex;
+            Map m_map;                  //!< Map of objects
+            mutable Mutex m_mutex;      //!< Reader/writer lock guarding m_map
     
         public:
             TSMap();
@@ -47,36 +117,55 @@ namespace atl
             size_t                  size() const;
             bool                    empty() const;
             std::vector<Key>        getKeyList() const;
+            size_t                  memory_usage() const;
     
             // write functions
             bool                    emplace(Key k, Value v, bool force = false);
             template<typename... Args>
-            bool                    createInPlace(Key k, Args... args);
+            bool                    createInPlace(Key k, Args&&... args);
+            template<typename... Args>
+            bool                    try_emplace(Key k, Args&&... args);
             std::pair<Value,bool>   replace(Key k, Value v, bool force = true);
+            std::pair<Value,bool>   compute(Key k, std::function<bool(Key,Value&,bool)> f);
+            std::pair<Value,bool>   compute_if_absent(Key k, std::function<Value(Key)> factory);
+            std::pair<Value,bool>   upsert(Key k, Value v, std::function<void(Value&,const Value&)> merge = nullptr);
             bool                    erase(Key k, std::function<bool(Key,Value&)> f = nullptr);
             std::pair<Value, bool>  remove(Key k);
 
             bool                    perform(Key k, std::function<bool(Key,Value&)> f = nullptr);
             bool                    perform_ro(Key k, std::function<bool(Key,const Value&)> f = nullptr) const;
             void                    clear();
+            size_t                  shrink();
 
             // function iterators
             size_t for_each_ro(std::function<bool(Key k, const Value& v)> f) const;
             size_t for_each(std::function<bool(Key k, Value& v)> f);
             size_t delete_if(std::function<bool(Key k, Value& v)> f);
+
+            // partitioned function iterators
+            size_t parallel_for_each_ro(ThreadPool& pool, std::function<bool(Key k, const Value& v)> f,
+                                        size_t partitions = 0) const;
+            size_t parallel_for_each(ThreadPool& pool, std::function<bool(Key k, Value& v)> f,
+                                     size_t partitions = 0);
+            size_t parallel_delete_if(ThreadPool& pool, std::function<bool(Key k, Value& v)> f,
+                                      size_t partitions = 0);
+
+        protected:
+            template<typename Iter>
+            static std::vector<Iter> splitRange(Iter begin, Iter end, size_t size, size_t parts);
     };
 
     /**
      * @brief Constructor. Explicitly defines the comparison operator for use by the map.
      **/
-    template<typename Key, typename Value> TSMap<Key, Value>::TSMap()
-        : m_map([](Key k1, Key k2)->bool { return k1 < k2; })
+    template<typename Key, typename Value, typename Map, typename Mutex> TSMap<Key, Value, Map, Mutex>::TSMap()
+        : m_map(TSMapCompare<typename Map::key_compare>::make())
     { }
 
     /**
      * @brief Destructor. Clears the map
      */
-    template<typename Key, typename Value> TSMap<Key, Value>::~TSMap()
+    template<typename Key, typename Value, typename Map, typename Mutex> TSMap<Key, Value, Map, Mutex>::~TSMap()
     {
         clear();
     }
@@ -91,10 +180,10 @@ namespace atl
      *
      * \return The value correspoding to Key k
      */
-    template<typename Key, typename Value> std::pair<Value, bool> TSMap<Key, Value>::
+    template<typename Key, typename Value, typename Map, typename Mutex> std::pair<Value, bool> TSMap<Key, Value, Map, Mutex>::
             find(Key k) const
     {
-        atl::shared_lock lock(m_mutex);
+        basic_shared_lock<Mutex> lock(m_mutex);
         auto it = m_map.find(k);
         
         if (it != m_map.end()){
@@ -110,10 +199,10 @@ namespace atl
      * \return The value with the smallest key greater than or equal t
      * correspoding to Key k
      */
-    template<typename Key, typename Value> std::pair<Value, bool> TSMap<Key, Value>::
+    template<typename Key, typename Value, typename Map, typename Mutex> std::pair<Value, bool> TSMap<Key, Value, Map, Mutex>::
             lower_bound(Key k) const
     {
-        atl::shared_lock lock(m_mutex);
+        basic_shared_lock<Mutex> lock(m_mutex);
         auto it = m_map.lower_bound(k);
 
         if (it != m_map.end()){
@@ -129,11 +218,11 @@ namespace atl
      * \return The value with the smallest key greater than or equal t
      * correspoding to Key k; also returns the Key of this Value
      */
-    template<typename Key, typename Value> 
-            std::pair<std::pair<Key, Value>, bool> TSMap<Key, Value>::
+    template<typename Key, typename Value, typename Map, typename Mutex> 
+            std::pair<std::pair<Key, Value>, bool> TSMap<Key, Value, Map, Mutex>::
             lower_bound_key(Key k) const
     {
-        atl::shared_lock lock(m_mutex);
+        basic_shared_lock<Mutex> lock(m_mutex);
         auto it = m_map.lower_bound(k);
 
         if (it != m_map.end()){
@@ -150,10 +239,10 @@ namespace atl
      *         Value, if found. The bool is true if a Value is found, 
      *         else false if none is found
      **/
-    template<typename Key,typename Value> 
-            std::pair<Value,bool> TSMap<Key,Value>::findInfimum(Key k) const
+    template<typename Key, typename Value, typename Map, typename Mutex> 
+            std::pair<Value,bool> TSMap<Key, Value, Map, Mutex>::findInfimum(Key k) const
     {
-        atl::shared_lock lock(m_mutex);
+        basic_shared_lock<Mutex> lock(m_mutex);
         auto it = m_map.lower_bound(k);
 
         // If the iterator has the same key, return its value
@@ -178,10 +267,10 @@ namespace atl
      *         Value, if found. The bool is true if a Value is found, 
      *         else false if none is found
      **/
-    template<typename Key,typename Value> 
-            std::pair<std::pair<Key,Value>,bool> TSMap<Key,Value>::findInfimum_key(Key k) const
+    template<typename Key, typename Value, typename Map, typename Mutex> 
+            std::pair<std::pair<Key,Value>,bool> TSMap<Key, Value, Map, Mutex>::findInfimum_key(Key k) const
     {
-        atl::shared_lock lock(m_mutex);
+        basic_shared_lock<Mutex> lock(m_mutex);
         auto it = m_map.lower_bound(k);
 
         // If the iterator has the same key, return its value
@@ -201,10 +290,10 @@ namespace atl
     /*
      * \brief returns the number of entries in the map
      */
-    template<typename Key, typename Value> size_t TSMap<Key, Value>::
+    template<typename Key, typename Value, typename Map, typename Mutex> size_t TSMap<Key, Value, Map, Mutex>::
             size() const
     {
-        atl::shared_lock lock(m_mutex);
+        basic_shared_lock<Mutex> lock(m_mutex);
         size_t s = m_map.size();
         return s;
     }
@@ -212,18 +301,18 @@ namespace atl
     /*
      * \brief checks if the map is empty
      */
-    template<typename Key, typename Value> bool TSMap<Key, Value>::
+    template<typename Key, typename Value, typename Map, typename Mutex> bool TSMap<Key, Value, Map, Mutex>::
             empty() const
     {
-        atl::shared_lock lock(m_mutex);
+        basic_shared_lock<Mutex> lock(m_mutex);
         return m_map.empty();
     }
 
-    template<typename Key, typename Value> std::vector<Key> TSMap<Key, Value>::
+    template<typename Key, typename Value, typename Map, typename Mutex> std::vector<Key> TSMap<Key, Value, Map, Mutex>::
             getKeyList() const
     {
         std::vector<Key> keyList;
-        atl::shared_lock lock(m_mutex);
+        basic_shared_lock<Mutex> lock(m_mutex);
 
         for (auto it = m_map.cbegin(); it != m_map.cend(); it++) {
             keyList.push_back(it->first);
@@ -231,6 +320,19 @@ namespace atl
         return keyList;
     }
 
+    /*
+     * \brief Estimated heap footprint of the map's nodes in bytes
+     *
+     * \return The estimate from TSMapMemory; excludes memory owned by the
+     *         keys and values themselves
+     */
+    template<typename Key, typename Value, typename Map, typename Mutex> size_t TSMap<Key, Value, Map, Mutex>::
+            memory_usage() const
+    {
+        basic_shared_lock<Mutex> lock(m_mutex);
+        return TSMapMemory<Map>::usage(m_map);
+    }
+
 
     ////////////////////////////////////////
     //           WRITE METHODS            //
@@ -243,17 +345,21 @@ namespace atl
      *
      * return true if no element previously existed, false if one did
      */
-    template<typename Key, typename Value> bool TSMap<Key, Value>::
+    template<typename Key, typename Value, typename Map, typename Mutex> bool TSMap<Key, Value, Map, Mutex>::
             emplace(Key k, Value v, bool force)
     {
-        std::lock_guard<atl::shared_mutex> lock(m_mutex);
+        std::lock_guard<Mutex> lock(m_mutex);
+        auto it = m_map.lower_bound(k);
 
-        if (!force && m_map.find(k) != m_map.end()) {
-            return false;
+        if (it != m_map.end() && !m_map.key_comp()(k, it->first)) {
+            if (!force) {
+                return false;
+            }
+            it->second = std::move(v);
+            return true;
         }
-        m_map.erase(k);
-
-        return m_map.emplace(k, v).second;
+        m_map.emplace_hint(it, std::move(k), std::move(v));
+        return true;
     }
 
     /*
@@ -263,15 +369,119 @@ namespace atl
      *
      * return true if the value was successfully created
      */
-    template<typename Key, typename Value>
-    template<typename... Args> bool TSMap<Key,Value>::
-        createInPlace(Key k, Args... args)
-    {
-        std::lock_guard<atl::shared_mutex> lock(m_mutex);
-        auto ret = m_map.emplace(std::piecewise_construct,
-                                  std::forward_as_tuple(k),
-                                  std::forward_as_tuple(args...));
-        return ret.second;
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    template<typename... Args> bool TSMap<Key, Value, Map, Mutex>::
+        createInPlace(Key k, Args&&... args)
+    {
+        return try_emplace(std::move(k), std::forward<Args>(args)...);
+    }
+
+    /*
+     * \brief Constructs a value in place if the key is not present
+     * \param [in] k The key associated with the new value
+     * \param [in] args the arguments to the constructor of the Value,
+     *             forwarded; nothing is constructed if k is present
+     *
+     * \return true if the value was created, false if k already existed
+     */
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    template<typename... Args> bool TSMap<Key, Value, Map, Mutex>::
+        try_emplace(Key k, Args&&... args)
+    {
+        std::lock_guard<Mutex> lock(m_mutex);
+        auto it = m_map.lower_bound(k);
+
+        if (it != m_map.end() && !m_map.key_comp()(k, it->first)) {
+            return false;
+        }
+        m_map.emplace_hint(it, std::piecewise_construct,
+                           std::forward_as_tuple(std::move(k)),
+                           std::forward_as_tuple(std::forward<Args>(args)...));
+        return true;
+    }
+
+    /*
+     * \brief Reads, changes, inserts or erases the entry for a key with a
+     *        single lookup under one lock acquisition
+     * \param [in] k The key of the entry to operate on
+     * \param [in] f Called with the key, the value and whether the key was
+     *             present; an absent key gets a default-constructed Value.
+     *             Return true to keep (or insert) the entry, false to erase
+     *             it (or not insert it).
+     *
+     * \return pair of the value after f and true if the key is present
+     *         afterwards
+     */
+    template<typename Key, typename Value, typename Map, typename Mutex> std::pair<Value, bool> TSMap<Key, Value, Map, Mutex>::
+            compute(Key k, std::function<bool(Key, Value&, bool)> f)
+    {
+        std::lock_guard<Mutex> lock(m_mutex);
+        auto it = m_map.lower_bound(k);
+
+        if (it != m_map.end() && !m_map.key_comp()(k, it->first)) {
+            if (f(k, it->second, true)) {
+                return std::make_pair(it->second, true);
+            }
+            Value v = std::move(it->second);
+            m_map.erase(it);
+            return std::make_pair(std::move(v), false);
+        }
+
+        Value v{};
+        if (!f(k, v, false)) {
+            return std::make_pair(std::move(v), false);
+        }
+        it = m_map.emplace_hint(it, std::move(k), std::move(v));
+        return std::make_pair(it->second, true);
+    }
+
+    /*
+     * \brief Returns the value for a key, inserting factory(k) if absent
+     * \param [in] k The key to look up
+     * \param [in] factory Builds the value; only called if k is absent
+     *
+     * \return pair of the value in the map and true if it was inserted
+     */
+    template<typename Key, typename Value, typename Map, typename Mutex> std::pair<Value, bool> TSMap<Key, Value, Map, Mutex>::
+            compute_if_absent(Key k, std::function<Value(Key)> factory)
+    {
+        std::lock_guard<Mutex> lock(m_mutex);
+        auto it = m_map.lower_bound(k);
+
+        if (it != m_map.end() && !m_map.key_comp()(k, it->first)) {
+            return std::make_pair(it->second, false);
+        }
+        Value v = factory(k);
+        it = m_map.emplace_hint(it, std::move(k), std::move(v));
+        return std::make_pair(it->second, true);
+    }
+
+    /*
+     * \brief Inserts a value, or merges it into the existing one
+     * \param [in] k The key associated with Value v
+     * \param [in] v The value to insert or merge
+     * \param [in] merge Called as merge(existing, v) if k is present;
+     *             if null, the existing value is overwritten with v
+     *
+     * \return pair of the value in the map afterwards and true if it was
+     *         inserted
+     */
+    template<typename Key, typename Value, typename Map, typename Mutex> std::pair<Value, bool> TSMap<Key, Value, Map, Mutex>::
+            upsert(Key k, Value v, std::function<void(Value&, const Value&)> merge)
+    {
+        std::lock_guard<Mutex> lock(m_mutex);
+        auto it = m_map.lower_bound(k);
+
+        if (it != m_map.end() && !m_map.key_comp()(k, it->first)) {
+            if (merge) {
+                merge(it->second, v);
+            } else {
+                it->second = std::move(v);
+            }
+            return std::make_pair(it->second, false);
+        }
+        it = m_map.emplace_hint(it, std::move(k), std::move(v));
+        return std::make_pair(it->second, true);
     }
 
     /*
@@ -286,20 +496,20 @@ namespace atl
      * note: if nothing was in this location previously, the return Value will
      * be the value that was passed in. 
      */
-    template<typename Key, typename Value> std::pair<Value,bool> TSMap<Key, Value>::
+    template<typename Key, typename Value, typename Map, typename Mutex> std::pair<Value,bool> TSMap<Key, Value, Map, Mutex>::
             replace(Key k, Value v, bool force)
     {
-        std::lock_guard<atl::shared_mutex> lock(m_mutex);
-        Value newVal = v;
-        auto it = m_map.emplace(k, newVal);
+        std::lock_guard<Mutex> lock(m_mutex);
+        auto it = m_map.emplace(k, v);
 
         if (!it.second) {
-            newVal = it.first->second;
+            Value oldVal = it.first->second;
             if (force) {
-                m_map[k] = v;
+                it.first->second = std::move(v);
             }
+            return std::pair<Value,bool>(std::move(oldVal), false);
         }
-        return std::pair<Value,bool>(newVal, it.second);
+        return std::pair<Value,bool>(std::move(v), true);
     }
 
     /*
@@ -310,10 +520,10 @@ namespace atl
      *
      * \return true if the element was erased, false otherwise
      */
-    template<typename Key, typename Value> bool TSMap<Key, Value>::
+    template<typename Key, typename Value, typename Map, typename Mutex> bool TSMap<Key, Value, Map, Mutex>::
             erase(Key k, std::function<bool(Key,Value&)> f)
     {
-        std::lock_guard<atl::shared_mutex> lock(m_mutex);
+        std::lock_guard<Mutex> lock(m_mutex);
         auto it = m_map.find(k);
 
         if (it == m_map.end()){
@@ -334,10 +544,10 @@ namespace atl
  * \param[in] k The key to find, return, and remove
  * \return A pair of the value and a bool to indicate success
  **/
-    template<typename Key, typename Value> std::pair<Value, bool> TSMap<Key, Value>::
+    template<typename Key, typename Value, typename Map, typename Mutex> std::pair<Value, bool> TSMap<Key, Value, Map, Mutex>::
             remove(Key k)
     {
-        std::lock_guard<atl::shared_mutex> lock(m_mutex);
+        std::lock_guard<Mutex> lock(m_mutex);
         auto it = m_map.find(k);
 
         if (it != m_map.end()) {
@@ -356,10 +566,10 @@ namespace atl
      *
      * \return The value returned by the fucntion
      */
-    template<typename Key, typename Value> bool TSMap<Key, Value>::
+    template<typename Key, typename Value, typename Map, typename Mutex> bool TSMap<Key, Value, Map, Mutex>::
     perform(Key k, std::function<bool(Key,Value&)> f)
     {
-        std::lock_guard<atl::shared_mutex> lock(m_mutex);
+        std::lock_guard<Mutex> lock(m_mutex);
         auto it = m_map.find(k);
 
         if (it == m_map.end() || !f) {
@@ -376,10 +586,10 @@ namespace atl
      *
      * \return The value returned by the fucntion
      */
-    template<typename Key, typename Value> bool TSMap<Key, Value>::
+    template<typename Key, typename Value, typename Map, typename Mutex> bool TSMap<Key, Value, Map, Mutex>::
     perform_ro(Key k, std::function<bool(Key,const Value&)> f) const
     {
-        atl::shared_lock lock(m_mutex);
+        basic_shared_lock<Mutex> lock(m_mutex);
         auto it = m_map.find( k );
 
         if (it == m_map.end() || !f) {
@@ -392,13 +602,40 @@ namespace atl
     /*
      * \brief Clears all entries from the map
      */
-    template<typename Key, typename Value> void TSMap<Key, Value>::
+    template<typename Key, typename Value, typename Map, typename Mutex> void TSMap<Key, Value, Map, Mutex>::
             clear()
     {
-        std::lock_guard<atl::shared_mutex> lock(m_mutex);
+        std::lock_guard<Mutex> lock(m_mutex);
         m_map.clear();
     }
 
+    /*
+     * \brief Rebuilds the map so its nodes are packed in key order
+     *
+     * Long-running maps that see many inserts and erases end up with their
+     * nodes scattered over half-empty pages (or half-full B+tree leaves).
+     * This copies every entry into a freshly built map and releases the old
+     * one, so both maps are held briefly. It is most effective with
+     * PooledTSMap and BTreeTSMap, whose rebuilt nodes are contiguous and full.
+     *
+     * \return The number of bytes released according to memory_usage()
+     */
+    template<typename Key, typename Value, typename Map, typename Mutex> size_t TSMap<Key, Value, Map, Mutex>::
+            shrink()
+    {
+        std::lock_guard<Mutex> lock(m_mutex);
+        size_t before = TSMapMemory<Map>::usage(m_map);
+
+        Map packed(m_map.key_comp());
+        for (auto it = m_map.begin(); it != m_map.end(); ++it) {
+            packed.emplace_hint(packed.end(), it->first, std::move(it->second));
+        }
+        m_map.swap(packed);
+
+        size_t after = TSMapMemory<Map>::usage(m_map);
+        return before > after ? before - after : 0;
+    }
+
 
     ////////////////////////////////////////
     //         FUNCTION ITERATORS         //
@@ -407,15 +644,20 @@ namespace atl
     /*
      * \brief Takes a function pointer and applies it to all
      *        elements in the map
+     *
+     * f runs under the map's read lock and must not call methods of this
+     * map: read locks do not nest (see shared_mutex), so a find() from f
+     * hangs whenever a writer is waiting.
+     *
      * \param [in] f The function to apply to each element in the map;
      *               should return true on success, false on failure
      * \return number of successful returns from f
      */
-    template<typename Key, typename Value> size_t TSMap<Key, Value>::
+    template<typename Key, typename Value, typename Map, typename Mutex> size_t TSMap<Key, Value, Map, Mutex>::
             for_each_ro(std::function<bool(Key k, const Value& v)> f) const
     {
         size_t numSuccess = 0;
-        atl::shared_lock lock(m_mutex);
+        basic_shared_lock<Mutex> lock(m_mutex);
 
         for (auto it = m_map.cbegin(); it != m_map.cend(); it++) {
             if (f(it->first, it->second)){
@@ -432,11 +674,11 @@ namespace atl
      *               should return true on success, false on failure
      * \return number of successful returns from f
      */
-    template<typename Key, typename Value> size_t TSMap<Key, Value>::
+    template<typename Key, typename Value, typename Map, typename Mutex> size_t TSMap<Key, Value, Map, Mutex>::
             for_each(std::function<bool(Key k, Value& v)> f)
     {
         size_t numSuccess = 0;
-        std::lock_guard<atl::shared_mutex> lock(m_mutex);
+        std::lock_guard<Mutex> lock(m_mutex);
 
         for (auto it = m_map.begin(); it != m_map.end(); it++) {
             if (f(it->first, it->second)){
@@ -454,11 +696,11 @@ namespace atl
      *        returns true on an element, the element is deleted
      * \return the number of entries deleted
      */
-    template<typename Key, typename Value> size_t TSMap<Key, Value>::
+    template<typename Key, typename Value, typename Map, typename Mutex> size_t TSMap<Key, Value, Map, Mutex>::
             delete_if(std::function<bool(Key k, Value& v)> f)
     {
         size_t numErased = 0;
-        std::lock_guard<atl::shared_mutex> lock(m_mutex);
+        std::lock_guard<Mutex> lock(m_mutex);
 
         for (auto it = m_map.begin(); it != m_map.end(); ) {
             if (f(it->first, it->second)) {
@@ -471,4 +713,177 @@ namespace atl
         return numErased;
     }
     
+    ////////////////////////////////////////
+    //   PARTITIONED FUNCTION ITERATORS   //
+    ////////////////////////////////////////
+
+    /*
+     * \brief Applies a read-only function to all elements in the map, with
+     *        contiguous key ranges processed concurrently on a ThreadPool
+     *
+     * The calling thread holds the read lock while the pool runs f, so f
+     * must not call methods of this map; see for_each_ro().
+     *
+     * \param [in] pool The pool to run the partitions on
+     * \param [in] f The function to apply to each element in the map;
+     *               should return true on success, false on failure.
+     *               It is called concurrently from several threads.
+     * \param [in] partitions Number of key ranges; 0 uses one per pool thread
+     * \return number of successful returns from f
+     */
+    template<typename Key, typename Value, typename Map, typename Mutex> size_t TSMap<Key, Value, Map, Mutex>::
+            parallel_for_each_ro(ThreadPool& pool, std::function<bool(Key k, const Value& v)> f,
+                                 size_t partitions) const
+    {
+        size_t parts = partitions ? partitions : pool.getNumThreads();
+        basic_shared_lock<Mutex> lock(m_mutex);
+
+        size_t n = m_map.size();
+        parts = std::max<size_t>(1, std::min(parts, n));
+        auto bounds = splitRange(m_map.cbegin(), m_map.cend(), n, parts);
+
+        return pool.run_partitions(parts, [&](size_t i) -> size_t {
+            size_t numSuccess = 0;
+            for (auto it = bounds[i]; it != bounds[i+1]; it++) {
+                if (f(it->first, it->second)) {
+                    numSuccess++;
+                }
+            }
+            return numSuccess;
+        });
+    }
+
+    /*
+     * \brief Applies a function to all elements in the map, with contiguous
+     *        key ranges processed concurrently on a ThreadPool
+     *
+     * The map is locked for writing once for the whole call; f may modify
+     * the value it is given but must not touch other entries, and must not
+     * call methods of this map, which would wait for the lock forever.
+     *
+     * \param [in] pool The pool to run the partitions on
+     * \param [in] f The function to apply to each element in the map;
+     *               should return true on success, false on failure.
+     *               It is called concurrently from several threads.
+     * \param [in] partitions Number of key ranges; 0 uses one per pool thread
+     * \return number of successful returns from f
+     */
+    template<typename Key, typename Value, typename Map, typename Mutex> size_t TSMap<Key, Value, Map, Mutex>::
+            parallel_for_each(ThreadPool& pool, std::function<bool(Key k, Value& v)> f,
+                              size_t partitions)
+    {
+        size_t parts = partitions ? partitions : pool.getNumThreads();
+        std::lock_guard<Mutex> lock(m_mutex);
+
+        size_t n = m_map.size();
+        parts = std::max<size_t>(1, std::min(parts, n));
+        auto bounds = splitRange(m_map.begin(), m_map.end(), n, parts);
+
+        return pool.run_partitions(parts, [&](size_t i) -> size_t {
+            size_t numSuccess = 0;
+            for (auto it = bounds[i]; it != bounds[i+1]; it++) {
+                if (f(it->first, it->second)) {
+                    numSuccess++;
+                }
+            }
+            return numSuccess;
+        });
+    }
+
+    /*
+     * \brief Deletes each element that meets some condition, locking the map
+     *        for writing only one key range at a time
+     *
+     * The key space is split under a read lock, then each range is purged by
+     * a ThreadPool job that holds the write lock only for that range, so
+     * readers and writers are let in between ranges. Entries inserted during
+     * the call may or may not be visited. f runs under a range's write lock
+     * and must not call methods of this map.
+     *
+     * \param [in] pool The pool to run the partitions on
+     * \param [in] f Function that takes Key, Value pair and returns 
+     *        a boolean, applied to each element; If the function 
+     *        returns true on an element, the element is deleted
+     * \param [in] partitions Number of key ranges; 0 picks ranges of about
+     *        TSMAP_PARTITION_SIZE entries, and at least one per pool thread
+     * \return the number of entries deleted
+     */
+    template<typename Key, typename Value, typename Map, typename Mutex> size_t TSMap<Key, Value, Map, Mutex>::
+            parallel_delete_if(ThreadPool& pool, std::function<bool(Key k, Value& v)> f,
+                               size_t partitions)
+    {
+        std::vector<Key> bounds;
+        size_t parts;
+        {
+            basic_shared_lock<Mutex> lock(m_mutex);
+            size_t n = m_map.size();
+            parts = partitions ? partitions
+                               : std::max<size_t>(pool.getNumThreads(), n / TSMAP_PARTITION_SIZE);
+            parts = std::max<size_t>(1, std::min(parts, n));
+
+            auto its = splitRange(m_map.cbegin(), m_map.cend(), n, parts);
+            for (size_t i = 1; i < parts; i++) {
+                bounds.push_back(its[i]->first);
+            }
+        }
+
+        return pool.run_partitions(parts, [&](size_t i) -> size_t {
+            size_t numErased = 0;
+            std::lock_guard<Mutex> lock(m_mutex);
+            auto comp = m_map.key_comp();
+
+            auto it = i ? m_map.lower_bound(bounds[i-1]) : m_map.begin();
+            while (it != m_map.end() && (i == bounds.size() || comp(it->first, bounds[i]))) {
+                if (f(it->first, it->second)) {
+                    it = m_map.erase(it);
+                    numErased++;
+                } else {
+                    it++;
+                }
+            }
+            return numErased;
+        });
+    }
+
+    /*
+     * \brief Splits [begin, end) into parts ranges of nearly equal length
+     * \return parts+1 iterators; range i is [bounds[i], bounds[i+1])
+     */
+    template<typename Key, typename Value, typename Map, typename Mutex>
+    template<typename Iter> std::vector<Iter> TSMap<Key, Value, Map, Mutex>::
+            splitRange(Iter begin, Iter end, size_t size, size_t parts)
+    {
+        std::vector<Iter> bounds;
+        bounds.push_back(begin);
+
+        size_t step = size / parts;
+        size_t extra = size % parts;
+        for (size_t i = 0; i + 1 < parts; i++) {
+            std::advance(begin, step + (i < extra ? 1 : 0));
+            bounds.push_back(begin);
+        }
+        bounds.push_back(end);
+        return bounds;
+    }
+
+    /**
+     * \brief TSMap stored in a B+tree instead of a red-black tree
+     *
+     * Lookups touch a few cache-line sized nodes rather than one node per
+     * tree level, which matters once maps hold millions of keys.
+     **/
+    template<typename Key, typename Value>
+    using BTreeTSMap = TSMap<Key, Value, BTreeMap<Key, Value>>;
+
+    /**
+     * \brief TSMap whose red-black nodes come from a per-map NodeArena
+     *
+     * Nodes are packed into large chunks instead of individual heap blocks,
+     * which removes per-node malloc overhead and keeps neighbours close.
+     * Memory freed by erase is reused by the map but only returned to the
+     * system by shrink() or destruction.
+     **/
+    template<typename Key, typename Value>
+    using PooledTSMap = TSMap<Key, Value, std::map<Key, Value, std::function<bool(Key,Key)>,
+                                                   PoolAllocator<std::pair<const Key, Value>>>>;
 }
@@ -9,6 +9,8 @@
 #include <mutex>
 #include <chrono>
 #include <condition_variable>
+#include <functional>
+#include <list>
 #include <memory>
 #include "JsonBox.h"
 #include <cstdio>
@@ -17,6 +19,7 @@
 #include <thread>
 #include <assert.h>
 #include "Timer.h"
+#include "AtlMutexWrap.h"
 #include <fstream>
 
 #pragma once
@@ -37,7 +40,7 @@ namespace atl
 template <typename T> class TSQueue
 {
 protected:
-    std::recursive_mutex m;                 //<! The mutex that will be used for accessing the queue
+    AtlRecursiveMutex m;                    //<! The mutex that will be used for accessing the queue
     std::condition_variable_any enqueue_cv; //<! The condition variable which waits on blocking dequeue
     std::condition_variable_any dequeue_cv; //<! The condition variable which waits on blocking dequeue
     std::atomic_size_t length;              //<! The length of the queue
@@ -45,14 +48,18 @@ protected:
     std::shared_ptr<QNode> head;            //<! The head of the queue
     std::weak_ptr<QNode> tail;              //<! The tail of the queue
     size_t max_size = DEFAULT_MAX_SIZE;     //<! Maximum size of queue
+    std::function<void()> on_enqueue;       //<! Called under the lock whenever data is added
+    std::list<std::pair<T*, std::function<void()>>> dequeue_waiters; //<! Consumers waiting in async_dequeue
 
     virtual void enqueue(std::shared_ptr<QNode> node);   //<! Adds a QNode to the tail of the queue
+    void hand_off();                                      //<! Gives queued data to waiting async consumers
 
 
 public:
     TSQueue();                                            //<! Constructor
     virtual ~TSQueue();                                   //<! Destructor.  Deletes all data in queue
     virtual bool enqueue(const T&, bool force = false);   //<! Add data to the tail of the queue
+    virtual bool enqueue(T&&, bool force = false);        //<! Move data to the tail of the queue
     virtual bool dequeue(T& data, uint16_t timeout = 0);  //<! Remove and return data from the head of the queue
     virtual bool push(T, bool force = false);             //<! Add data to the head of the queue (as a stack)
     virtual bool pop(T& data, uint16_t timeout = 0);      //<! Pop data off the head of the queue (as a stack)
@@ -62,6 +69,8 @@ public:
     virtual void set_max_size(size_t);                    //<! Sets max size
     virtual size_t get_max_size();                        //<! Returns max size
     virtual bool wait_until_empty(uint16_t timeout = 0);  //<! Waits until queue is empty
+    virtual void set_enqueue_callback(std::function<void()> f); //<! Sets a function called when data is added
+    virtual bool async_dequeue(T& data, std::function<void()> ready); //<! Removes the head now, or when data is added
 };
 
 //template<class K, class V> struct CacheNode;
@@ -75,6 +84,8 @@ template<typename T> struct TSQueue<T>::QNode {
         data = new_data;
     }
 
+    QNode(T&& new_data) : data(std::move(new_data)) {}
+
     T data;
     std::weak_ptr<QNode> next;   // Node closer to head
     std::shared_ptr<QNode> prev; // Node closer to tail
@@ -98,7 +109,7 @@ template<typename T> TSQueue<T>::~TSQueue()
 */
 template<typename T> void TSQueue<T>::delete_all()
 {
-    std::lock_guard<std::recursive_mutex> lock(m);
+    std::lock_guard<AtlRecursiveMutex> lock(m);
     head.reset();
     length = 0;
     dequeue_cv.notify_all();
@@ -111,7 +122,7 @@ template<typename T> void TSQueue<T>::delete_all()
 */
 template<typename T> void TSQueue<T>::enqueue(std::shared_ptr<QNode> node)
 {
-    std::lock_guard<std::recursive_mutex> lock(m);
+    std::lock_guard<AtlRecursiveMutex> lock(m);
 
     if (auto tailPtr = tail.lock()) {
         tailPtr->prev = node;
@@ -132,7 +143,7 @@ template<typename T> void TSQueue<T>::enqueue(std::shared_ptr<QNode> node)
 */
 template<typename T> bool TSQueue<T>::enqueue(const T& data, bool force)
 {
-    std::lock_guard<std::recursive_mutex> lock(m);
+    std::lock_guard<AtlRecursiveMutex> lock(m);
 
     if (!force && length >= max_size) {
         return false;
@@ -140,7 +151,36 @@ template<typename T> bool TSQueue<T>::enqueue(const T& data, bool force)
 
     std::shared_ptr<QNode> temp = std::shared_ptr<QNode>(new QNode(data));
     enqueue(temp);      //Recursive mutex allows for multiple locks from the same thread
+    hand_off();
+    enqueue_cv.notify_one();
+    if (on_enqueue) {
+        on_enqueue();
+    }
+    return true;
+}
+
+/**
+* @brief Moves data into a node at the tail of the queue, so move-only
+*        payloads and expensive copies are avoided
+*
+* @param data The data to be contained in the Node
+* @param force True will push data even if the length is greater than max_size
+*/
+template<typename T> bool TSQueue<T>::enqueue(T&& data, bool force)
+{
+    std::lock_guard<AtlRecursiveMutex> lock(m);
+
+    if (!force && length >= max_size) {
+        return false;
+    }
+
+    std::shared_ptr<QNode> temp = std::shared_ptr<QNode>(new QNode(std::move(data)));
+    enqueue(temp);
+    hand_off();
     enqueue_cv.notify_one();
+    if (on_enqueue) {
+        on_enqueue();
+    }
     return true;
 }
 
@@ -152,13 +192,13 @@ template<typename T> bool TSQueue<T>::enqueue(const T& data, bool force)
 */
 template<typename T> bool TSQueue<T>::dequeue(T& data, uint16_t timeout)
 {
-    std::unique_lock<std::recursive_mutex> lock(m);
+    std::unique_lock<AtlRecursiveMutex> lock(m);
 
     if (!enqueue_cv.wait_for(lock, std::chrono::milliseconds(timeout), [this] {return length > 0;})) {
         return false;
     }
 
-    data = head->data;
+    data = std::move(head->data);
     head = head->prev;
     length--;
 
@@ -180,7 +220,7 @@ template<typename T> bool TSQueue<T>::dequeue(T& data, uint16_t timeout)
  */
 template<typename T> bool TSQueue<T>::wait_until_empty(uint16_t timeout)
 {
-    std::unique_lock<std::recursive_mutex> lock(m);
+    std::unique_lock<AtlRecursiveMutex> lock(m);
 
     if (!timeout) {
         dequeue_cv.wait(lock, [this] {return length == 0;});
@@ -202,7 +242,7 @@ template<typename T> bool TSQueue<T>::wait_until_empty(uint16_t timeout)
 */
 template<typename T> bool TSQueue<T>::push(T data, bool force)
 {
-    std::unique_lock<std::recursive_mutex> lock(m);
+    std::unique_lock<AtlRecursiveMutex> lock(m);
 
     if (!force && length >= max_size) {
         return false;
@@ -219,7 +259,11 @@ template<typename T> bool TSQueue<T>::push(T data, bool force)
 
     head = temp;
     length++;
+    hand_off();
     enqueue_cv.notify_one();
+    if (on_enqueue) {
+        on_enqueue();
+    }
     return true;
 }
 
@@ -242,7 +286,7 @@ template<typename T> bool TSQueue<T>::pop( T& data, uint16_t timeout)
 */
 template<typename T> bool TSQueue<T>::peek(T& value, uint16_t timeout)
 {
-    std::unique_lock<std::recursive_mutex> lock(m);
+    std::unique_lock<AtlRecursiveMutex> lock(m);
 
     if (!enqueue_cv.wait_for(lock, std::chrono::milliseconds(timeout), [this] {return length > 0;})) {
         return false;
@@ -270,7 +314,7 @@ template<typename T> size_t TSQueue<T>::size()
 */
 template<typename T> void TSQueue<T>::set_max_size(size_t size)
 {
-    std::lock_guard<std::recursive_mutex> lock(m);
+    std::lock_guard<AtlRecursiveMutex> lock(m);
     max_size = size;
 }
 
@@ -282,7 +326,73 @@ template<typename T> void TSQueue<T>::set_max_size(size_t size)
 
 template<typename T> size_t TSQueue<T>::get_max_size()
 {
-    std::lock_guard<std::recursive_mutex> lock(m);
+    std::lock_guard<AtlRecursiveMutex> lock(m);
     return max_size;
 }
+
+/**
+* @brief Sets a function called whenever data is added, so a consumer can be
+*        woken without blocking in dequeue.  It runs with the queue locked and
+*        must not use the queue.
+*
+* @param f The function, or nullptr to remove it
+*/
+template<typename T> void TSQueue<T>::set_enqueue_callback(std::function<void()> f)
+{
+    std::lock_guard<AtlRecursiveMutex> lock(m);
+    on_enqueue = f;
+}
+
+/**
+* @brief Removes the head of the queue into data if there is one.  Otherwise
+*           the next data added is moved into data instead of being queued,
+*           and ready is called, so a consumer can wait without a thread.
+*           Waiting consumers are served in order, before blocked dequeues.
+*           ready runs with the queue locked and must not use the queue;
+*           data must stay valid until then.
+*
+* @param data Where to put the data
+* @param ready Called once data has been filled in later
+*
+* @return true if data was filled in right away and ready will not be called
+*/
+template<typename T> bool TSQueue<T>::async_dequeue(T& data, std::function<void()> ready)
+{
+    std::lock_guard<AtlRecursiveMutex> lock(m);
+
+    if (length > 0 && dequeue_waiters.empty()) {
+        data = std::move(head->data);
+        head = head->prev;
+        length--;
+
+        if (!length) {
+            dequeue_cv.notify_all();
+        }
+        return true;
+    }
+
+    dequeue_waiters.emplace_back(&data, ready);
+    return false;
+}
+
+/**
+* @brief Moves data from the head of the queue to async_dequeue waiters,
+*           oldest first.  Called with the lock held.
+*/
+template<typename T> void TSQueue<T>::hand_off()
+{
+    while (length > 0 && !dequeue_waiters.empty()) {
+        std::pair<T*, std::function<void()>> waiter = std::move(dequeue_waiters.front());
+        dequeue_waiters.pop_front();
+
+        *waiter.first = std::move(head->data);
+        head = head->prev;
+        length--;
+
+        if (!length) {
+            dequeue_cv.notify_all();
+        }
+        waiter.second();
+    }
+}
 }
@@ -0,0 +1,184 @@
+/**
+ * \file WorkStealingDeque.tcc
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace atl
+{
+
+/**
+* @brief Chase-Lev work-stealing deque
+*
+* One owner thread pushes and pops at the bottom (LIFO, so it keeps working
+* on what is hot in its cache); any number of thieves steal from the top
+* (FIFO, so they take the oldest and usually largest pieces of work). The
+* owner's operations only contend with thieves when one element is left.
+* The ring buffer doubles when full; replaced buffers are kept until the
+* deque is destroyed since a thief may still be reading them.
+*
+* Follows the C11 formulation of Le, Pop, Cohen and Zappa Nardelli,
+* "Correct and Efficient Work-Stealing for Weak Memory Models" (PPoPP 2013).
+*
+* @tparam T A trivially copyable type, normally a pointer to a task
+*/
+template <typename T> class WorkStealingDeque
+{
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "WorkStealingDeque elements are copied without synchronization");
+
+    struct Buffer {
+        int64_t                         mask;       //<! capacity - 1, capacity is a power of two
+        std::unique_ptr<std::atomic<T>[]> slots;    //<! Ring buffer
+
+        Buffer(int64_t capacity) : mask(capacity - 1), slots(new std::atomic<T>[capacity]) {}
+        // Release/acquire on the slot itself (rather than fences alone) is
+        // free on x86 and lets race detectors see what a thief reads
+        T get(int64_t i) { return slots[i & mask].load(std::memory_order_acquire); }
+        void put(int64_t i, T v) { slots[i & mask].store(v, std::memory_order_release); }
+    };
+
+    std::atomic<int64_t>                    m_top;      //<! Next index to steal
+    std::atomic<int64_t>                    m_bottom;   //<! Next index to push
+    std::atomic<Buffer*>                    m_buffer;   //<! Current ring buffer
+    std::vector<std::unique_ptr<Buffer>>    m_buffers;  //<! Every buffer ever used, owner only
+
+    Buffer* grow(Buffer* old, int64_t top, int64_t bottom);
+
+public:
+    WorkStealingDeque(int64_t capacity = 64);
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    void push(T item);          //<! Owner: add to the bottom
+    bool pop(T& item);          //<! Owner: take from the bottom
+    bool steal(T& item);        //<! Any thread: take from the top
+    size_t size() const;        //<! Approximate number of elements
+    bool empty() const;         //<! Approximate emptiness
+};
+
+/**
+* @brief Constructor
+*
+* @param capacity Initial capacity, rounded up to a power of two
+*/
+template<typename T> WorkStealingDeque<T>::WorkStealingDeque(int64_t capacity)
+    : m_top(0), m_bottom(0)
+{
+    int64_t c = 1;
+    while (c < capacity) {
+        c *= 2;
+    }
+    m_buffers.emplace_back(new Buffer(c));
+    m_buffer.store(m_buffers.back().get(), std::memory_order_relaxed);
+}
+
+/**
+* @brief Replaces a full buffer with one twice as large
+*/
+template<typename T> typename WorkStealingDeque<T>::Buffer*
+WorkStealingDeque<T>::grow(Buffer* old, int64_t top, int64_t bottom)
+{
+    Buffer* b = new Buffer(2 * (old->mask + 1));
+    for (int64_t i = top; i < bottom; i++) {
+        b->put(i, old->get(i));
+    }
+    m_buffers.emplace_back(b);
+    m_buffer.store(b, std::memory_order_release);
+    return b;
+}
+
+/**
+* @brief Adds an element at the bottom. Only the owner may call this.
+*
+* @param item The element to add
+*/
+template<typename T> void WorkStealingDeque<T>::push(T item)
+{
+    int64_t b = m_bottom.load(std::memory_order_relaxed);
+    int64_t t = m_top.load(std::memory_order_acquire);
+    Buffer* buf = m_buffer.load(std::memory_order_relaxed);
+    if (b - t > buf->mask) {
+        buf = grow(buf, t, b);
+    }
+    buf->put(b, item);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_bottom.store(b + 1, std::memory_order_release);
+}
+
+/**
+* @brief Removes the most recently pushed element. Only the owner may call this.
+*
+* @param item Set to the element if one was removed
+* @return true if an element was removed
+*/
+template<typename T> bool WorkStealingDeque<T>::pop(T& item)
+{
+    int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+    Buffer* buf = m_buffer.load(std::memory_order_relaxed);
+    m_bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = m_top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    item = buf->get(b);
+    if (t == b) {
+        // Last element: race the thieves for it
+        bool won = m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                 std::memory_order_relaxed);
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+        return won;
+    }
+    return true;
+}
+
+/**
+* @brief Removes the oldest element. Safe from any thread.
+*
+* @param item Set to the element if one was removed
+* @return true if an element was removed; false if the deque was empty or
+*         another thread took the element first
+*/
+template<typename T> bool WorkStealingDeque<T>::steal(T& item)
+{
+    int64_t t = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = m_bottom.load(std::memory_order_acquire);
+    if (t >= b) {
+        return false;
+    }
+
+    Buffer* buf = m_buffer.load(std::memory_order_acquire);
+    item = buf->get(t);
+    return m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                         std::memory_order_relaxed);
+}
+
+/**
+* @brief Returns the number of elements, which may be stale by the time it is used
+*/
+template<typename T> size_t WorkStealingDeque<T>::size() const
+{
+    int64_t b = m_bottom.load(std::memory_order_relaxed);
+    int64_t t = m_top.load(std::memory_order_relaxed);
+    return b > t ? (size_t)(b - t) : 0;
+}
+
+/**
+* @brief Returns true if there appear to be no elements
+*/
+template<typename T> bool WorkStealingDeque<T>::empty() const
+{
+    return size() == 0;
+}
+}
@@ -0,0 +1,170 @@
+/**
+ * \file AdaptiveMutex.cpp
+ **/
+
+#include "AdaptiveMutex.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif //__linux__
+
+#ifdef USE_HELGRIND
+#include "helgrind.h"
+#endif //USE_HELGRIND
+
+namespace atl
+{
+    //Out-of-class definitions so the constants may be bound to references
+    //(std::min) without relying on the optimizer to fold them away
+    const uint32_t AdaptiveMutex::UNLOCKED;
+    const uint32_t AdaptiveMutex::LOCKED;
+    const uint32_t AdaptiveMutex::PARKED;
+    const int AdaptiveMutex::MIN_SPIN;
+    const int AdaptiveMutex::MAX_SPIN;
+
+    /**
+     * Constructor
+     */
+    AdaptiveMutex::AdaptiveMutex(): m_state(UNLOCKED), m_spinEstimate(0)
+    {
+#ifdef USE_HELGRIND
+        ANNOTATE_RWLOCK_CREATE(this);
+#endif //USE_HELGRIND
+    }
+
+    AdaptiveMutex::~AdaptiveMutex()
+    {
+#ifdef USE_HELGRIND
+        ANNOTATE_RWLOCK_DESTROY(this);
+#endif //USE_HELGRIND
+    }
+
+#ifdef __linux__
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                  "futex needs a plain 32-bit word");
+
+    /**
+     * Parks the calling thread while the lock is PARKED
+     */
+    void AdaptiveMutex::wait()
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_state), FUTEX_WAIT_PRIVATE,
+                PARKED, nullptr, nullptr, 0);
+    }
+
+    /**
+     * Wakes one parked thread
+     */
+    void AdaptiveMutex::wake()
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_state), FUTEX_WAKE_PRIVATE,
+                1, nullptr, nullptr, 0);
+    }
+#else
+    /**
+     * Parks the calling thread while the lock is PARKED
+     */
+    void AdaptiveMutex::wait()
+    {
+        std::unique_lock<std::mutex> lock(m_parkMutex);
+        while (m_state.load(std::memory_order_relaxed) == PARKED) {
+            m_parkCond.wait(lock);
+        }
+    }
+
+    /**
+     * Wakes one parked thread
+     */
+    void AdaptiveMutex::wake()
+    {
+        // See shared_mutex::wake()
+        { std::lock_guard<std::mutex> lock(m_parkMutex); }
+        m_parkCond.notify_one();
+    }
+#endif
+
+    /**
+     * Locks a thread
+     */
+    void AdaptiveMutex::lock()
+    {
+        uint32_t s = UNLOCKED;
+        if (!m_state.compare_exchange_strong(s, LOCKED, std::memory_order_acquire)) {
+            lockSlow();
+        }
+#ifdef USE_HELGRIND
+        ANNOTATE_RWLOCK_ACQUIRED(this, 1);
+#endif //USE_HELGRIND
+    }
+
+    /**
+     * Spins, then parks, until the lock is acquired
+     *
+     * A thread that wakes from parking takes the lock as PARKED since it
+     * cannot tell whether others are still parked; at worst the next
+     * unlock() makes one unnecessary wake call.
+     */
+    void AdaptiveMutex::lockSlow()
+    {
+        int estimate = m_spinEstimate.load(std::memory_order_relaxed);
+        int limit = std::min(MAX_SPIN, 2 * estimate + MIN_SPIN);
+        for (int spins = 0; spins < limit; spins++) {
+            uint32_t s = m_state.load(std::memory_order_relaxed);
+            if (s == UNLOCKED
+                    && m_state.compare_exchange_weak(s, LOCKED, std::memory_order_acquire)) {
+                m_spinEstimate.store(estimate + (spins - estimate) / 8, std::memory_order_relaxed);
+                return;
+            }
+            cpu_relax();
+        }
+        m_spinEstimate.store(estimate - estimate / 8, std::memory_order_relaxed);
+
+        while (m_state.exchange(PARKED, std::memory_order_acquire) != UNLOCKED) {
+            wait();
+        }
+    }
+
+    /**
+     * Checks if a lock is in place
+     *
+     * @return Returns false if there is a lock
+     */
+    bool AdaptiveMutex::try_lock()
+    {
+        uint32_t s = UNLOCKED;
+        bool locked = m_state.compare_exchange_strong(s, LOCKED, std::memory_order_acquire);
+#ifdef USE_HELGRIND
+        if(locked) {
+            ANNOTATE_RWLOCK_ACQUIRED(this, 1);
+        }
+#endif //USE_HELGRIND
+        return locked;
+    }
+
+    /**
+     * Unlocks a thread
+     */
+    void AdaptiveMutex::unlock()
+    {
+#ifdef USE_HELGRIND
+        ANNOTATE_RWLOCK_RELEASED(this, 1);
+#endif //USE_HELGRIND
+        if (m_state.exchange(UNLOCKED, std::memory_order_release) == PARKED) {
+            wake();
+        }
+    }
+
+    /**
+     * Returns the current spin estimate, for tuning and tests
+     *
+     * @return Average number of spins that recent contended locks needed
+     */
+    int AdaptiveMutex::spinEstimate() const
+    {
+        return m_spinEstimate.load(std::memory_order_relaxed);
+    }
+}
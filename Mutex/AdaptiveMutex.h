@@ -0,0 +1,60 @@
+/**
+ * \file AdaptiveMutex.h
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include "SpinLock.h"
+
+namespace atl
+{
+    /**
+     * @class AdaptiveMutex
+     *
+     * @brief Mutex that spins briefly before parking the thread
+     *
+     * An uncontended lock() is one compare-and-swap. A contended lock()
+     * spins (test-and-test-and-set with cpu_relax) for up to twice the
+     * number of iterations that recent contended acquisitions needed, then
+     * parks on a futex (a condition variable where there is none). The
+     * estimate follows successful spins and decays when spinning fails, so
+     * locks with short critical sections rarely enter the kernel while
+     * locks held across long work stop wasting cycles. unlock() only makes
+     * a system call if a thread is parked.
+     */
+    class AdaptiveMutex
+    {
+        private:
+            static const uint32_t UNLOCKED = 0;
+            static const uint32_t LOCKED = 1;
+            static const uint32_t PARKED = 2;   //!< Locked, and threads may be parked
+
+            static const int MIN_SPIN = 10;     //!< Brief spins even when the estimate is 0
+            static const int MAX_SPIN = 1000;   //!< Brief upper bound on spins per lock()
+
+            void lockSlow();
+            void wait();
+            void wake();
+
+            std::atomic<uint32_t> m_state;      //!< Brief UNLOCKED, LOCKED or PARKED
+            std::atomic<int> m_spinEstimate;    //!< Brief running average of spins that succeeded
+#ifndef __linux__
+            std::mutex m_parkMutex;             //!< Brief guards parking where there is no futex
+            std::condition_variable m_parkCond; //!< Brief parked threads wait here
+#endif
+
+        public:
+            AdaptiveMutex();
+            virtual ~AdaptiveMutex();
+            AdaptiveMutex( const AdaptiveMutex& other ) = delete;
+            AdaptiveMutex& operator=( const AdaptiveMutex& ) = delete;
+            void lock();
+            bool try_lock();
+            void unlock();
+            int spinEstimate() const;
+    };
+}
@@ -16,12 +16,21 @@
 #include <thread>
 #include <iostream>
 #include <mutex>
+#include "SpinLock.h"
+#include "AdaptiveMutex.h"
+
+#ifdef USE_LOCK_PROFILE
+#include "LockProfiler.h"
+#endif
 
 namespace atl {
 
 /**
 *  \brief mutex wrapper to print when acquired and released
 *  does nothing if DEBUG not defined
+*
+*  With USE_LOCK_PROFILE (and without DEBUG) it reports acquisitions, waits
+*  and sampled hold times to LockProfiler instead.
 **/
 template <typename T> 
 class MutexWrap : public T
@@ -91,13 +100,110 @@ public:
 #endif
 	}
 
+#elif defined(USE_LOCK_PROFILE)
+public:
+
+	/**
+	*  \brief wraps lock; only waits that miss the try_lock fast path are timed
+	**/
+	ATL_NOINLINE void lock()
+	{
+		const void* site = ATL_LOCK_SITE();
+		if (T::try_lock()) {
+			entered(site, 0, false);
+			return;
+		}
+		int64_t start = LockProfiler::now();
+		T::lock();
+		entered(site, LockProfiler::now() - start, true);
+	}
+
+	/**
+	*  \brief wraps unlock, recording the hold time if it was sampled
+	**/
+	void unlock()
+	{
+		const void* site = m_site;
+		int64_t start = --m_depth == 0 ? m_holdStart : 0;
+		T::unlock();
+		if (start) {
+			LockProfiler::held(site, LockProfiler::now() - start);
+		}
+	}
+
+	/**
+	*  \brief wraps try_lock
+	**/
+	ATL_NOINLINE bool try_lock()
+	{
+		if (!T::try_lock()) {
+			return false;
+		}
+		entered(ATL_LOCK_SITE(), 0, false);
+		return true;
+	}
+
+	/**
+	*  \brief wraps lock_shared for reader/writer locks; shared holds are
+	*  not timed since several threads hold them at once
+	**/
+	ATL_NOINLINE void lock_shared()
+	{
+		const void* site = ATL_LOCK_SITE();
+		if (T::try_lock_shared()) {
+			LockProfiler::acquired(site, 0, false);
+			return;
+		}
+		int64_t start = LockProfiler::now();
+		T::lock_shared();
+		LockProfiler::acquired(site, LockProfiler::now() - start, true);
+	}
+
+	/**
+	*  \brief wraps try_lock_shared
+	**/
+	ATL_NOINLINE bool try_lock_shared()
+	{
+		if (!T::try_lock_shared()) {
+			return false;
+		}
+		LockProfiler::acquired(ATL_LOCK_SITE(), 0, false);
+		return true;
+	}
+
+private:
+
+	/**
+	*  \brief bookkeeping once the lock is held; only the holder touches
+	*  these members, and only the outermost recursive hold is timed
+	**/
+	void entered(const void* site, int64_t waitNs, bool contended)
+	{
+		if (m_depth++ == 0) {
+			m_site = site;
+			m_holdStart = LockProfiler::sample() ? LockProfiler::now() : 0;
+		}
+		LockProfiler::acquired(site, waitNs, contended);
+	}
+
+	const void* m_site = nullptr;   //!< Site of the outermost hold
+	int64_t m_holdStart = 0;        //!< Start of a sampled hold, 0 if not sampled
+	unsigned m_depth = 0;           //!< Recursion depth of the current holder
 #endif
 };
 
 
 
 typedef MutexWrap<std::recursive_mutex> AtlRecursiveMutex;
+typedef MutexWrap<SpinLock> AtlSpinLock;
+typedef MutexWrap<AdaptiveMutex> AtlAdaptiveMutex;
+
+// USE_ADAPTIVE_MUTEX makes every AtlMutex spin before parking
+#ifdef USE_ADAPTIVE_MUTEX
+typedef AtlAdaptiveMutex AtlMutex;
+#else
 typedef MutexWrap<std::mutex> AtlMutex;
+#endif
 
 } // namespace atl
 
@@ -0,0 +1,300 @@
+/**
+ * \file LockProfiler.cpp
+ **/
+
+#include "LockProfiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __GNUC__
+#include <execinfo.h>
+#endif
+
+namespace
+{
+    const int MAX_STACK_DEPTH = 16;     //!< Frames kept per sampled stack
+    const int SKIPPED_FRAMES = 2;       //!< acquired() and the lock wrapper
+
+    /**
+     * Counters for one call site
+     */
+    struct SiteStats
+    {
+        uint64_t acquisitions = 0;
+        uint64_t contended = 0;
+        int64_t  waitTotal = 0;         //!< Nanoseconds
+        int64_t  waitMax = 0;
+        uint64_t holdSamples = 0;
+        int64_t  holdTotal = 0;
+        int64_t  holdMax = 0;
+        std::vector<void*> stack;       //!< First sampled stack of a contended acquisition
+
+        void merge(const SiteStats& o)
+        {
+            acquisitions += o.acquisitions;
+            contended += o.contended;
+            waitTotal += o.waitTotal;
+            waitMax = std::max(waitMax, o.waitMax);
+            holdSamples += o.holdSamples;
+            holdTotal += o.holdTotal;
+            holdMax = std::max(holdMax, o.holdMax);
+            if (stack.empty()) {
+                stack = o.stack;
+            }
+        }
+    };
+
+    typedef std::unordered_map<const void*, SiteStats> SiteMap;
+
+    struct ThreadStats;
+
+    /**
+     * Live per-thread tables and the merged tables of exited threads
+     */
+    struct Registry
+    {
+        std::mutex                  mutex;
+        std::set<ThreadStats*>      live;
+        SiteMap                     retired;
+        std::atomic<unsigned>       sampleInterval;
+
+        Registry() : sampleInterval(atl::LockProfiler::DEFAULT_SAMPLE_INTERVAL) {}
+    };
+
+    /**
+     * Never destroyed, so threads exiting during shutdown can still retire
+     */
+    Registry& registry()
+    {
+        static Registry* r = new Registry();
+        return *r;
+    }
+
+    /**
+     * One thread's statistics. Its mutex is only contended while a report
+     * is being merged.
+     */
+    struct ThreadStats
+    {
+        std::mutex  mutex;
+        SiteMap     sites;
+        unsigned    sampleCounter = 0;
+
+        ThreadStats()
+        {
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            registry().live.insert(this);
+        }
+
+        ~ThreadStats()
+        {
+            Registry& r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            for (auto& s : sites) {
+                r.retired[s.first].merge(s.second);
+            }
+            r.live.erase(this);
+        }
+    };
+
+    ThreadStats& myStats()
+    {
+        static thread_local ThreadStats stats;
+        return stats;
+    }
+
+    std::string symbolize(void* address)
+    {
+        std::string name;
+#ifdef __GNUC__
+        char** symbols = backtrace_symbols(&address, 1);
+        if (symbols) {
+            name = symbols[0];
+            free(symbols);
+            return name;
+        }
+#endif
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%p", address);
+        return buf;
+    }
+}
+
+namespace atl
+{
+    /**
+     * Records one acquisition of a lock
+     *
+     * @param site Return address of the lock call
+     * @param waitNs Nanoseconds spent blocked, 0 if not contended
+     * @param contended True if the try_lock fast path failed
+     */
+    void LockProfiler::acquired(const void* site, int64_t waitNs, bool contended)
+    {
+        ThreadStats& t = myStats();
+        bool wantStack = false;
+        {
+            std::lock_guard<std::mutex> lock(t.mutex);
+            SiteStats& s = t.sites[site];
+            s.acquisitions++;
+            if (!contended) {
+                return;
+            }
+            s.contended++;
+            s.waitTotal += waitNs;
+            s.waitMax = std::max(s.waitMax, waitNs);
+            wantStack = s.stack.empty();
+        }
+
+#ifdef __GNUC__
+        if (wantStack && sample()) {
+            void* frames[MAX_STACK_DEPTH + SKIPPED_FRAMES];
+            int depth = backtrace(frames, MAX_STACK_DEPTH + SKIPPED_FRAMES);
+            std::vector<void*> stack;
+            for (int i = SKIPPED_FRAMES; i < depth; i++) {
+                stack.push_back(frames[i]);
+            }
+            std::lock_guard<std::mutex> lock(t.mutex);
+            t.sites[site].stack.swap(stack);
+        }
+#endif
+    }
+
+    /**
+     * Records a sampled hold time
+     *
+     * @param site Return address of the lock call that acquired the lock
+     * @param holdNs Nanoseconds between acquisition and release
+     */
+    void LockProfiler::held(const void* site, int64_t holdNs)
+    {
+        ThreadStats& t = myStats();
+        std::lock_guard<std::mutex> lock(t.mutex);
+        SiteStats& s = t.sites[site];
+        s.holdSamples++;
+        s.holdTotal += holdNs;
+        s.holdMax = std::max(s.holdMax, holdNs);
+    }
+
+    /**
+     * Returns true for one call in every sample interval on this thread
+     */
+    bool LockProfiler::sample()
+    {
+        unsigned interval = registry().sampleInterval.load(std::memory_order_relaxed);
+        return ++myStats().sampleCounter % interval == 0;
+    }
+
+    /**
+     * Monotonic time in nanoseconds
+     */
+    int64_t LockProfiler::now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * Sets how often hold times and stacks are sampled
+     *
+     * @param interval Sample one in this many acquisitions (1 samples all)
+     */
+    void LockProfiler::setSampleInterval(unsigned interval)
+    {
+        registry().sampleInterval = std::max(1u, interval);
+    }
+
+    /**
+     * Merges every thread's statistics into a report
+     *
+     * @return JsonBox value with a "sites" array sorted by total wait time,
+     *         longest first. Times are in microseconds.
+     */
+    JsonBox::Value LockProfiler::report()
+    {
+        SiteMap merged;
+        Registry& r = registry();
+        {
+            std::lock_guard<std::mutex> lock(r.mutex);
+            merged = r.retired;
+            for (ThreadStats* t : r.live) {
+                std::lock_guard<std::mutex> tlock(t->mutex);
+                for (auto& s : t->sites) {
+                    merged[s.first].merge(s.second);
+                }
+            }
+        }
+
+        std::vector<std::pair<const void*, SiteStats>> sorted(merged.begin(), merged.end());
+        std::sort(sorted.begin(), sorted.end(),
+                [](const std::pair<const void*, SiteStats>& a,
+                   const std::pair<const void*, SiteStats>& b) {
+                    return a.second.waitTotal > b.second.waitTotal;
+                });
+
+        JsonBox::Array sites;
+        for (auto& entry : sorted) {
+            const SiteStats& s = entry.second;
+            JsonBox::Value site;
+            site["site"] = symbolize(const_cast<void*>(entry.first));
+            site["acquisitions"] = (double)s.acquisitions;
+            site["contended"] = (double)s.contended;
+            site["waitTotalUs"] = s.waitTotal / 1e3;
+            site["waitMaxUs"] = s.waitMax / 1e3;
+            site["holdSamples"] = (double)s.holdSamples;
+            site["holdMeanUs"] = s.holdSamples ? s.holdTotal / 1e3 / s.holdSamples : 0.0;
+            site["holdMaxUs"] = s.holdMax / 1e3;
+
+            JsonBox::Array stack;
+            for (void* frame : s.stack) {
+                stack.push_back(JsonBox::Value(symbolize(frame)));
+            }
+            site["stack"] = stack;
+            sites.push_back(site);
+        }
+
+        JsonBox::Value result;
+        result["sampleInterval"] = (int)r.sampleInterval.load();
+        result["sites"] = sites;
+        return result;
+    }
+
+    /**
+     * Writes report() to a file
+     *
+     * @param filename Path of the JSON file to write
+     * @return true if the file was written
+     */
+    bool LockProfiler::writeReport(std::string filename)
+    {
+        std::ofstream out(filename);
+        if (!out) {
+            return false;
+        }
+        report().writeToStream(out);
+        return out.good();
+    }
+
+    /**
+     * Discards all statistics collected so far
+     */
+    void LockProfiler::reset()
+    {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.retired.clear();
+        for (ThreadStats* t : r.live) {
+            std::lock_guard<std::mutex> tlock(t->mutex);
+            t->sites.clear();
+        }
+    }
+}
@@ -0,0 +1,53 @@
+/**
+ * \file LockProfiler.h
+ **/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "JsonBox.h"
+
+#ifdef __GNUC__
+#define ATL_LOCK_SITE() __builtin_return_address(0)   //!< Address the profiled lock call returns to
+#define ATL_NOINLINE __attribute__((noinline))
+#else
+#define ATL_LOCK_SITE() nullptr
+#define ATL_NOINLINE
+#endif
+
+namespace atl
+{
+    /**
+     * @class LockProfiler
+     *
+     * @brief Collects lock contention statistics per call site
+     *
+     * Locks compiled with USE_LOCK_PROFILE (MutexWrap, and through it
+     * AtlMutex, AtlRecursiveMutex and AtlSharedMutex) report every
+     * acquisition here. A site is the return address of the lock call, so
+     * each lock_guard in the code is counted separately once it is inlined
+     * into its caller (optimized builds).
+     *
+     * Only acquisitions that miss the try_lock fast path are timed. Hold
+     * times are measured on one acquisition in every sampleInterval, and
+     * the first contended acquisition per site on a thread that falls on a
+     * sample records a stack. Statistics accumulate in per-thread tables,
+     * so recording does not touch shared state; report() merges them.
+     */
+    class LockProfiler
+    {
+        public:
+            static const unsigned DEFAULT_SAMPLE_INTERVAL = 64; //!< Brief one in this many is sampled
+
+            static void acquired(const void* site, int64_t waitNs, bool contended);
+            static void held(const void* site, int64_t holdNs);
+            static bool sample();
+            static int64_t now();
+
+            static void setSampleInterval(unsigned interval);
+            static JsonBox::Value report();
+            static bool writeReport(std::string filename);
+            static void reset();
+    };
+}
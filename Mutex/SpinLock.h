@@ -0,0 +1,95 @@
+/**
+ * \file SpinLock.h
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace atl
+{
+    /**
+     * Tells the CPU the caller is in a spin-wait loop, which saves power
+     * and lets a hyperthread sibling run
+     */
+    inline void cpu_relax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        __asm__ __volatile__("yield");
+#else
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+    }
+
+    /**
+     * @class SpinLock
+     *
+     * @brief Test-and-test-and-set lock for critical sections of a few
+     *        instructions
+     *
+     * Waiters spin on a plain load, so the cache line stays shared until
+     * the holder releases it, and back off exponentially (in pause
+     * instructions) between attempts. Once the backoff reaches its cap the
+     * waiter also yields its time slice, so an oversubscribed machine does
+     * not spin away the holder's quantum. Never parks in the kernel; use
+     * AdaptiveMutex where the lock may be held for long.
+     */
+    class SpinLock
+    {
+        private:
+            static const unsigned MAX_BACKOFF = 1024; //!< Brief pause instructions between attempts
+
+            std::atomic_bool m_locked; //!< Brief true while held
+
+        public:
+            SpinLock() : m_locked(false) {}
+            SpinLock( const SpinLock& other ) = delete;
+            SpinLock& operator=( const SpinLock& ) = delete;
+
+            /**
+             * Locks a thread
+             */
+            void lock()
+            {
+                unsigned backoff = 1;
+                while (m_locked.exchange(true, std::memory_order_acquire)) {
+                    do {
+                        for (unsigned i = 0; i < backoff; i++) {
+                            cpu_relax();
+                        }
+                        if (backoff < MAX_BACKOFF) {
+                            backoff *= 2;
+                        } else {
+                            std::this_thread::yield();
+                        }
+                    } while (m_locked.load(std::memory_order_relaxed));
+                }
+            }
+
+            /**
+             * Checks if a lock is in place
+             *
+             * @return Returns false if there is a lock
+             */
+            bool try_lock()
+            {
+                return !m_locked.load(std::memory_order_relaxed)
+                    && !m_locked.exchange(true, std::memory_order_acquire);
+            }
+
+            /**
+             * Unlocks a thread
+             */
+            void unlock()
+            {
+                m_locked.store(false, std::memory_order_release);
+            }
+    };
+}
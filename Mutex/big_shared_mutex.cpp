@@ -0,0 +1,253 @@
+/**
+ * \file big_shared_mutex.cpp
+ **/
+
+#include "big_shared_mutex.h"
+
+#include <chrono>
+#include <new>
+#include <set>
+#include <thread>
+
+#ifdef USE_HELGRIND
+#include "helgrind.h"
+#endif //USE_HELGRIND
+
+namespace
+{
+    /**
+     * Numbers live threads densely from 0 so long-lived threads keep low
+     * numbers; a thread's number is reused after it exits
+     */
+    struct ThreadIndex
+    {
+        unsigned value;
+
+        static std::mutex& mutex() { static std::mutex m; return m; }
+        static std::set<unsigned>& freed() { static std::set<unsigned> f; return f; }
+
+        ThreadIndex()
+        {
+            static unsigned next = 0;
+            std::lock_guard<std::mutex> lock(mutex());
+            if (freed().empty()) {
+                value = next++;
+            } else {
+                value = *freed().begin();
+                freed().erase(freed().begin());
+            }
+        }
+
+        ~ThreadIndex()
+        {
+            std::lock_guard<std::mutex> lock(mutex());
+            freed().insert(value);
+        }
+    };
+
+    int64_t steadyNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+namespace atl
+{
+    /**
+     * Constructor
+     *
+     * Allocates two slots per hardware thread, rounded up to a power of two.
+     */
+    big_shared_mutex::big_shared_mutex()
+        : m_bias(true), m_inhibitUntil(0), m_numSlots(1)
+    {
+        unsigned threads = 2 * std::thread::hardware_concurrency();
+        while (m_numSlots < threads && m_numSlots < MAX_SLOTS) {
+            m_numSlots *= 2;
+        }
+
+        m_slotMemory.reset(new char[m_numSlots * sizeof(Slot) + alignof(Slot)]);
+        uintptr_t p = reinterpret_cast<uintptr_t>(m_slotMemory.get());
+        p = (p + alignof(Slot) - 1) & ~(uintptr_t)(alignof(Slot) - 1);
+        m_slots = reinterpret_cast<Slot*>(p);
+        for (unsigned i = 0; i < m_numSlots; i++) {
+            new (&m_slots[i]) Slot();
+            m_slots[i].readers.store(0, std::memory_order_relaxed);
+        }
+#ifdef USE_HELGRIND
+        ANNOTATE_RWLOCK_CREATE(this);
+#endif //USE_HELGRIND
+    }
+
+    big_shared_mutex::~big_shared_mutex()
+    {
+#ifdef USE_HELGRIND
+        ANNOTATE_RWLOCK_DESTROY(this);
+#endif //USE_HELGRIND
+    }
+
+    /**
+     * Returns the calling thread's reader slot
+     *
+     * Only the owning thread changes its slot, so a non-zero count means the
+     * caller itself holds fast-path read locks.
+     *
+     * @return The slot, or nullptr if the thread is numbered beyond the slots
+     */
+    big_shared_mutex::Slot* big_shared_mutex::mySlot()
+    {
+        static thread_local ThreadIndex index;
+        return index.value < m_numSlots ? &m_slots[index.value] : nullptr;
+    }
+
+    /**
+     * Takes a read lock through the caller's slot if the lock is biased
+     *
+     * The slot is published before bias is re-checked, so a writer that
+     * clears bias and then scans the slots either sees this reader or this
+     * reader sees the cleared bias and backs out.
+     *
+     * @return true if the read lock is held
+     */
+    bool big_shared_mutex::tryFastShared()
+    {
+        Slot* slot = mySlot();
+        if (!slot || !m_bias.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        slot->readers.fetch_add(1, std::memory_order_seq_cst);
+        if (m_bias.load(std::memory_order_seq_cst)) {
+            return true;
+        }
+        slot->readers.fetch_sub(1, std::memory_order_release);
+        return false;
+    }
+
+    /**
+     * Turns reader bias off and waits for fast-path readers to leave
+     *
+     * Must be called with the underlying lock held exclusively. Bias is
+     * inhibited for INHIBIT_MULTIPLIER times as long as the scan took.
+     */
+    void big_shared_mutex::revokeBias()
+    {
+        int64_t start = steadyNs();
+        m_bias.store(false, std::memory_order_seq_cst);
+        for (unsigned i = 0; i < m_numSlots; i++) {
+            while (m_slots[i].readers.load(std::memory_order_acquire) != 0) {
+                std::this_thread::yield();
+            }
+        }
+        int64_t end = steadyNs();
+        m_inhibitUntil.store(end + (end - start) * INHIBIT_MULTIPLIER, std::memory_order_relaxed);
+    }
+
+    /**
+     * Locks a thread
+     */
+    void big_shared_mutex::lock()
+    {
+        m_mutex.lock();
+        if (m_bias.load(std::memory_order_relaxed)) {
+            revokeBias();
+        }
+#ifdef USE_HELGRIND
+        ANNOTATE_RWLOCK_ACQUIRED(this, 1);
+#endif //USE_HELGRIND
+    }
+
+    /**
+     * Checks if a lock is in place
+     *
+     * Fails rather than waits if fast-path readers are inside.
+     *
+     * @return Returns false if there is a lock
+     */
+    bool big_shared_mutex::try_lock()
+    {
+        if (!m_mutex.try_lock()) {
+            return false;
+        }
+        if (m_bias.load(std::memory_order_relaxed)) {
+            m_bias.store(false, std::memory_order_seq_cst);
+            for (unsigned i = 0; i < m_numSlots; i++) {
+                if (m_slots[i].readers.load(std::memory_order_acquire) != 0) {
+                    m_bias.store(true, std::memory_order_release);
+                    m_mutex.unlock();
+                    return false;
+                }
+            }
+        }
+#ifdef USE_HELGRIND
+        ANNOTATE_RWLOCK_ACQUIRED(this, 1);
+#endif //USE_HELGRIND
+        return true;
+    }
+
+    /**
+     * Unlocks a thread
+     */
+    void big_shared_mutex::unlock()
+    {
+#ifdef USE_HELGRIND
+        ANNOTATE_RWLOCK_RELEASED(this, 1);
+#endif //USE_HELGRIND
+        m_mutex.unlock();
+    }
+
+    /**
+     * Takes a read lock
+     *
+     * Readers that find the bias off use the underlying lock, and re-enable
+     * the bias once the inhibit period after the last revocation is over.
+     */
+    void big_shared_mutex::lock_shared()
+    {
+        if (!tryFastShared()) {
+            m_mutex.lock_shared();
+            if (!m_bias.load(std::memory_order_relaxed)
+                    && steadyNs() >= m_inhibitUntil.load(std::memory_order_relaxed)) {
+                m_bias.store(true, std::memory_order_release);
+            }
+        }
+#ifdef USE_HELGRIND
+        ANNOTATE_RWLOCK_ACQUIRED(this, 0);
+#endif //USE_HELGRIND
+    }
+
+    /**
+     * Checks if a lock is in place
+     *
+     * @return Returns false if there is a lock
+     */
+    bool big_shared_mutex::try_lock_shared()
+    {
+        bool rc = tryFastShared() || m_mutex.try_lock_shared();
+#ifdef USE_HELGRIND
+        if(rc) {
+            ANNOTATE_RWLOCK_ACQUIRED(this, 0);
+        }
+#endif //USE_HELGRIND
+        return rc;
+    }
+
+    /**
+     * Unlocks a shared thread
+     *
+     * A thread holding both fast-path and underlying read locks may release
+     * them in any order, since the writer waits for all of them either way.
+     */
+    void big_shared_mutex::unlock_shared()
+    {
+#ifdef USE_HELGRIND
+        ANNOTATE_RWLOCK_RELEASED(this, 0);
+#endif //USE_HELGRIND
+        Slot* slot = mySlot();
+        if (slot && slot->readers.load(std::memory_order_relaxed) > 0) {
+            slot->readers.fetch_sub(1, std::memory_order_release);
+            return;
+        }
+        m_mutex.unlock_shared();
+    }
+}
@@ -0,0 +1,68 @@
+/**
+ * \file big_shared_mutex.h
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include "shared_mutex.h"
+
+namespace atl
+{
+    /**
+     * @class big_shared_mutex
+     *
+     * @brief Reader/writer lock for read-mostly data whose readers do not
+     *        share a cache line
+     *
+     * While the lock is reader-biased, lock_shared() increments a counter
+     * in the calling thread's own slot, padded to its own cache line, so
+     * readers on different cores never touch the same line. Each lock has
+     * twice as many slots as hardware threads (at most MAX_SLOTS); threads
+     * numbered beyond that always use the underlying lock. A writer takes the
+     * underlying shared_mutex, revokes the bias and waits for every slot to
+     * drain. Revoking is expensive, so the bias stays off for a while
+     * afterwards (proportional to how long the revocation took) and readers
+     * use the underlying lock until it is re-enabled.
+     *
+     * Drop-in for shared_mutex, e.g. as the Mutex parameter of TSMap. As
+     * with shared_mutex, read locks do not nest.
+     */
+    class big_shared_mutex
+    {
+        private:
+            struct alignas(64) Slot {
+                std::atomic<uint32_t> readers; //!< Brief fast-path readers using this slot
+            };
+
+            static const unsigned MAX_SLOTS = 64;        //!< Brief upper bound on reader slots per lock
+            static const int64_t INHIBIT_MULTIPLIER = 9; //!< Brief bias stays off this many revocation times
+
+            Slot*   mySlot();
+            bool    tryFastShared();
+            void    revokeBias();
+
+            shared_mutex            m_mutex;        //!< Brief slow path and writer exclusion
+            std::atomic_bool        m_bias;         //!< Brief true while readers may use the slots
+            std::atomic<int64_t>    m_inhibitUntil; //!< Brief steady_clock ns before which bias stays off
+            unsigned                m_numSlots;     //!< Brief power of two
+            std::unique_ptr<char[]> m_slotMemory;   //!< Brief backing store, over-allocated for alignment
+            Slot*                   m_slots;
+
+        public:
+            big_shared_mutex();
+            virtual ~big_shared_mutex();
+            big_shared_mutex( const big_shared_mutex& other ) = delete;
+            big_shared_mutex& operator=( const big_shared_mutex& ) = delete;
+            void lock();
+            bool try_lock();
+            void unlock();
+            void lock_shared();
+            bool try_lock_shared();
+            void unlock_shared();
+    };
+
+    typedef basic_shared_lock<big_shared_mutex> big_shared_lock;
+}
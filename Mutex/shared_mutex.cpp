@@ -4,6 +4,13 @@
 
 #include "shared_mutex.h"
 
+#ifdef __linux__
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif //__linux__
+
 #ifdef USE_HELGRIND
 #include "helgrind.h"
 #endif //USE_HELGRIND
@@ -22,7 +29,7 @@ namespace atl
     /**
      * Constructor
      */
-    shared_mutex::shared_mutex(): readers(0)
+    shared_mutex::shared_mutex(): m_state(0)
     {
 #ifdef USE_HELGRIND
         // Due to virtual destructor, this should be a VTable pointer
@@ -30,12 +37,65 @@ namespace atl
 #endif //USE_HELGRIND
     }
 
+#ifdef __linux__
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                  "futex needs a plain 32-bit word");
+
+    /**
+     * Parks the calling thread while the state word still equals expected
+     */
+    void shared_mutex::wait(uint32_t expected)
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_state), FUTEX_WAIT_PRIVATE,
+                expected, nullptr, nullptr, 0);
+    }
+
+    /**
+     * Wakes every thread parked on the state word
+     */
+    void shared_mutex::wake()
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_state), FUTEX_WAKE_PRIVATE,
+                INT_MAX, nullptr, nullptr, 0);
+    }
+#else
+    /**
+     * Parks the calling thread while the state word still equals expected
+     */
+    void shared_mutex::wait(uint32_t expected)
+    {
+        std::unique_lock<std::mutex> lock(m_parkMutex);
+        while (m_state.load(std::memory_order_relaxed) == expected) {
+            m_parkCond.wait(lock);
+        }
+    }
+
+    /**
+     * Wakes every thread parked on the state word
+     */
+    void shared_mutex::wake()
+    {
+        // The state already changed; taking the lock orders the notify after
+        // any waiter that saw the old value has gone to sleep
+        { std::lock_guard<std::mutex> lock(m_parkMutex); }
+        m_parkCond.notify_all();
+    }
+#endif
+
     /**
      * Locks a thread
+     *
+     * Setting the writer flag first stops new readers, then this waits for
+     * the readers that are already inside to leave.
      */
     void shared_mutex::lock()
     {
-        m_mutex.lock();
+        m_writer.lock();
+        uint32_t s = m_state.fetch_or(WRITER, std::memory_order_acquire) | WRITER;
+        while (s & READER_MASK) {
+            wait(s);
+            s = m_state.load(std::memory_order_acquire);
+        }
 #ifdef USE_HELGRIND
         ANNOTATE_RWLOCK_ACQUIRED(this, 1);
 #endif //USE_HELGRIND
@@ -48,7 +108,14 @@ namespace atl
      */
     bool shared_mutex::try_lock()
     {
-        bool locked = m_mutex.try_lock();
+        if (!m_writer.try_lock()) {
+            return false;
+        }
+        uint32_t s = 0;
+        bool locked = m_state.compare_exchange_strong(s, WRITER, std::memory_order_acquire);
+        if (!locked) {
+            m_writer.unlock();
+        }
 #ifdef USE_HELGRIND
         if(locked) {
             ANNOTATE_RWLOCK_ACQUIRED(this, 1);
@@ -65,18 +132,38 @@ namespace atl
 #ifdef USE_HELGRIND
         ANNOTATE_RWLOCK_RELEASED(this, 1);
 #endif //USE_HELGRIND
-        m_mutex.unlock();
+        uint32_t s = m_state.fetch_and(~(WRITER | PARKED), std::memory_order_release);
+        if (s & PARKED) {
+            wake();
+        }
+        m_writer.unlock();
     }
 
     /**
-     * Checks if a lock is in place
-        */
+     * Takes a read lock, waiting while a writer holds or is acquiring it
+     *
+     * Must not be called by a thread that already holds a read lock on
+     * this mutex; see the class comment.
+     */
     void shared_mutex::lock_shared()
     {
-        m_read.lock();
-        readers++;
-        if( readers == 1 ) m_mutex.lock();
-        m_read.unlock();
+        uint32_t s = m_state.fetch_add(1, std::memory_order_acquire);
+        while (s & WRITER) {
+            // Back out so the writer can drain, then park until it leaves
+            s = m_state.fetch_sub(1, std::memory_order_release) - 1;
+            if ((s & WRITER) && !(s & READER_MASK)) {
+                wake();
+            }
+            while (s & WRITER) {
+                if (!(s & PARKED)
+                        && !m_state.compare_exchange_weak(s, s | PARKED, std::memory_order_relaxed)) {
+                    continue;
+                }
+                wait(s | PARKED);
+                s = m_state.load(std::memory_order_relaxed);
+            }
+            s = m_state.fetch_add(1, std::memory_order_acquire);
+        }
 #ifdef USE_HELGRIND
         ANNOTATE_RWLOCK_ACQUIRED(this, 0);
 #endif //USE_HELGRIND
@@ -89,16 +176,17 @@ namespace atl
      */
     bool shared_mutex::try_lock_shared()
     {
-        bool rc = true;
-        m_read.lock();
-        readers++;
-        if( readers == 1 ){
-            rc = m_mutex.try_lock();
-            if( !rc ){
-                readers--;
+        if (m_state.load(std::memory_order_relaxed) & WRITER) {
+            return false;
+        }
+        uint32_t s = m_state.fetch_add(1, std::memory_order_acquire);
+        bool rc = !(s & WRITER);
+        if (!rc) {
+            s = m_state.fetch_sub(1, std::memory_order_release) - 1;
+            if ((s & WRITER) && !(s & READER_MASK)) {
+                wake();
             }
         }
-        m_read.unlock();
 #ifdef USE_HELGRIND
         if(rc) {
             ANNOTATE_RWLOCK_ACQUIRED(this, 0);
@@ -109,110 +197,17 @@ namespace atl
 
     /**
      * Unlocks a shared thread
+     *
+     * The last reader out wakes a writer that is waiting for readers to drain.
      */
     void shared_mutex::unlock_shared()
     {
 #ifdef USE_HELGRIND
         ANNOTATE_RWLOCK_RELEASED(this, 0);
 #endif //USE_HELGRIND
-        m_read.lock();
-        readers--;
-        if( !readers ) m_mutex.unlock();
-        m_read.unlock();
-    }
-
-
-    ////////////////////////////////
-    // shared_lock implementation //
-    ////////////////////////////////
-
-    /**
-     * Constructor
-     */
-    shared_lock::shared_lock( shared_mutex& m )
-    {
-        owns = true;
-        m_mutex = &m;
-        m_mutex->lock_shared();
-    }
-
-    /**
-     * Constructor
-     */
-    shared_lock::shared_lock( shared_mutex& m, std::try_to_lock_t t )
-    {
-        owns = false;
-        m_mutex = &m;
-        if( m_mutex->try_lock_shared() ){
-            owns = true;
+        uint32_t s = m_state.fetch_sub(1, std::memory_order_release) - 1;
+        if ((s & WRITER) && !(s & READER_MASK)) {
+            wake();
         }
     }
-
-    /**
-     * Constructor
-     */
-    shared_lock::shared_lock( shared_mutex& m, std::defer_lock_t t )
-    {
-        owns = false;
-        m_mutex = &m;
-    }
-
-    /**
-     * Constructor
-     */
-    shared_lock::shared_lock( shared_mutex& m, std::adopt_lock_t t )
-    {
-        owns = true;
-        m_mutex = &m;
-    }
-
-    /**
-     * Destructor
-     */
-    shared_lock::~shared_lock()
-    {
-        if( owns ) m_mutex->unlock_shared();
-    }
-
-    /**
-     * Locks a thread
-     */
-    void shared_lock::lock()
-    {
-        m_mutex->lock_shared();
-        owns = true;
-    }
-
-    /**
-     * Checks if a lock is in place
-     * 
-     * @return Returns false if there is a lock
-     */
-    bool shared_lock::try_lock()
-    {
-        if( m_mutex->try_lock_shared() ){
-            owns = true;
-            return true;
-        }
-        return false;
-    }
-
-    /**
-     * Unlocks a thread
-     */
-    void shared_lock::unlock()
-    {
-        owns = false;
-        m_mutex->unlock_shared();
-    }
-
-    /**
-     * Checks if the caller owns the lock on a thread
-     * 
-     * @return Returns a boolean on whether the lock is owned
-     */
-    bool shared_lock::owns_lock() const
-    {
-        return owns;
-    }
 }
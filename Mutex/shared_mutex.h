@@ -6,6 +6,8 @@
 
 #include <mutex>
 #include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include "AtlMutexWrap.h"
 
 namespace atl
@@ -14,18 +16,40 @@ namespace atl
      * @class shared_mutex
      *
      * @brief A class that allows threaded applications to lock threads and prevent deadlocks and race conditions
+     *
+     * Readers and the writer flag share one atomic word, so an uncontended
+     * lock_shared() is a single fetch-add. A writer sets the flag first,
+     * which turns new readers away, then waits for active readers to drain;
+     * writers are therefore never starved by a stream of readers. Writers
+     * queue on a separate mutex. Blocked threads park on a futex on Linux
+     * and on a condition variable elsewhere.
+     *
+     * Read locks do not nest. A thread that already holds a read lock and
+     * calls lock_shared() again blocks behind any waiting writer, which in
+     * turn waits for the first read lock, so both hang. The same applies
+     * to a thread that waits on other threads taking read locks while it
+     * holds one (for example TSMap callbacks that use the map).
      */
     class shared_mutex
     {
         private:
+            static const uint32_t WRITER = 1u << 31;        //!< A writer holds or is acquiring the lock
+            static const uint32_t PARKED = 1u << 30;        //!< Readers are parked until the writer leaves
+            static const uint32_t READER_MASK = PARKED - 1; //!< Number of active readers
+
+            void wait(uint32_t expected);
+            void wake();
+
 #ifdef DEBUG_CACHE
-			AtlMutex m_read;
-			AtlMutex m_mutex;
+			AtlMutex m_writer;
 #else
-            std::mutex m_read; //!< Brief readers
-            std::mutex m_mutex;  //!< Brief member fields for mutext
+            std::mutex m_writer;  //!< Brief serializes writers
+#endif
+            std::atomic<uint32_t> m_state; //!< Brief writer and parked flags plus reader count
+#ifndef __linux__
+            std::mutex m_parkMutex;             //!< Brief guards parking where there is no futex
+            std::condition_variable m_parkCond; //!< Brief parked threads wait here
 #endif
-            std::atomic_int readers; //!< Brief the number of readers
 
         public:
             shared_mutex();
@@ -42,28 +66,128 @@ namespace atl
     };
 
     /**
-     * @class shared_lock
+     * @class basic_shared_lock
      *
      * @brief A class that allows shared locking of threads
+     *
+     * Works with any mutex providing lock_shared(), try_lock_shared() and
+     * unlock_shared(), so containers can take their lock type as a parameter.
      */
-    class shared_lock
+    template<typename M> class basic_shared_lock
     {
         private:
-            shared_mutex* m_mutex; //!< Brief pointer to readers
+            M* m_mutex; //!< Brief pointer to readers
             std::atomic_bool owns; //!< Brief boolean for whether the lock is owned
 
         public:
-            shared_lock( shared_mutex& m );
-            shared_lock( shared_mutex& m, std::try_to_lock_t t );
-            shared_lock( shared_mutex& m, std::defer_lock_t t );
-            shared_lock( shared_mutex& m, std::adopt_lock_t t );
-            shared_lock( const shared_lock& other ) = delete;
-            ~shared_lock();
+            basic_shared_lock( M& m );
+            basic_shared_lock( M& m, std::try_to_lock_t t );
+            basic_shared_lock( M& m, std::defer_lock_t t );
+            basic_shared_lock( M& m, std::adopt_lock_t t );
+            basic_shared_lock( const basic_shared_lock& other ) = delete;
+            ~basic_shared_lock();
             void lock();
             bool try_lock();
             void unlock();
             bool owns_lock() const;
     };
 
-}
+    typedef basic_shared_lock<shared_mutex> shared_lock;
+
+    typedef MutexWrap<shared_mutex> AtlSharedMutex;  //!< shared_mutex covered by DEBUG and USE_LOCK_PROFILE
+
+    //////////////////////////////////////
+    // basic_shared_lock implementation //
+    //////////////////////////////////////
+
+    /**
+     * Constructor
+     */
+    template<typename M> basic_shared_lock<M>::basic_shared_lock( M& m )
+    {
+        owns = true;
+        m_mutex = &m;
+        m_mutex->lock_shared();
+    }
+
+    /**
+     * Constructor
+     */
+    template<typename M> basic_shared_lock<M>::basic_shared_lock( M& m, std::try_to_lock_t t )
+    {
+        owns = false;
+        m_mutex = &m;
+        if( m_mutex->try_lock_shared() ){
+            owns = true;
+        }
+    }
+
+    /**
+     * Constructor
+     */
+    template<typename M> basic_shared_lock<M>::basic_shared_lock( M& m, std::defer_lock_t t )
+    {
+        owns = false;
+        m_mutex = &m;
+    }
+
+    /**
+     * Constructor
+     */
+    template<typename M> basic_shared_lock<M>::basic_shared_lock( M& m, std::adopt_lock_t t )
+    {
+        owns = true;
+        m_mutex = &m;
+    }
+
+    /**
+     * Destructor
+     */
+    template<typename M> basic_shared_lock<M>::~basic_shared_lock()
+    {
+        if( owns ) m_mutex->unlock_shared();
+    }
 
+    /**
+     * Locks a thread
+     */
+    template<typename M> void basic_shared_lock<M>::lock()
+    {
+        m_mutex->lock_shared();
+        owns = true;
+    }
+
+    /**
+     * Checks if a lock is in place
+     * 
+     * @return Returns false if there is a lock
+     */
+    template<typename M> bool basic_shared_lock<M>::try_lock()
+    {
+        if( m_mutex->try_lock_shared() ){
+            owns = true;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Unlocks a thread
+     */
+    template<typename M> void basic_shared_lock<M>::unlock()
+    {
+        owns = false;
+        m_mutex->unlock_shared();
+    }
+
+    /**
+     * Checks if the caller owns the lock on a thread
+     * 
+     * @return Returns a boolean on whether the lock is owned
+     */
+    template<typename M> bool basic_shared_lock<M>::owns_lock() const
+    {
+        return owns;
+    }
+
+}
@@ -10,6 +10,10 @@ set(cmake_common_args
     -DCMAKE_INSTALL_LIBDIR:PATH=lib
     -DCMAKE_INCLUDE_PATH:PATH=${CMAKE_BINARY_DIR}/INSTALL/include
     -DBUILD_TESTS:BOOL=${BUILD_TESTS}
+    -DBUILD_BENCHMARKS:BOOL=${BUILD_BENCHMARKS}
+    -DUSE_LOCK_PROFILE:BOOL=${USE_LOCK_PROFILE}
+    -DUSE_ADAPTIVE_MUTEX:BOOL=${USE_ADAPTIVE_MUTEX}
+    -DUSE_COROUTINES:BOOL=${USE_COROUTINES}
     -DUSE_DOXYGEN:BOOL=${USE_DOXYGEN}
     -DBUILD_STATIC_LIB:BOOL=${BUILD_STATIC_LIB}
     -DBUILD_DEB_PACKAGE:BOOL=${BUILD_DEB_PACKAGE}
@@ -0,0 +1,83 @@
+/**
+ * \file CancelToken.cpp
+ **/
+
+#include "CancelToken.h"
+
+namespace atl
+{
+
+/**
+* \brief creates a token that is cancelled only by cancel()
+**/
+CancelToken::CancelToken()
+    : m_state(std::make_shared<State>())
+{
+    m_state->cancelled = false;
+    m_state->deadline = Clock::time_point::max();
+}
+
+/**
+* \brief creates a token that cancels itself after a timeout
+*
+* \param [in] timeout seconds from now
+**/
+CancelToken::CancelToken(double timeout)
+    : CancelToken()
+{
+    setDeadline(Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(timeout)));
+}
+
+/**
+* \brief returns a token that is never cancelled and costs nothing to check
+**/
+CancelToken CancelToken::none()
+{
+    return CancelToken(std::shared_ptr<State>());
+}
+
+/**
+* \brief cancels every copy of the token; does nothing for none()
+**/
+void CancelToken::cancel()
+{
+    if (m_state) {
+        m_state->cancelled = true;
+    }
+}
+
+/**
+* \brief sets when the token cancels itself; does nothing for none()
+*
+* \param [in] deadline the time, or time_point::max() for never
+**/
+void CancelToken::setDeadline(Clock::time_point deadline)
+{
+    if (m_state) {
+        m_state->deadline = deadline;
+    }
+}
+
+/**
+* \brief returns true once the token was cancelled or its deadline passed
+**/
+bool CancelToken::cancelled() const
+{
+    if (!m_state) {
+        return false;
+    }
+    if (m_state->cancelled.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    Clock::time_point deadline = m_state->deadline.load(std::memory_order_relaxed);
+    return deadline != Clock::time_point::max() && Clock::now() >= deadline;
+}
+
+/**
+* \brief returns false for none(), which never cancels
+**/
+bool CancelToken::cancellable() const
+{
+    return (bool)m_state;
+}
+}
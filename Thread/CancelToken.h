@@ -0,0 +1,45 @@
+/**
+ * \file CancelToken.h
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+namespace atl
+{
+    /**
+    * \brief lets whoever started a job call it off
+    *
+    * Copies share one state, so the job keeps a copy and the caller cancels
+    * its own. A token with a deadline cancels itself when the deadline
+    * passes. Queued jobs whose token is cancelled are dropped without
+    * running; a running job stops only if it polls cancelled().
+    **/
+    class CancelToken
+    {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        CancelToken();
+        explicit CancelToken(double timeout);
+        static CancelToken none();
+
+        void cancel();
+        void setDeadline(Clock::time_point deadline);
+        bool cancelled() const;
+        bool cancellable() const;
+
+    private:
+        struct State {
+            std::atomic_bool                    cancelled;
+            std::atomic<Clock::time_point>      deadline;   //!< time_point::max() for none
+        };
+
+        explicit CancelToken(std::shared_ptr<State> state) : m_state(state) {}
+
+        std::shared_ptr<State> m_state;                     //!< Null for tokens that never cancel
+    };
+}
@@ -0,0 +1,216 @@
+/**
+ * \file Coroutine.cpp
+ **/
+
+#include "Coroutine.h"
+#include "Scheduler.h"
+#include <cerrno>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <vector>
+#ifndef AQT_USE_WINSOCK_SOCKETS
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace atl
+{
+namespace detail
+{
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    /**
+    * \brief one thread that polls the sockets tasks wait on
+    *
+    * Registrations wake the poll through a pipe. Winsock has no pipes, so
+    * there the poll wakes every few milliseconds to pick them up instead.
+    **/
+    class SocketReactor : private Thread
+    {
+    public:
+        SocketReactor()
+        {
+#ifndef AQT_USE_WINSOCK_SOCKETS
+            if (pipe(m_wake) == 0) {
+                fcntl(m_wake[0], F_SETFL, O_NONBLOCK);
+                fcntl(m_wake[1], F_SETFL, O_NONBLOCK);
+            } else {
+                std::cerr << "WARNING: SocketReactor could not create its wakeup pipe" << std::endl;
+                m_wake[0] = m_wake[1] = -1;
+            }
+#endif
+            Start();
+        }
+
+        ~SocketReactor()
+        {
+            Stop();
+            wake();
+            Join();
+#ifndef AQT_USE_WINSOCK_SOCKETS
+            if (m_wake[0] >= 0) {
+                close(m_wake[0]);
+                close(m_wake[1]);
+            }
+#endif
+        }
+
+        /**
+        * \brief calls done(true) once s is ready, or done(false) at the deadline
+        **/
+        void watch(CoreSocket::SOCKET s, short events, Clock::time_point deadline, std::function<void(bool)> done)
+        {
+            {
+                std::lock_guard<std::mutex> l(m_mutex);
+                m_watches.push_back(Watch{s, events, deadline, done});
+            }
+            wake();
+        }
+
+    private:
+        struct Watch {
+            CoreSocket::SOCKET          s;
+            short                       events;
+            Clock::time_point           deadline;
+            std::function<void(bool)>   done;
+        };
+
+        void wake()
+        {
+#ifndef AQT_USE_WINSOCK_SOCKETS
+            char c = 0;
+            if (m_wake[1] >= 0 && write(m_wake[1], &c, 1) < 0 && errno != EAGAIN) {
+                std::cerr << "WARNING: SocketReactor could not wake its thread" << std::endl;
+            }
+#endif
+        }
+
+        /**
+        * \brief polls the watched sockets once and finishes the ready and
+        *        expired watches
+        **/
+        void mainLoop()
+        {
+            std::vector<pollfd> fds;
+            Clock::time_point now = Clock::now();
+            Clock::time_point next = Clock::time_point::max();
+            std::unique_lock<std::mutex> l(m_mutex);
+#ifndef AQT_USE_WINSOCK_SOCKETS
+            pollfd wakeFd = {m_wake[0], POLLIN, 0};
+            fds.push_back(wakeFd);
+#endif
+            size_t first = fds.size();
+            for (auto& w : m_watches) {
+                pollfd fd = {w.s, w.events, 0};
+                fds.push_back(fd);
+                next = std::min(next, w.deadline);
+            }
+            l.unlock();
+
+            int timeout = -1;
+            if (next != Clock::time_point::max()) {
+                int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count() + 1;
+                timeout = (int)std::max<int64_t>(0, std::min<int64_t>(ms, 60000));
+            }
+#ifdef AQT_USE_WINSOCK_SOCKETS
+            timeout = (timeout < 0 || timeout > 5) ? 5 : timeout;
+            if (fds.empty()) {
+                atl::sleep(timeout / 1000.0);
+            } else
+#endif
+            if (CoreSocket::portable_poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR) {
+                std::cerr << "WARNING: SocketReactor poll failed" << std::endl;
+            }
+
+#ifndef AQT_USE_WINSOCK_SOCKETS
+            char drain[64];
+            while (read(m_wake[0], drain, sizeof(drain)) > 0) {
+            }
+#endif
+
+            // Watches added while polling are past the end of fds
+            std::vector<std::pair<std::function<void(bool)>, bool>> finished;
+            now = Clock::now();
+            l.lock();
+            for (size_t i = fds.size(); i-- > first; ) {
+                Watch& w = m_watches[i - first];
+                if (fds[i].revents || w.deadline <= now) {
+                    finished.emplace_back(std::move(w.done), fds[i].revents != 0);
+                    m_watches.erase(m_watches.begin() + (i - first));
+                }
+            }
+            l.unlock();
+
+            for (auto& f : finished) {
+                f.first(f.second);
+            }
+        }
+
+        std::mutex          m_mutex;    //!< Guards m_watches
+        std::vector<Watch>  m_watches;
+#ifndef AQT_USE_WINSOCK_SOCKETS
+        int                 m_wake[2];  //!< Read and write ends of the wakeup pipe
+#endif
+    };
+
+    /**
+    * \brief the thread that keeps the tasks' timers
+    **/
+    Scheduler& timers()
+    {
+        static Scheduler scheduler;
+        static std::once_flag started;
+        std::call_once(started, [] { scheduler.Start(); });
+        return scheduler;
+    }
+
+    SocketReactor& reactor()
+    {
+        static SocketReactor r;
+        return r;
+    }
+}
+
+/**
+* \brief resumes a coroutine on a pool worker, or right here if there is
+*        no pool or its queue is full
+**/
+void resume(ThreadPool* pool, std::coroutine_handle<> h)
+{
+    if (!pool || !pool->push_job([h] { h.resume(); })) {
+        h.resume();
+    }
+}
+
+/**
+* \brief resumes a coroutine on a pool after a delay
+**/
+void resumeAfter(double seconds, ThreadPool* pool, std::coroutine_handle<> h)
+{
+    timers().scheduleAfter(seconds, [pool, h] { resume(pool, h); });
+}
+
+/**
+* \brief resumes a coroutine on a pool when a socket is ready or the
+*        timeout passes, setting ready to tell which
+**/
+void resumeWhenReady(CoreSocket::SOCKET s, bool write, double timeout, ThreadPool* pool,
+                     std::coroutine_handle<> h, bool& ready)
+{
+    Clock::time_point deadline = Clock::time_point::max();
+    if (timeout >= 0) {
+        deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(timeout));
+    }
+    bool* result = &ready;
+    reactor().watch(s, write ? POLLOUT : POLLIN, deadline, [pool, h, result](bool isReady) {
+        *result = isReady;
+        resume(pool, h);
+    });
+}
+}
+}
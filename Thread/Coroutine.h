@@ -0,0 +1,352 @@
+/**
+ * \file Coroutine.h
+ *
+ * \brief C++20 coroutine tasks that run on a ThreadPool
+ *
+ * An atl::task<T> is a coroutine that starts when it is awaited or handed
+ * to spawn(). While it waits on a timer, a TSQueue or a socket it holds no
+ * thread: the waiting is done by one timer thread (a Scheduler) and one
+ * thread polling sockets, and the task resumes on a worker of its pool
+ * once the wait is over. So thousands of I/O-bound tasks can share a pool
+ * with one worker per core.
+ *
+ *     atl::task<int> readHeader(atl::CoreSocket::SOCKET s)
+ *     {
+ *         if (!co_await atl::readable(s, 1.0)) {
+ *             co_return -1;
+ *         }
+ *         ...
+ *     }
+ *     std::future<int> header = atl::spawn(pool, readHeader(s));
+ *
+ * A task awaited by another task runs on the same pool as the awaiting
+ * task, and resume_on() moves a task to another pool. If a pool's queue is
+ * full the task resumes on the thread that ended its wait instead.
+ *
+ * Only built with the USE_COROUTINES CMake option.
+ **/
+
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <future>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include "ThreadPool.h"
+#include "TSQueue.tcc"
+#include "CoreSocket.hpp"
+
+namespace atl
+{
+    template<typename T = void> class task;
+
+    namespace detail
+    {
+        void resume(ThreadPool* pool, std::coroutine_handle<> h);
+        void resumeAfter(double seconds, ThreadPool* pool, std::coroutine_handle<> h);
+        void resumeWhenReady(CoreSocket::SOCKET s, bool write, double timeout, ThreadPool* pool,
+                             std::coroutine_handle<> h, bool& ready);
+
+        /**
+        * \brief the promise parts that do not depend on the result type
+        **/
+        struct TaskPromiseBase {
+            ThreadPool*             pool = nullptr; //!< Pool the task resumes on after a wait
+            std::coroutine_handle<> continuation;   //!< The coroutine awaiting this one
+            std::exception_ptr      error;
+
+            /**
+            * \brief resumes the awaiting coroutine, if any, when the task ends
+            **/
+            struct FinalAwaiter {
+                bool await_ready() noexcept { return false; }
+                template<typename P>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+                {
+                    std::coroutine_handle<> next = h.promise().continuation;
+                    return next ? next : std::noop_coroutine();
+                }
+                void await_resume() noexcept {}
+            };
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            FinalAwaiter final_suspend() noexcept { return {}; }
+            void unhandled_exception() { error = std::current_exception(); }
+        };
+
+        template<typename T> struct TaskPromise : TaskPromiseBase {
+            std::optional<T> value;
+
+            task<T> get_return_object();
+            template<typename U> void return_value(U&& v) { value.emplace(std::forward<U>(v)); }
+
+            T result()
+            {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+                return std::move(*value);
+            }
+        };
+
+        template<> struct TaskPromise<void> : TaskPromiseBase {
+            task<void> get_return_object();
+            void return_void() {}
+
+            void result()
+            {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+        };
+
+        /**
+        * \brief a coroutine that starts at once and frees itself at the end,
+        *        used by spawn() to drive a task
+        **/
+        struct Detached {
+            struct promise_type {
+                ThreadPool* pool;
+
+                template<typename... Args>
+                promise_type(ThreadPool& p, Args&...) : pool(&p) {}
+
+                Detached get_return_object() { return {}; }
+                std::suspend_never initial_suspend() noexcept { return {}; }
+                std::suspend_never final_suspend() noexcept { return {}; }
+                void return_void() {}
+                void unhandled_exception() { std::terminate(); }
+            };
+        };
+
+        /**
+        * \brief starts a task on the awaiting task's pool and resumes the
+        *        awaiting task with its result
+        **/
+        template<typename T> struct TaskAwaiter {
+            std::coroutine_handle<TaskPromise<T>> h;
+
+            bool await_ready() noexcept { return !h || h.done(); }
+            template<typename P>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<P> parent) noexcept
+            {
+                h.promise().pool = parent.promise().pool;
+                h.promise().continuation = parent;
+                return h;
+            }
+            T await_resume() { return h.promise().result(); }
+        };
+
+        struct ResumeOnAwaiter {
+            ThreadPool* pool;
+
+            bool await_ready() noexcept { return false; }
+            template<typename P> void await_suspend(std::coroutine_handle<P> h)
+            {
+                h.promise().pool = pool;
+                resume(pool, h);
+            }
+            void await_resume() noexcept {}
+        };
+
+        struct SleepAwaiter {
+            double seconds;
+
+            bool await_ready() noexcept { return seconds <= 0; }
+            template<typename P> void await_suspend(std::coroutine_handle<P> h)
+            {
+                resumeAfter(seconds, h.promise().pool, h);
+            }
+            void await_resume() noexcept {}
+        };
+
+        template<typename T> struct DequeueAwaiter {
+            TSQueue<T>& queue;
+            T           value;
+
+            bool await_ready() noexcept { return false; }
+            template<typename P> bool await_suspend(std::coroutine_handle<P> h)
+            {
+                ThreadPool* pool = h.promise().pool;
+                return !queue.async_dequeue(value, [pool, h] { resume(pool, h); });
+            }
+            T await_resume() { return std::move(value); }
+        };
+
+        struct SocketAwaiter {
+            CoreSocket::SOCKET  s;
+            bool                write;
+            double              timeout;
+            bool                ready;
+
+            bool await_ready() noexcept { return false; }
+            template<typename P> void await_suspend(std::coroutine_handle<P> h)
+            {
+                resumeWhenReady(s, write, timeout, h.promise().pool, h, ready);
+            }
+            bool await_resume() noexcept { return ready; }
+        };
+    }
+
+    /**
+    * \brief a lazily started coroutine that produces a T
+    *
+    * Await it from another task with co_await std::move(t), or start it
+    * with spawn(). Exceptions reach whoever awaits it.
+    **/
+    template<typename T> class task
+    {
+    public:
+        typedef detail::TaskPromise<T> promise_type;
+
+        task(task&& other) noexcept : m_h(std::exchange(other.m_h, nullptr)) {}
+        task& operator=(task&& other) noexcept
+        {
+            if (this != &other) {
+                if (m_h) {
+                    m_h.destroy();
+                }
+                m_h = std::exchange(other.m_h, nullptr);
+            }
+            return *this;
+        }
+        task(const task&) = delete;
+        task& operator=(const task&) = delete;
+        ~task()
+        {
+            if (m_h) {
+                m_h.destroy();
+            }
+        }
+
+        /**
+        * \brief starts the task on the awaiting task's pool and resumes the
+        *        awaiting task with its result
+        **/
+        detail::TaskAwaiter<T> operator co_await() && noexcept
+        {
+            return detail::TaskAwaiter<T>{m_h};
+        }
+
+    private:
+        friend promise_type;
+        explicit task(std::coroutine_handle<promise_type> h) : m_h(h) {}
+
+        std::coroutine_handle<promise_type> m_h;
+    };
+
+    namespace detail
+    {
+        template<typename T> task<T> TaskPromise<T>::get_return_object()
+        {
+            return task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+        }
+
+        inline task<void> TaskPromise<void>::get_return_object()
+        {
+            return task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+        }
+
+        /**
+        * \brief awaits the task on the pool and hands the outcome to the promise
+        **/
+        template<typename T>
+        Detached drive(ThreadPool& pool, task<T> t, std::promise<T> result)
+        {
+            struct Schedule {
+                bool await_ready() noexcept { return false; }
+                void await_suspend(std::coroutine_handle<Detached::promise_type> h)
+                {
+                    resume(h.promise().pool, h);
+                }
+                void await_resume() noexcept {}
+            };
+
+            co_await Schedule{};
+            try {
+                if constexpr (std::is_void<T>::value) {
+                    co_await std::move(t);
+                    result.set_value();
+                } else {
+                    result.set_value(co_await std::move(t));
+                }
+            } catch (...) {
+                result.set_exception(std::current_exception());
+            }
+        }
+    }
+
+    /**
+    * \brief starts a task on a pool
+    *
+    * \param [in] pool the pool the task runs on; it must outlive the task
+    * \param [in] t the task
+    * \return a future for the task's result or exception
+    **/
+    template<typename T> std::future<T> spawn(ThreadPool& pool, task<T> t)
+    {
+        std::promise<T> result;
+        std::future<T> future = result.get_future();
+        detail::drive(pool, std::move(t), std::move(result));
+        return future;
+    }
+
+    /**
+    * \brief co_await resume_on(pool) continues the task on a worker of pool,
+    *        which it also resumes on after later waits
+    **/
+    inline detail::ResumeOnAwaiter resume_on(ThreadPool& pool)
+    {
+        return detail::ResumeOnAwaiter{&pool};
+    }
+
+    /**
+    * \brief co_await sleep_for(seconds) suspends the task without holding a
+    *        thread and resumes it on its pool after the delay
+    **/
+    inline detail::SleepAwaiter sleep_for(double seconds)
+    {
+        return detail::SleepAwaiter{seconds};
+    }
+
+    /**
+    * \brief co_await dequeue(queue) returns the head of the queue, suspending
+    *        the task until there is one
+    *
+    * The queue must outlive the wait.
+    **/
+    template<typename T> detail::DequeueAwaiter<T> dequeue(TSQueue<T>& queue)
+    {
+        return detail::DequeueAwaiter<T>{queue, T()};
+    }
+
+    /**
+    * \brief co_await readable(s, timeout) suspends the task until the socket
+    *        has data, is closed or fails
+    *
+    * \param [in] s the socket
+    * \param [in] timeout seconds to wait, or negative to wait for good
+    * \return true if the socket is ready, false on timeout
+    **/
+    inline detail::SocketAwaiter readable(CoreSocket::SOCKET s, double timeout = -1)
+    {
+        return detail::SocketAwaiter{s, false, timeout, false};
+    }
+
+    /**
+    * \brief co_await writable(s, timeout) suspends the task until the socket
+    *        can take data, is closed or fails
+    *
+    * \param [in] s the socket
+    * \param [in] timeout seconds to wait, or negative to wait for good
+    * \return true if the socket is ready, false on timeout
+    **/
+    inline detail::SocketAwaiter writable(CoreSocket::SOCKET s, double timeout = -1)
+    {
+        return detail::SocketAwaiter{s, true, timeout, false};
+    }
+}
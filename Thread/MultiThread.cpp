@@ -13,6 +13,11 @@ std::ofstream multiThreadTest;
 namespace atl
 {
 
+namespace detail
+{
+    thread_local WorkerSlot t_worker = {nullptr, -1};
+}
+
 /**
  * \brief  Destructor
  *
@@ -45,8 +50,7 @@ bool MultiThread::Start()
     std::promise<void> p;
     auto f = std::make_shared<std::shared_future<void>>(p.get_future().share());
     for(unsigned i = 0; i < m_numThreads; i++) {
-        m_threads.emplace_back([this, f] {f->get(); Execute();});
-        m_idMap.emplace(m_threads.crbegin()->get_id(), i);
+        m_threads.emplace_back([this, f, i] {f->get(); bindWorker(i); applyPlacement(i); Execute();});
     }
     p.set_value();
     return true;
@@ -61,17 +65,14 @@ bool MultiThread::Join()
 {
     // Move threads into separate vector atomically before joining
     // Don't want to join from within mutex lock
-    std::unique_lock<std::mutex> guard (m_threadMutex);
+    std::unique_lock<AtlSpinLock> guard (m_threadMutex);
     auto deleteThreads = std::move(m_threads);
     guard.unlock();
 
     bool rc = true;
     for(auto&& t: deleteThreads) {
         try {
-            auto id = t.get_id();
             t.join();
-            // Don't erase detached threads
-            m_idMap.erase(id);
 
         } catch (const std::system_error& e) {
             if(e.code() == std::errc::resource_deadlock_would_occur) {
@@ -110,7 +111,7 @@ bool MultiThread::Join()
  */
 bool MultiThread::Detach()
 {
-    std::unique_lock<std::mutex> guard (m_threadMutex);
+    std::unique_lock<AtlSpinLock> guard (m_threadMutex);
     auto deleteThreads = std::move(m_threads);
     guard.unlock();
 
@@ -124,8 +125,6 @@ bool MultiThread::Detach()
         }
     }
 
-    // Keeping idmap around in case it's used
-
     return rc;
 }
 
@@ -144,6 +143,55 @@ bool MultiThread::setNumThreads(unsigned numThreads)
     return true;
 }
 
+/**
+ * @brief Returns the number of threads spawned by Start
+ *
+ * @return the number of threads
+ */
+unsigned MultiThread::getNumThreads()
+{
+    return m_numThreads;
+}
+
+/**
+ * @brief Sets where and how threads started from now on run: their CPUs,
+ * NUMA node, names and scheduling. Threads that are already running keep
+ * their settings.
+ *
+ * @param placement the settings; thread i is pinned and named by its id i
+ */
+void MultiThread::setPlacement(const ThreadPlacement& placement)
+{
+    std::lock_guard<std::mutex> guard(m_placementMutex);
+    m_placement = placement;
+}
+
+/**
+ * @brief Returns the placement applied to new threads
+ *
+ * @return the placement settings
+ */
+ThreadPlacement MultiThread::getPlacement()
+{
+    std::lock_guard<std::mutex> guard(m_placementMutex);
+    return m_placement;
+}
+
+/**
+ * @brief Applies the placement to the calling thread
+ *
+ * @param index the thread's id, which picks its name and pinned CPU
+ *
+ * @return true if every setting took effect
+ */
+bool MultiThread::applyPlacement(int index)
+{
+    std::unique_lock<std::mutex> guard(m_placementMutex);
+    ThreadPlacement placement = m_placement;
+    guard.unlock();
+    return applyThreadPlacement(placement, index);
+}
+
 /**
  * @brief Returns a thread ID for this thread.  Will be an int between 0 and n-1,
  * where n is the number of threads
@@ -152,10 +200,22 @@ bool MultiThread::setNumThreads(unsigned numThreads)
  */
 int MultiThread::getMyId()
 {
-    if(!m_idMap.count(std::this_thread::get_id())) {
+    if(detail::t_worker.owner != this) {
         std::cerr << "ERROR: called getMyId from thread outside of MultiThread" << std::endl;
         return -1;
     }
-    return m_idMap[std::this_thread::get_id()];
+    return detail::t_worker.index;
+}
+
+/**
+ * @brief Records the calling thread as thread index of this object, for
+ * getMyId() and this_worker()
+ *
+ * @param index the thread's id
+ */
+void MultiThread::bindWorker(int index)
+{
+    detail::t_worker.owner = this;
+    detail::t_worker.index = index;
 }
 }
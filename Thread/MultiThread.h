@@ -5,28 +5,63 @@
 #pragma once
 
 #include "Thread.h"
+#include "AtlMutexWrap.h"
+#include "ThreadPlacement.h"
 #include <vector>
-#include <map>
+#include <mutex>
 
 namespace atl
 {
 
+class MultiThread;
+
+namespace detail
+{
+    /**
+     * \brief the MultiThread the calling thread works for and its id there
+     **/
+    struct WorkerSlot
+    {
+        const MultiThread*  owner;
+        int                 index;
+    };
+
+    extern thread_local WorkerSlot t_worker;
+}
+
+/**
+ * \brief returns the calling thread's id in the MultiThread or ThreadPool it
+ * works for, or -1 for any other thread
+ *
+ * One thread-local read, cheap enough to index per-thread buffers.
+ **/
+inline int this_worker()
+{
+    return detail::t_worker.index;
+}
+
 class MultiThread : public Thread
 {
 public:
     MultiThread(int numThreads=2): m_numThreads(numThreads) {}
     virtual ~MultiThread();
     virtual bool setNumThreads(unsigned);
+    virtual unsigned getNumThreads();
     virtual bool Start();
     virtual bool Join();
     virtual bool Detach();
+    virtual void setPlacement(const ThreadPlacement& placement);
+    virtual ThreadPlacement getPlacement();
 
 protected:
     virtual int getMyId();
+    void bindWorker(int index);
+    bool applyPlacement(int index);
 
     unsigned                    m_numThreads;   //<! Number of threads to spawn
     std::vector<std::thread>    m_threads;      //<! Running threads
-    std::map<std::thread::id,int>  m_idMap;     //<! map of Ids
-    std::mutex                  m_threadMutex;  //<! mutex for joining threads
+    AtlSpinLock                 m_threadMutex;  //<! mutex for joining threads
+    std::mutex                  m_placementMutex; //<! mutex for m_placement
+    ThreadPlacement             m_placement;    //<! CPUs, names and scheduling of new threads
 };
 }
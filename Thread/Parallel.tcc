@@ -0,0 +1,308 @@
+/**
+ * \file Parallel.tcc
+ *
+ * \brief Data-parallel loops, reductions, transforms and sorting on a ThreadPool
+ *
+ * Each algorithm splits its range in halves recursively. The calling
+ * thread keeps the left half and hands the right half to the pool as a
+ * TaskGroup job, until pieces are no larger than the grain. Waiting threads
+ * run queued pieces themselves, so the algorithms may be nested and may be
+ * called from inside pool jobs. A grain of 0 picks one that gives every
+ * thread several pieces to balance load; ranges no larger than the grain
+ * run serially on the caller without touching the pool.
+ *
+ * Ranges are given as a begin and end that support subtraction and adding
+ * an offset: integers or random access iterators. Every algorithm has an
+ * overload without a pool argument that uses ThreadPool::shared_pool().
+ **/
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include "ThreadPool.h"
+#include "TaskGroup.h"
+
+namespace atl
+{
+    namespace detail
+    {
+        const size_t PIECES_PER_THREAD = 8;     //!< Brief automatic grain gives each thread this many pieces
+        const size_t SORT_GRAIN = 4096;         //!< Brief smallest piece of a parallel sort
+
+        /**
+        * \brief picks a grain for a range of n elements
+        **/
+        inline size_t autoGrain(ThreadPool& pool, size_t n, size_t grain)
+        {
+            if (grain) {
+                return grain;
+            }
+            size_t pieces = PIECES_PER_THREAD * (pool.getNumThreads() + 1);
+            return std::max<size_t>(1, (n + pieces - 1) / pieces);
+        }
+
+        /**
+        * \brief calls body on pieces of [begin, end) no larger than grain
+        **/
+        template<typename Index, typename Body>
+        void splitRange(ThreadPool& pool, Index begin, Index end, size_t grain, const Body& body)
+        {
+            TaskGroup group(pool);
+            while ((size_t)(end - begin) > grain) {
+                Index mid = begin + (end - begin) / 2;
+                group.run([&pool, mid, end, grain, &body] {
+                    splitRange(pool, mid, end, grain, body);
+                });
+                end = mid;
+            }
+            body(begin, end);
+            group.wait();
+        }
+
+        /**
+        * \brief reduces [begin, end), combining the halves' results in order
+        **/
+        template<typename Index, typename T, typename Reduce, typename Combine>
+        T reduceRange(ThreadPool& pool, Index begin, Index end, size_t grain, const T& identity,
+                      const Reduce& reduce, const Combine& combine)
+        {
+            if ((size_t)(end - begin) <= grain) {
+                return reduce(begin, end, identity);
+            }
+            Index mid = begin + (end - begin) / 2;
+            T right = identity;
+            TaskGroup group(pool);
+            group.run([&] { right = reduceRange(pool, mid, end, grain, identity, reduce, combine); });
+            T left = reduceRange(pool, begin, mid, grain, identity, reduce, combine);
+            group.wait();
+            return combine(std::move(left), std::move(right));
+        }
+
+        /**
+        * \brief quicksort that sorts both sides of each partition in parallel
+        *        and falls back to std::sort for small pieces or bad pivots
+        **/
+        template<typename It, typename Compare>
+        void sortRange(ThreadPool& pool, It first, It last, size_t grain, Compare comp, int depth)
+        {
+            TaskGroup group(pool);
+            while ((size_t)(last - first) > grain && depth-- > 0) {
+                // Median of three, moved to the end while partitioning
+                It mid = first + (last - first) / 2;
+                It back = last - 1;
+                if (comp(*mid, *first)) std::iter_swap(mid, first);
+                if (comp(*back, *mid)) std::iter_swap(back, mid);
+                if (comp(*mid, *first)) std::iter_swap(mid, first);
+                std::iter_swap(mid, back);
+
+                It pivot = back;
+                It split = std::partition(first, back, [&](const typename std::iterator_traits<It>::value_type& v) {
+                    return comp(v, *pivot);
+                });
+                std::iter_swap(split, back);
+
+                // Keep the smaller side, so the caller's stack stays shallow
+                It rightFirst = split + 1;
+                if (split - first < last - rightFirst) {
+                    group.run([&pool, rightFirst, last, grain, comp, depth] {
+                        sortRange(pool, rightFirst, last, grain, comp, depth);
+                    });
+                    last = split;
+                } else {
+                    group.run([&pool, first, split, grain, comp, depth] {
+                        sortRange(pool, first, split, grain, comp, depth);
+                    });
+                    first = rightFirst;
+                }
+            }
+            std::sort(first, last, comp);
+            group.wait();
+        }
+    }
+
+    /**
+    * \brief calls f(i) for every i in [begin, end)
+    *
+    * \param [in] pool the pool to run on
+    * \param [in] begin first index or iterator
+    * \param [in] end one past the last index or iterator
+    * \param [in] f called once per element; calls may run concurrently
+    * \param [in] grain largest piece run as one job, 0 for automatic
+    **/
+    template<typename Index, typename F>
+    void parallel_for(ThreadPool& pool, Index begin, Index end, const F& f, size_t grain = 0)
+    {
+        size_t n = end > begin ? (size_t)(end - begin) : 0;
+        grain = detail::autoGrain(pool, n, grain);
+        auto body = [&f](Index b, Index e) {
+            for (; b != e; ++b) {
+                f(b);
+            }
+        };
+        if (n <= grain) {
+            body(begin, begin + n);
+            return;
+        }
+        detail::splitRange(pool, begin, end, grain, body);
+    }
+
+    /**
+    * \brief calls f(b, e) on pieces of [begin, end) that together cover it once
+    *
+    * Cheaper than parallel_for when f can work on a whole piece at a time.
+    *
+    * \param [in] pool the pool to run on
+    * \param [in] begin first index or iterator
+    * \param [in] end one past the last index or iterator
+    * \param [in] f called once per piece; calls may run concurrently
+    * \param [in] grain largest piece, 0 for automatic
+    **/
+    template<typename Index, typename F>
+    void parallel_for_range(ThreadPool& pool, Index begin, Index end, const F& f, size_t grain = 0)
+    {
+        size_t n = end > begin ? (size_t)(end - begin) : 0;
+        grain = detail::autoGrain(pool, n, grain);
+        if (n <= grain) {
+            f(begin, begin + n);
+            return;
+        }
+        detail::splitRange(pool, begin, end, grain, f);
+    }
+
+    /**
+    * \brief reduces [begin, end) in pieces and combines the results
+    *
+    * Pieces are combined in range order, so combine must be associative but
+    * need not be commutative.
+    *
+    * \param [in] pool the pool to run on
+    * \param [in] begin first index or iterator
+    * \param [in] end one past the last index or iterator
+    * \param [in] identity the value of an empty range
+    * \param [in] reduce reduce(b, e, init) returns init folded with the piece [b, e)
+    * \param [in] combine combine(left, right) joins the results of adjacent pieces
+    * \param [in] grain largest piece, 0 for automatic
+    * \return the reduction of the whole range
+    **/
+    template<typename Index, typename T, typename Reduce, typename Combine>
+    T parallel_reduce(ThreadPool& pool, Index begin, Index end, const T& identity,
+                      const Reduce& reduce, const Combine& combine, size_t grain = 0)
+    {
+        size_t n = end > begin ? (size_t)(end - begin) : 0;
+        grain = detail::autoGrain(pool, n, grain);
+        return detail::reduceRange(pool, begin, begin + n, grain, identity, reduce, combine);
+    }
+
+    /**
+    * \brief stores f(*it) to the matching position of out for every it in [first, last)
+    *
+    * \param [in] pool the pool to run on
+    * \param [in] first start of the input, a random access iterator
+    * \param [in] last end of the input
+    * \param [in] out start of the output, a random access iterator; may equal first
+    * \param [in] f the transform; calls may run concurrently
+    * \param [in] grain largest piece, 0 for automatic
+    * \return the end of the output
+    **/
+    template<typename InIt, typename OutIt, typename F>
+    OutIt parallel_transform(ThreadPool& pool, InIt first, InIt last, OutIt out, const F& f, size_t grain = 0)
+    {
+        parallel_for_range(pool, first, last, [first, out, &f](InIt b, InIt e) {
+            std::transform(b, e, out + (b - first), f);
+        }, grain);
+        return out + (last - first);
+    }
+
+    /**
+    * \brief sorts [first, last); not stable
+    *
+    * \param [in] pool the pool to run on
+    * \param [in] first start of the range, a random access iterator
+    * \param [in] last end of the range
+    * \param [in] comp strict weak ordering
+    * \param [in] grain pieces this small are sorted serially, 0 for automatic
+    **/
+    template<typename It, typename Compare>
+    void parallel_sort(ThreadPool& pool, It first, It last, Compare comp, size_t grain = 0)
+    {
+        size_t n = last > first ? (size_t)(last - first) : 0;
+        grain = std::max(detail::autoGrain(pool, n, grain), detail::SORT_GRAIN);
+        if (n <= grain) {
+            std::sort(first, last, comp);
+            return;
+        }
+        // Past twice log2(n) levels the pivots are bad; std::sort copes with that
+        int depth = 0;
+        for (size_t m = n; m > 1; m /= 2) {
+            depth += 2;
+        }
+        detail::sortRange(pool, first, last, grain, comp, depth);
+    }
+
+    /**
+    * \brief sorts [first, last) with operator<; not stable
+    **/
+    template<typename It>
+    void parallel_sort(ThreadPool& pool, It first, It last)
+    {
+        parallel_sort(pool, first, last, std::less<typename std::iterator_traits<It>::value_type>());
+    }
+
+    /**
+    * \brief parallel_for on the shared pool
+    **/
+    template<typename Index, typename F>
+    void parallel_for(Index begin, Index end, const F& f, size_t grain = 0)
+    {
+        parallel_for(ThreadPool::shared_pool(), begin, end, f, grain);
+    }
+
+    /**
+    * \brief parallel_for_range on the shared pool
+    **/
+    template<typename Index, typename F>
+    void parallel_for_range(Index begin, Index end, const F& f, size_t grain = 0)
+    {
+        parallel_for_range(ThreadPool::shared_pool(), begin, end, f, grain);
+    }
+
+    /**
+    * \brief parallel_reduce on the shared pool
+    **/
+    template<typename Index, typename T, typename Reduce, typename Combine>
+    T parallel_reduce(Index begin, Index end, const T& identity,
+                      const Reduce& reduce, const Combine& combine, size_t grain = 0)
+    {
+        return parallel_reduce(ThreadPool::shared_pool(), begin, end, identity, reduce, combine, grain);
+    }
+
+    /**
+    * \brief parallel_transform on the shared pool
+    **/
+    template<typename InIt, typename OutIt, typename F>
+    OutIt parallel_transform(InIt first, InIt last, OutIt out, const F& f, size_t grain = 0)
+    {
+        return parallel_transform(ThreadPool::shared_pool(), first, last, out, f, grain);
+    }
+
+    /**
+    * \brief parallel_sort on the shared pool
+    **/
+    template<typename It, typename Compare>
+    void parallel_sort(It first, It last, Compare comp, size_t grain = 0)
+    {
+        parallel_sort(ThreadPool::shared_pool(), first, last, comp, grain);
+    }
+
+    /**
+    * \brief parallel_sort with operator< on the shared pool
+    **/
+    template<typename It>
+    void parallel_sort(It first, It last)
+    {
+        parallel_sort(ThreadPool::shared_pool(), first, last);
+    }
+}
@@ -0,0 +1,602 @@
+/**
+ * \file Pipeline.tcc
+ *
+ * \brief Chains of processing stages with bounded queues between them
+ *
+ * A pipeline is built from its input type by adding stages with then().
+ * Every stage runs its function on its own worker threads, reading from
+ * the queue in front of it and writing to the queue behind it; the queues
+ * are created with the stages. A stage's in-flight limit caps the items
+ * queued for it plus the items its workers hold, so a slow stage makes
+ * put() upstream wait instead of letting its queue grow: memory and
+ * latency stay bounded. An ordered stage hands its results on in the order
+ * the items were pushed into the pipeline, even if its workers or earlier
+ * stages finish them out of order.
+ *
+ *     auto p = atl::Pipeline<Frame>(8)
+ *         .then("demosaic", demosaic, 2, 4)
+ *         .then("tiles", processTiles, 8, 16, true);
+ *     p.Start();
+ *     p.push(frame);
+ *     p.pop(result, 100);
+ *
+ * getStats() reports the throughput, latency and utilization of every
+ * stage; the stage with the highest utilization is the bottleneck.
+ **/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "MultiThread.h"
+#include "TSQueue.tcc"
+
+namespace atl
+{
+    /**
+    * \brief throughput and latency of one pipeline stage since Start()
+    **/
+    struct StageStats {
+        std::string name;
+        unsigned    threads;        //!< Worker threads of the stage
+        size_t      limit;          //!< In-flight limit of the stage
+        size_t      inFlight;       //!< Items queued for or held by the stage now
+        uint64_t    items;          //!< Items the stage finished
+        uint64_t    errors;         //!< Items whose function threw; they are dropped
+        double      throughput;     //!< Items finished per second
+        double      meanLatency;    //!< Mean seconds from entering the stage's queue to leaving the stage
+        double      maxLatency;     //!< Longest such time in seconds
+        double      utilization;    //!< Fraction of the workers' time spent in the stage's function
+    };
+
+    namespace detail
+    {
+        typedef std::chrono::steady_clock PipeClock;
+
+        /**
+        * \brief an item on its way through a pipeline
+        *
+        * Items whose function threw travel on without a value, so ordered
+        * stages further on are not left waiting for their sequence number.
+        **/
+        template<typename T> struct PipeItem {
+            uint64_t                seq;        //!< Order in which the item entered the pipeline
+            bool                    valid;      //!< False if an earlier stage failed on the item
+            PipeClock::time_point   entered;    //!< When the item entered its current queue
+            T                       value;
+
+            PipeItem() : seq(0), valid(false) {}
+        };
+
+        /**
+        * \brief the queue between two stages, with a limit on the items in
+        *        it plus the items the consumer holds
+        *
+        * put() waits for a free slot, take() hands an item over and
+        * release() frees its slot once the consumer is done with it.
+        **/
+        template<typename T> class PipeLink
+        {
+        public:
+            PipeLink(size_t limit) : m_limit(std::max<size_t>(limit, 1)), m_held(0), m_closed(false), m_next(0) {}
+
+            /**
+            * \brief waits for a free slot and queues an item
+            *
+            * \return false if the link was closed and the item dropped
+            **/
+            bool put(PipeItem<T>&& item)
+            {
+                std::unique_lock<std::mutex> l(m_mutex);
+                m_slots.wait(l, [this] { return m_closed || m_held < m_limit; });
+                if (m_closed) {
+                    return false;
+                }
+                m_held++;
+                l.unlock();
+
+                item.entered = PipeClock::now();
+                m_queue.enqueue(std::move(item), true);
+                return true;
+            }
+
+            /**
+            * \brief takes the oldest item, waiting up to timeout milliseconds
+            **/
+            bool take(PipeItem<T>& item, uint16_t timeout)
+            {
+                return m_queue.dequeue(item, timeout);
+            }
+
+            /**
+            * \brief frees the slot of an item that was taken
+            **/
+            void release()
+            {
+                std::lock_guard<std::mutex> l(m_mutex);
+                m_held--;
+                m_slots.notify_one();
+            }
+
+            /**
+            * \brief wakes put() and makes it drop items until reset()
+            **/
+            void close()
+            {
+                std::lock_guard<std::mutex> l(m_mutex);
+                m_closed = true;
+                m_slots.notify_all();
+            }
+
+            /**
+            * \brief empties the link and opens it again with fresh sequence numbers
+            **/
+            void reset()
+            {
+                std::lock_guard<std::mutex> l(m_mutex);
+                m_queue.delete_all();
+                m_held = 0;
+                m_closed = false;
+                m_next = 0;
+            }
+
+            /**
+            * \brief returns the next sequence number, for the first link
+            **/
+            uint64_t stamp()
+            {
+                return m_next++;
+            }
+
+            void setLimit(size_t limit)
+            {
+                std::lock_guard<std::mutex> l(m_mutex);
+                m_limit = std::max<size_t>(limit, 1);
+                m_slots.notify_all();
+            }
+
+            size_t getLimit()
+            {
+                std::lock_guard<std::mutex> l(m_mutex);
+                return m_limit;
+            }
+
+            size_t size()
+            {
+                std::lock_guard<std::mutex> l(m_mutex);
+                return m_held;
+            }
+
+        private:
+            TSQueue<PipeItem<T>>    m_queue;
+            std::mutex              m_mutex;    //!< Guards the counts and m_closed
+            std::condition_variable m_slots;    //!< Signaled when a slot frees up or on close()
+            size_t                  m_limit;    //!< Most items queued or held at once
+            size_t                  m_held;     //!< Items queued or held now
+            bool                    m_closed;
+            std::atomic<uint64_t>   m_next;     //!< Next sequence number
+        };
+
+        /**
+        * \brief the part of a stage a pipeline drives without knowing its types
+        **/
+        class PipeStageBase : public MultiThread
+        {
+        public:
+            PipeStageBase(const std::string& name, unsigned threads) : MultiThread(threads), m_name(name) {}
+            virtual ~PipeStageBase() {}
+
+            virtual void close() = 0;
+            virtual void reset() = 0;
+            virtual StageStats getStats() = 0;
+
+        protected:
+            std::string m_name;
+        };
+
+        /**
+        * \brief worker threads that apply a function to every item of one
+        *        link and put the results on the next
+        **/
+        template<typename In, typename Out> class PipeStage : public PipeStageBase
+        {
+        public:
+            PipeStage(const std::string& name, std::function<Out(In)> f, unsigned threads, bool ordered,
+                      std::shared_ptr<PipeLink<In>> in, std::shared_ptr<PipeLink<Out>> out)
+                : PipeStageBase(name, std::max(threads, 1u)), m_f(f), m_ordered(ordered), m_in(in), m_out(out),
+                  m_nextSeq(0), m_items(0), m_errors(0), m_busy(0), m_latency(0), m_maxLatency(0) {}
+
+            ~PipeStage()
+            {
+                close();
+                Stop();
+                Join();
+            }
+
+            /**
+            * \brief wakes workers waiting to hand on a result
+            **/
+            void close()
+            {
+                m_out->close();
+            }
+
+            /**
+            * \brief empties the stage's queue and clears the reordering state
+            *        and statistics for a new Start()
+            **/
+            void reset()
+            {
+                m_in->reset();
+                std::lock_guard<std::mutex> l(m_orderMutex);
+                m_waiting.clear();
+                m_nextSeq = 0;
+                m_items = 0;
+                m_errors = 0;
+                m_busy = 0;
+                m_latency = 0;
+                m_maxLatency = 0;
+                m_started = PipeClock::now();
+            }
+
+            StageStats getStats()
+            {
+                StageStats stats;
+                stats.name = m_name;
+                stats.threads = getNumThreads();
+                stats.limit = m_in->getLimit();
+                stats.inFlight = m_in->size();
+                stats.items = m_items;
+                stats.errors = m_errors;
+
+                double elapsed = seconds(PipeClock::now() - m_started);
+                double done = (double)std::max<uint64_t>(stats.items + stats.errors, 1);
+                stats.throughput = elapsed > 0 ? stats.items / elapsed : 0;
+                stats.meanLatency = seconds(m_latency.load()) / done;
+                stats.maxLatency = seconds(m_maxLatency.load());
+                stats.utilization = elapsed > 0 ? seconds(m_busy.load()) / (elapsed * stats.threads) : 0;
+                return stats;
+            }
+
+        private:
+            static double seconds(PipeClock::duration d)
+            {
+                return std::chrono::duration<double>(d).count();
+            }
+
+            static double seconds(int64_t ticks)
+            {
+                return seconds(PipeClock::duration(ticks));
+            }
+
+            /**
+            * \brief processes one item
+            **/
+            void mainLoop()
+            {
+                PipeItem<In> item;
+                if (!m_in->take(item, 10)) {
+                    return;
+                }
+
+                PipeItem<Out> result;
+                result.seq = item.seq;
+                result.valid = item.valid;
+                if (item.valid) {
+                    PipeClock::time_point start = PipeClock::now();
+                    try {
+                        result.value = m_f(std::move(item.value));
+                        m_items++;
+                    } catch (const std::exception& e) {
+                        std::cerr << "WARNING: Pipeline stage " << m_name << " dropped an item: " << e.what() << std::endl;
+                        result.valid = false;
+                        m_errors++;
+                    } catch (...) {
+                        std::cerr << "WARNING: Pipeline stage " << m_name << " dropped an item" << std::endl;
+                        result.valid = false;
+                        m_errors++;
+                    }
+                    PipeClock::time_point end = PipeClock::now();
+                    m_busy += (end - start).count();
+
+                    int64_t latency = (end - item.entered).count();
+                    m_latency += latency;
+                    int64_t longest = m_maxLatency.load();
+                    while (latency > longest && !m_maxLatency.compare_exchange_weak(longest, latency)) {
+                    }
+                }
+
+                emit(std::move(result));
+                m_in->release();
+            }
+
+            /**
+            * \brief hands a result on, after the ones before it if ordered
+            **/
+            void emit(PipeItem<Out>&& result)
+            {
+                if (!m_ordered) {
+                    m_out->put(std::move(result));
+                    return;
+                }
+
+                // Results park here until every earlier one has gone on
+                std::lock_guard<std::mutex> l(m_orderMutex);
+                m_waiting.insert(std::make_pair(result.seq, std::move(result)));
+                auto it = m_waiting.begin();
+                while (it != m_waiting.end() && it->first == m_nextSeq) {
+                    m_out->put(std::move(it->second));
+                    it = m_waiting.erase(it);
+                    m_nextSeq++;
+                }
+            }
+
+            std::function<Out(In)>              m_f;
+            const bool                          m_ordered;
+            std::shared_ptr<PipeLink<In>>       m_in;
+            std::shared_ptr<PipeLink<Out>>      m_out;
+            std::mutex                          m_orderMutex;   //!< Guards m_waiting and m_nextSeq
+            std::map<uint64_t, PipeItem<Out>>   m_waiting;      //!< Results that finished ahead of their turn
+            uint64_t                            m_nextSeq;      //!< Sequence number that goes on next
+            std::atomic<uint64_t>               m_items;
+            std::atomic<uint64_t>               m_errors;
+            std::atomic<int64_t>                m_busy;         //!< Clock ticks spent in m_f
+            std::atomic<int64_t>                m_latency;      //!< Clock ticks summed over items
+            std::atomic<int64_t>                m_maxLatency;   //!< Clock ticks of the slowest item
+            PipeClock::time_point               m_started;
+        };
+
+        /**
+        * \brief the result type of a stage function applied to T
+        **/
+        template<typename F, typename T> struct StageResult {
+            typedef typename std::decay<decltype(std::declval<F&>()(std::declval<T>()))>::type type;
+        };
+    }
+
+    /**
+    * \brief a chain of stages that turns In items into Out items
+    *
+    * \tparam In the type pushed into the pipeline
+    * \tparam Out the type popped from the pipeline; In until a stage is added
+    **/
+    template<typename In, typename Out = In> class Pipeline
+    {
+    public:
+        Pipeline(size_t outputLimit = 16);
+        Pipeline(Pipeline&& other) = default;
+        ~Pipeline();
+
+        template<typename F>
+        Pipeline<In, typename detail::StageResult<F, Out>::type>
+        then(const std::string& name, F f, unsigned threads = 1, size_t inFlight = 0, bool ordered = false) &&;
+
+        bool Start();
+        void Stop();
+        bool Join();
+        bool push(In value);
+        bool pop(Out& value, uint16_t timeout = 0);
+        std::vector<StageStats> getStats();
+        int bottleneck();
+        size_t size();
+
+    private:
+        template<typename, typename> friend class Pipeline;
+
+        Pipeline(std::shared_ptr<detail::PipeLink<In>> in, std::shared_ptr<detail::PipeLink<Out>> out,
+                 std::vector<std::shared_ptr<detail::PipeStageBase>>&& stages, size_t outputLimit);
+
+        std::shared_ptr<detail::PipeLink<In>>               m_in;       //!< Queue of the first stage
+        std::shared_ptr<detail::PipeLink<Out>>              m_out;      //!< Queue that pop() reads
+        std::vector<std::shared_ptr<detail::PipeStageBase>> m_stages;   //!< In order from input to output
+        size_t                                              m_outputLimit; //!< Limit of the last queue
+    };
+
+    /**
+    * \brief creates a pipeline without stages, which passes items through
+    *
+    * \param [in] outputLimit how many finished items may wait for pop()
+    **/
+    template<typename In, typename Out>
+    Pipeline<In, Out>::Pipeline(size_t outputLimit)
+        : m_in(std::make_shared<detail::PipeLink<In>>(outputLimit)), m_out(m_in), m_outputLimit(outputLimit)
+    {
+        static_assert(std::is_same<In, Out>::value, "a pipeline without stages outputs its input type");
+    }
+
+    template<typename In, typename Out>
+    Pipeline<In, Out>::Pipeline(std::shared_ptr<detail::PipeLink<In>> in, std::shared_ptr<detail::PipeLink<Out>> out,
+                                std::vector<std::shared_ptr<detail::PipeStageBase>>&& stages, size_t outputLimit)
+        : m_in(in), m_out(out), m_stages(std::move(stages)), m_outputLimit(outputLimit) {}
+
+    /**
+    * \brief stops the stages and waits for them
+    **/
+    template<typename In, typename Out>
+    Pipeline<In, Out>::~Pipeline()
+    {
+        Stop();
+        Join();
+    }
+
+    /**
+    * \brief adds a stage at the end and returns the longer pipeline
+    *
+    * This pipeline is consumed; use the returned one.
+    *
+    * \param [in] name the stage's name in statistics, warnings and thread names
+    * \param [in] f the function applied to every item; exceptions drop the item
+    * \param [in] threads worker threads of the stage
+    * \param [in] inFlight most items queued for or held by the stage, or 0
+    *             for twice the threads
+    * \param [in] ordered hand results on in the order items entered the pipeline
+    * \return the pipeline with the stage added
+    **/
+    template<typename In, typename Out>
+    template<typename F>
+    Pipeline<In, typename detail::StageResult<F, Out>::type>
+    Pipeline<In, Out>::then(const std::string& name, F f, unsigned threads, size_t inFlight, bool ordered) &&
+    {
+        typedef typename detail::StageResult<F, Out>::type Next;
+
+        threads = std::max(threads, 1u);
+        m_out->setLimit(inFlight ? inFlight : 2 * threads);
+        std::shared_ptr<detail::PipeLink<Next>> out = std::make_shared<detail::PipeLink<Next>>(m_outputLimit);
+
+        std::shared_ptr<detail::PipeStageBase> stage = std::make_shared<detail::PipeStage<Out, Next>>(
+                name, std::function<Next(Out)>(f), threads, ordered, m_out, out);
+        ThreadPlacement placement = stage->getPlacement();
+        placement.name = name;
+        stage->setPlacement(placement);
+        m_stages.push_back(stage);
+
+        return Pipeline<In, Next>(std::move(m_in), out, std::move(m_stages), m_outputLimit);
+    }
+
+    /**
+    * \brief empties the queues and starts every stage
+    *
+    * \return false if the pipeline is already running
+    **/
+    template<typename In, typename Out>
+    bool Pipeline<In, Out>::Start()
+    {
+        for (auto& stage : m_stages) {
+            if (stage->isRunning()) {
+                std::cerr << "WARNING: Pipeline already running" << std::endl;
+                return false;
+            }
+        }
+
+        // Every other link is the input of a stage
+        m_out->reset();
+        for (auto& stage : m_stages) {
+            stage->reset();
+        }
+        bool rc = true;
+        for (auto& stage : m_stages) {
+            rc = stage->Start() && rc;
+        }
+        return rc;
+    }
+
+    /**
+    * \brief stops the stages; items still in the pipeline are dropped on
+    *        the next Start()
+    **/
+    template<typename In, typename Out>
+    void Pipeline<In, Out>::Stop()
+    {
+        if (!m_in) {
+            return;
+        }
+        m_in->close();
+        for (auto& stage : m_stages) {
+            stage->close();
+            stage->Stop();
+        }
+    }
+
+    /**
+    * \brief waits for the stages' threads to exit
+    **/
+    template<typename In, typename Out>
+    bool Pipeline<In, Out>::Join()
+    {
+        bool rc = true;
+        for (auto& stage : m_stages) {
+            rc = stage->Join() && rc;
+        }
+        return rc;
+    }
+
+    /**
+    * \brief adds an item, waiting while the first stage is at its limit
+    *
+    * \param [in] value the item
+    * \return false if the pipeline was stopped
+    **/
+    template<typename In, typename Out>
+    bool Pipeline<In, Out>::push(In value)
+    {
+        detail::PipeItem<In> item;
+        item.seq = m_in->stamp();
+        item.valid = true;
+        item.value = std::move(value);
+        return m_in->put(std::move(item));
+    }
+
+    /**
+    * \brief takes the oldest finished item
+    *
+    * \param [out] value the item
+    * \param [in] timeout milliseconds to wait for an item; 0 does not wait
+    * \return true if an item was taken
+    **/
+    template<typename In, typename Out>
+    bool Pipeline<In, Out>::pop(Out& value, uint16_t timeout)
+    {
+        detail::PipeItem<Out> item;
+        while (m_out->take(item, timeout)) {
+            m_out->release();
+            if (item.valid) {
+                value = std::move(item.value);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+    * \brief returns the statistics of every stage, from input to output
+    **/
+    template<typename In, typename Out>
+    std::vector<StageStats> Pipeline<In, Out>::getStats()
+    {
+        std::vector<StageStats> stats;
+        for (auto& stage : m_stages) {
+            stats.push_back(stage->getStats());
+        }
+        return stats;
+    }
+
+    /**
+    * \brief returns the index of the busiest stage, or -1 without stages
+    **/
+    template<typename In, typename Out>
+    int Pipeline<In, Out>::bottleneck()
+    {
+        std::vector<StageStats> stats = getStats();
+        int busiest = -1;
+        for (size_t i = 0; i < stats.size(); i++) {
+            if (busiest < 0 || stats[i].utilization > stats[busiest].utilization) {
+                busiest = (int)i;
+            }
+        }
+        return busiest;
+    }
+
+    /**
+    * \brief returns the number of items in the pipeline, finished or not
+    **/
+    template<typename In, typename Out>
+    size_t Pipeline<In, Out>::size()
+    {
+        size_t items = m_out->size();
+        for (auto& stage : m_stages) {
+            items += stage->getStats().inFlight;
+        }
+        return items;
+    }
+}
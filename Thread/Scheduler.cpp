@@ -0,0 +1,212 @@
+/**
+ * \file Scheduler.cpp
+ **/
+
+#include "Scheduler.h"
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+namespace atl
+{
+
+namespace
+{
+    Scheduler::Clock::duration toDuration(double seconds)
+    {
+        return std::chrono::duration_cast<Scheduler::Clock::duration>(std::chrono::duration<double>(seconds));
+    }
+}
+
+/**
+* \brief creates a stopped scheduler
+*
+* \param [in] pool the pool that runs the tasks, or null to run them on the
+*             scheduler thread; it must outlive the scheduler
+**/
+Scheduler::Scheduler(ThreadPool* pool): m_pool(pool), m_nextId(1) {}
+
+/**
+* \brief stops the scheduler; tasks already handed to the pool still run
+**/
+Scheduler::~Scheduler()
+{
+    Stop();
+    Join();
+}
+
+/**
+* \brief runs f once at a point in time
+*
+* \param [in] when the deadline; past deadlines run right away
+* \param [in] f the task
+* \return an id for cancel()
+**/
+Scheduler::TaskId Scheduler::scheduleAt(Clock::time_point when, std::function<void()> f)
+{
+    return add(when, Clock::duration::zero(), f);
+}
+
+/**
+* \brief runs f once after a delay
+*
+* \param [in] seconds the delay
+* \param [in] f the task
+* \return an id for cancel()
+**/
+Scheduler::TaskId Scheduler::scheduleAfter(double seconds, std::function<void()> f)
+{
+    return add(Clock::now() + toDuration(seconds), Clock::duration::zero(), f);
+}
+
+/**
+* \brief runs f every period until it is cancelled
+*
+* \param [in] period seconds between the starts of runs, greater than 0
+* \param [in] f the task
+* \param [in] delay seconds to the first run, or negative for one period
+* \return an id for cancel(), or 0 if the period is not positive
+**/
+Scheduler::TaskId Scheduler::scheduleEvery(double period, std::function<void()> f, double delay)
+{
+    if (period <= 0) {
+        std::cerr << "WARNING: Scheduler period must be positive, not " << period << std::endl;
+        return 0;
+    }
+    return add(Clock::now() + toDuration(delay < 0 ? period : delay), toDuration(period), f);
+}
+
+/**
+* \brief removes a task; a run already dispatched still finishes
+*
+* \param [in] id the task's id
+* \return true if the task was pending
+**/
+bool Scheduler::cancel(TaskId id)
+{
+    std::lock_guard<std::mutex> l(m_mutex);
+    auto it = m_tasks.find(id);
+    if (it == m_tasks.end()) {
+        return false;
+    }
+    // Its heap entry is dropped when it comes due
+    it->second->cancelled = true;
+    m_tasks.erase(it);
+    return true;
+}
+
+/**
+* \brief returns the number of tasks that will still run
+**/
+size_t Scheduler::size()
+{
+    std::lock_guard<std::mutex> l(m_mutex);
+    return m_tasks.size();
+}
+
+/**
+* \brief stops the scheduler thread; pending tasks keep their deadlines
+*        for the next Start()
+**/
+void Scheduler::Stop()
+{
+    Thread::Stop();
+    std::lock_guard<std::mutex> l(m_mutex);
+    m_cv.notify_all();
+}
+
+/**
+* \brief adds a task to the heap, waking the thread if it is now the first
+**/
+Scheduler::TaskId Scheduler::add(Clock::time_point when, Clock::duration period, std::function<void()> f)
+{
+    std::lock_guard<std::mutex> l(m_mutex);
+    TaskId id = m_nextId++;
+    std::shared_ptr<Task> task = std::make_shared<Task>(id, f, period);
+    m_tasks[id] = task;
+
+    Deadline deadline = {when, task};
+    m_heap.push_back(deadline);
+    std::push_heap(m_heap.begin(), m_heap.end());
+    if (m_heap.front().task == task) {
+        m_cv.notify_all();
+    }
+    return id;
+}
+
+/**
+* \brief waits for the earliest deadline and dispatches its task
+**/
+void Scheduler::mainLoop()
+{
+    std::unique_lock<std::mutex> l(m_mutex);
+    if (!isRunning()) {
+        return;
+    }
+    if (m_heap.empty()) {
+        m_cv.wait(l);
+        return;
+    }
+    Clock::time_point now = Clock::now();
+    Clock::time_point when = m_heap.front().when;
+    if (now < when) {
+        m_cv.wait_until(l, when);
+        return;
+    }
+
+    std::pop_heap(m_heap.begin(), m_heap.end());
+    std::shared_ptr<Task> task = std::move(m_heap.back().task);
+    m_heap.pop_back();
+    if (task->cancelled) {
+        return;
+    }
+
+    if (task->period == Clock::duration::zero()) {
+        m_tasks.erase(task->id);
+    } else {
+        // The next deadline follows from this one, not from now, so
+        // periods don't drift; deadlines missed entirely are skipped
+        Clock::time_point next = when + task->period;
+        if (next <= now) {
+            next += task->period * ((now - next) / task->period + 1);
+        }
+        Deadline deadline = {next, task};
+        m_heap.push_back(deadline);
+        std::push_heap(m_heap.begin(), m_heap.end());
+    }
+    l.unlock();
+
+    if (!task->running.exchange(true)) {
+        dispatch(task);
+    }
+}
+
+/**
+* \brief runs a task on the pool, or here if there is no pool or it is full
+**/
+void Scheduler::dispatch(const std::shared_ptr<Task>& task)
+{
+    if (m_pool) {
+        std::shared_ptr<Task> t = task;
+        if (m_pool->push_job([t] { run(*t); })) {
+            return;
+        }
+    }
+    run(*task);
+}
+
+/**
+* \brief runs a task once and marks it idle
+**/
+void Scheduler::run(Task& task)
+{
+    try {
+        task.f();
+    } catch (const std::exception& e) {
+        std::cerr << "WARNING: Scheduler task " << task.id << " threw: " << e.what() << std::endl;
+    } catch (...) {
+        std::cerr << "WARNING: Scheduler task " << task.id << " threw" << std::endl;
+    }
+    task.running = false;
+}
+}
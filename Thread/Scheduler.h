@@ -0,0 +1,83 @@
+/**
+ * \file Scheduler.h
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Thread.h"
+#include "ThreadPool.h"
+
+namespace atl
+{
+    /**
+    * \brief runs one-shot and periodic tasks at deadlines, all from one thread
+    *
+    * Deadlines are absolute times on the monotonic clock, kept in a min-heap,
+    * so a periodic task runs at start + k * period no matter how long each
+    * run takes, and does not drift. A run that is still going when the next
+    * one is due, or that falls more than a period behind, is skipped rather
+    * than queued. With a pool the tasks run on its workers and the
+    * scheduler thread only keeps time; without one they run on the
+    * scheduler thread, which suits short tasks. Exceptions thrown by a task
+    * are reported and dropped.
+    **/
+    class Scheduler : private Thread
+    {
+    public:
+        typedef std::chrono::steady_clock Clock;
+        typedef uint64_t TaskId;
+
+        Scheduler(ThreadPool* pool = nullptr);
+        ~Scheduler();
+
+        TaskId scheduleAt(Clock::time_point when, std::function<void()> f);
+        TaskId scheduleAfter(double seconds, std::function<void()> f);
+        TaskId scheduleEvery(double period, std::function<void()> f, double delay = -1);
+        bool cancel(TaskId id);
+        size_t size();
+
+        using Thread::Start;
+        void Stop();
+        using Thread::Join;
+        using Thread::isRunning;
+
+    private:
+        struct Task {
+            TaskId                  id;
+            std::function<void()>   f;
+            Clock::duration         period;     //!< Zero for one-shot tasks
+            std::atomic_bool        running;    //!< A run has been dispatched and not finished
+            std::atomic_bool        cancelled;
+
+            Task(TaskId i, std::function<void()> fn, Clock::duration p)
+                : id(i), f(fn), period(p), running(false), cancelled(false) {}
+        };
+
+        struct Deadline {
+            Clock::time_point       when;
+            std::shared_ptr<Task>   task;
+
+            bool operator<(const Deadline& other) const { return when > other.when; }
+        };
+
+        TaskId add(Clock::time_point when, Clock::duration period, std::function<void()> f);
+        void mainLoop();
+        void dispatch(const std::shared_ptr<Task>& task);
+        static void run(Task& task);
+
+        ThreadPool*                             m_pool;     //!< Runs the tasks, or null for this thread
+        std::mutex                              m_mutex;    //!< Guards everything below
+        std::condition_variable                 m_cv;       //!< Signaled on an earlier deadline or Stop()
+        std::vector<Deadline>                   m_heap;     //!< Next deadline of each task, earliest first
+        std::map<TaskId, std::shared_ptr<Task>> m_tasks;    //!< Tasks not yet finished or cancelled
+        TaskId                                  m_nextId;
+    };
+}
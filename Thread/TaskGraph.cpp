@@ -0,0 +1,224 @@
+/**
+ * \file TaskGraph.cpp
+ **/
+
+#include "TaskGraph.h"
+#include <algorithm>
+#include <iostream>
+
+namespace atl
+{
+
+/**
+* \brief creates an empty graph of jobs on a pool
+*
+* \param [in] pool the pool that runs the jobs; it must outlive the graph
+**/
+TaskGraph::TaskGraph(ThreadPool& pool): m_pool(pool), m_checked(true), m_pending(0), m_failed(false) {}
+
+/**
+* \brief waits for a running graph; exceptions from it are dropped
+**/
+TaskGraph::~TaskGraph()
+{
+    try {
+        wait();
+    } catch (...) {
+    }
+}
+
+/**
+* \brief adds a node
+*
+* \param [in] f the node's job
+* \return the node's id, or size() if the graph is running
+**/
+TaskGraph::Node TaskGraph::add(std::function<void()> f)
+{
+    if (isRunning()) {
+        std::cerr << "WARNING: TaskGraph nodes cannot be added while it runs" << std::endl;
+        return m_nodes.size();
+    }
+    m_roots.push_back(m_nodes.size());
+    m_nodes.emplace_back(new Vertex(f));
+    return m_nodes.size() - 1;
+}
+
+/**
+* \brief makes one node wait for another
+*
+* \param [in] before the node that runs first
+* \param [in] after the node that runs once before has finished
+* \return true if the edge was added
+**/
+bool TaskGraph::precede(Node before, Node after)
+{
+    if (isRunning() || before >= m_nodes.size() || after >= m_nodes.size() || before == after) {
+        std::cerr << "WARNING: TaskGraph cannot add edge " << before << " -> " << after << std::endl;
+        return false;
+    }
+    m_nodes[before]->successors.push_back(after);
+    if (m_nodes[after]->predecessors++ == 0) {
+        m_roots.erase(std::find(m_roots.begin(), m_roots.end(), after));
+    }
+    m_checked = false;
+    return true;
+}
+
+/**
+* \brief starts the graph without waiting for it
+*
+* \return false if the graph is already running or has a cycle
+**/
+bool TaskGraph::run()
+{
+    if (isRunning()) {
+        return false;
+    }
+    if (!m_checked && !acyclic()) {
+        std::cerr << "WARNING: TaskGraph has a cycle and cannot run" << std::endl;
+        return false;
+    }
+    m_checked = true;
+    if (m_nodes.empty()) {
+        return true;
+    }
+
+    for (auto& node : m_nodes) {
+        node->remaining.store(node->predecessors, std::memory_order_relaxed);
+    }
+    m_failed = false;
+    m_pending = m_nodes.size();
+    for (Node root : m_roots) {
+        dispatch(root);
+    }
+    return true;
+}
+
+/**
+* \brief waits until every node of the current run has finished
+*
+* Runs queued jobs of the pool while waiting. Rethrows the first exception
+* a node threw in the run.
+**/
+void TaskGraph::wait()
+{
+    while (m_pending.load() != 0) {
+        if (!m_pool.run_pending_job()) {
+            std::unique_lock<std::mutex> l(m_mutex);
+            m_done.wait_for(l, std::chrono::microseconds(200),
+                    [this] { return m_pending.load() == 0; });
+        }
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        std::swap(error, m_error);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+/**
+* \brief returns true if a run has nodes that have not finished
+**/
+bool TaskGraph::isRunning()
+{
+    return m_pending.load() != 0;
+}
+
+/**
+* \brief returns the number of nodes
+**/
+size_t TaskGraph::size()
+{
+    return m_nodes.size();
+}
+
+/**
+* \brief checks for a cycle by peeling off nodes without predecessors
+**/
+bool TaskGraph::acyclic()
+{
+    std::vector<size_t> remaining(m_nodes.size());
+    for (size_t i = 0; i < m_nodes.size(); i++) {
+        remaining[i] = m_nodes[i]->predecessors;
+    }
+    std::vector<Node> ready = m_roots;
+    size_t visited = 0;
+    while (!ready.empty()) {
+        Node node = ready.back();
+        ready.pop_back();
+        visited++;
+        for (Node next : m_nodes[node]->successors) {
+            if (--remaining[next] == 0) {
+                ready.push_back(next);
+            }
+        }
+    }
+    return visited == m_nodes.size();
+}
+
+/**
+* \brief hands a ready node to the pool, or runs it here if the pool is full
+**/
+void TaskGraph::dispatch(Node node)
+{
+    // Small enough for std::function to store without allocating
+    if (!m_pool.push_job([this, node] { execute(node); })) {
+        execute(node);
+    }
+}
+
+/**
+* \brief runs a node and then its successors that became ready
+**/
+void TaskGraph::execute(Node node)
+{
+    const Node none = m_nodes.size();
+    for (;;) {
+        Vertex& vertex = *m_nodes[node];
+        if (!m_failed) {
+            try {
+                vertex.f();
+            } catch (...) {
+                std::lock_guard<std::mutex> l(m_mutex);
+                if (!m_error) {
+                    m_error = std::current_exception();
+                }
+                m_failed = true;
+            }
+        }
+
+        // The first ready successor continues on this thread
+        Node next = none;
+        for (Node successor : vertex.successors) {
+            if (m_nodes[successor]->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                if (next == none) {
+                    next = successor;
+                } else {
+                    dispatch(successor);
+                }
+            }
+        }
+
+        // The last node clears the count under the lock, so a waiter that
+        // sees it reach 0 cannot destroy the graph before the wakeup
+        size_t pending = m_pending.load();
+        while (pending > 1 && !m_pending.compare_exchange_weak(pending, pending - 1)) {
+        }
+        if (pending == 1) {
+            std::lock_guard<std::mutex> l(m_mutex);
+            m_pending = 0;
+            m_done.notify_all();
+            return;
+        }
+        if (next == none) {
+            return;
+        }
+        node = next;
+    }
+}
+}
@@ -0,0 +1,73 @@
+/**
+ * \file TaskGraph.h
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "ThreadPool.h"
+
+namespace atl
+{
+    /**
+    * \brief a graph of jobs on a ThreadPool where edges are dependencies
+    *
+    * Each node counts its unfinished predecessors atomically, and the
+    * node that finishes last hands the successor to the pool, so nodes run
+    * as soon as their own inputs are done rather than level by level. A
+    * finishing node runs one ready successor itself, which keeps chains on
+    * the same core. The graph can be run again once it has finished; a
+    * run only resets the counters, so nothing is allocated per run.
+    *
+    * After a node throws, nodes that have not started are skipped and
+    * wait() rethrows the first exception. Nodes and edges may only be added
+    * while the graph is not running.
+    **/
+    class TaskGraph
+    {
+    public:
+        typedef size_t Node;
+
+        TaskGraph(ThreadPool& pool);
+        ~TaskGraph();
+        TaskGraph(const TaskGraph&) = delete;
+        TaskGraph& operator=(const TaskGraph&) = delete;
+
+        Node add(std::function<void()> f);
+        bool precede(Node before, Node after);
+        bool run();
+        void wait();
+        bool isRunning();
+        size_t size();
+
+    private:
+        struct Vertex {
+            std::function<void()>   f;
+            std::vector<Node>       successors;
+            size_t                  predecessors;   //!< Number of edges into this node
+            std::atomic<size_t>     remaining;      //!< Predecessors not yet finished in this run
+
+            Vertex(std::function<void()> fn) : f(fn), predecessors(0), remaining(0) {}
+        };
+
+        bool acyclic();
+        void dispatch(Node node);
+        void execute(Node node);
+
+        ThreadPool&                             m_pool;
+        std::vector<std::unique_ptr<Vertex>>    m_nodes;
+        std::vector<Node>                       m_roots;    //!< Nodes without predecessors
+        bool                                    m_checked;  //!< The graph is known to have no cycle
+        std::atomic<size_t>                     m_pending;  //!< Nodes not yet finished in this run
+        std::atomic_bool                        m_failed;   //!< A node threw in this run
+        std::mutex                              m_mutex;    //!< Guards m_error and the wakeup
+        std::condition_variable                 m_done;     //!< Signaled when m_pending reaches 0
+        std::exception_ptr                      m_error;    //!< First exception thrown in this run
+    };
+}
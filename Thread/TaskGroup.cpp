@@ -0,0 +1,80 @@
+/**
+ * \file TaskGroup.cpp
+ **/
+
+#include "TaskGroup.h"
+
+namespace atl
+{
+
+/**
+* \brief creates an empty group of jobs on a pool
+*
+* \param [in] pool the pool that runs the jobs; it must outlive the group
+**/
+TaskGroup::TaskGroup(ThreadPool& pool): m_pool(pool), m_state(std::make_shared<State>()) {}
+
+/**
+* \brief waits for the group's jobs; exceptions from them are dropped
+**/
+TaskGroup::~TaskGroup()
+{
+    try {
+        wait();
+    } catch (...) {
+    }
+}
+
+/**
+* \brief records a finished job, waking wait() when it was the last
+*
+* \param [in] state the group's state
+* \param [in] error the exception the job threw, or null
+**/
+void TaskGroup::finish(State& state, std::exception_ptr error)
+{
+    std::lock_guard<std::mutex> l(state.mutex);
+    if (error && !state.error) {
+        state.error = error;
+    }
+    if (--state.pending == 0) {
+        state.done.notify_all();
+    }
+}
+
+/**
+* \brief waits until every job added with run() has finished
+*
+* Runs queued jobs of the pool while waiting. Rethrows the first exception
+* a job threw since the last wait().
+**/
+void TaskGroup::wait()
+{
+    while (m_state->pending.load() != 0) {
+        if (!m_pool.run_pending_job()) {
+            // Jobs still running elsewhere; the timeout picks up new jobs
+            // those spawn onto the pool
+            std::unique_lock<std::mutex> l(m_state->mutex);
+            m_state->done.wait_for(l, std::chrono::microseconds(200),
+                    [this] { return m_state->pending.load() == 0; });
+        }
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> l(m_state->mutex);
+        std::swap(error, m_state->error);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+/**
+* \brief returns the number of the group's jobs that have not finished
+**/
+size_t TaskGroup::pending()
+{
+    return m_state->pending.load();
+}
+}
@@ -0,0 +1,82 @@
+/**
+ * \file TaskGroup.h
+ **/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include "ThreadPool.h"
+
+namespace atl
+{
+    /**
+    * \brief a batch of jobs on a ThreadPool that can be waited on by itself
+    *
+    * wait() returns once every job passed to run() has finished, no matter
+    * what else the pool is doing, and runs queued jobs on the waiting thread
+    * in the meantime, so groups can be nested inside pool jobs. The first
+    * exception thrown by a job is rethrown from wait(). The destructor waits
+    * too, so jobs may refer to locals of the scope that owns the group.
+    **/
+    class TaskGroup
+    {
+    public:
+        TaskGroup(ThreadPool& pool);
+        ~TaskGroup();
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+
+        template<typename F> void run(F&& f);
+        void wait();
+        size_t pending();
+
+    private:
+        struct State {
+            std::atomic<size_t>     pending;    //!< Jobs not yet finished
+            std::mutex              mutex;      //!< Guards error and the wakeup
+            std::condition_variable done;       //!< Signaled when pending reaches 0
+            std::exception_ptr      error;      //!< First exception thrown by a job
+
+            State() : pending(0) {}
+        };
+
+        static void finish(State& state, std::exception_ptr error);
+
+        ThreadPool&             m_pool;
+        std::shared_ptr<State>  m_state;    //!< Shared with queued jobs, which may finish after wait() returns
+    };
+
+    /**
+    * \brief adds a job to the group
+    *
+    * The callable is moved into the job, so it may be move-only. If the
+    * pool's queue is full the job runs on the calling thread.
+    *
+    * \param [in] f the job
+    **/
+    template<typename F> void TaskGroup::run(F&& f)
+    {
+        typedef typename std::decay<F>::type Fn;
+        std::shared_ptr<State> state = m_state;
+        std::shared_ptr<Fn> fn = std::make_shared<Fn>(std::forward<F>(f));
+        auto job = [state, fn] {
+            std::exception_ptr error;
+            try {
+                (*fn)();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            finish(*state, error);
+        };
+
+        state->pending++;
+        if (!m_pool.push_job(job)) {
+            job();
+        }
+    }
+}
@@ -2,53 +2,428 @@
  * \file TaskManager.tcc
  **/
 
-#include <map>
+#include <atomic>
+#include <list>
+#include <chrono>
 #include <thread>
 #include <future>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "AtlMutexWrap.h"
+#include "ThreadPool.h"
+#include "CancelToken.h"
 
 #pragma once
 
 namespace atl
 {
 
-template<typename Key, typename ReturnType>
+namespace detail
+{
+    /**
+     * \brief passes a finished result or exception on to a promise
+     */
+    template<typename R> void fulfill(std::promise<R>& p, const std::shared_future<R>& result)
+    {
+        try {
+            p.set_value(result.get());
+        } catch (...) {
+            p.set_exception(std::current_exception());
+        }
+    }
+
+    inline void fulfill(std::promise<void>& p, const std::shared_future<void>& result)
+    {
+        try {
+            result.get();
+            p.set_value();
+        } catch (...) {
+            p.set_exception(std::current_exception());
+        }
+    }
+}
+
+/**
+ * \brief runs a job once for all callers that ask for the same key at the
+ * same time
+ *
+ * performJob() runs the job on the first caller's thread while the others
+ * wait. performJobAsync() runs it on a ThreadPool and returns at once, so a
+ * caller can start jobs for many keys and then wait for all of them. Keys
+ * are spread over shards with their own locks, so callers asking for
+ * different keys rarely wait on each other.
+ *
+ * With caching on, a finished result also stays for a while, so callers
+ * that come shortly after get it without running the job again: until a
+ * time to live passes, and/or while it is among the most recently used
+ * results of its shard. Jobs that throw are forgotten at once unless
+ * failures are cached too, in which case later callers get the same
+ * exception.
+ */
+template<typename Key, typename ReturnType, typename Hash = std::hash<Key>>
 class TaskManager
 {
 public:
+    TaskManager(double ttl = 0, size_t maxCached = 0, bool cacheFailures = false, unsigned shards = 16);
     ReturnType performJob(Key id, std::function<ReturnType(void)> f);
+    std::shared_future<ReturnType> performJobAsync(ThreadPool& pool, Key id, std::function<ReturnType(void)> f,
+                                                   CancelToken token = CancelToken::none());
+    void setCaching(double ttl, size_t maxCached = 0, bool cacheFailures = false);
+    bool invalidate(Key id);
+    void clearCache();
+    size_t cached();
 
 protected:
-    std::map<Key, std::shared_future<ReturnType>> m_futureMap;
-    std::mutex m_mutex;
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry {
+        std::shared_future<ReturnType>      future;
+        uint64_t                            generation; //!< Tells this job from later ones for the same key
+        bool                                done;       //!< Finished and cached
+        Clock::time_point                   expires;
+        typename std::list<Key>::iterator   lru;        //!< Position in the shard's lru while done
+    };
+
+    typedef std::unordered_map<Key, Entry, Hash> EntryMap;
+
+    /**
+     * \brief a job handed to a pool; if the pool drops it without running
+     * it, the key is forgotten and callers get a broken_promise error
+     */
+    struct Job {
+        TaskManager*                        manager;
+        Key                                 id;
+        uint64_t                            generation;
+        std::function<ReturnType(void)>     f;
+        std::promise<ReturnType>            promise;
+        bool                                ran;
+
+        ~Job()
+        {
+            if (!ran) {
+                manager->finish(id, generation, true, true);
+            }
+        }
+
+        void operator()()
+        {
+            // The result is cached before callers see it, so a caller that
+            // got it finds it cached
+            std::shared_future<ReturnType> result = std::async(std::launch::deferred, f).share();
+            bool failed = false;
+            try {
+                result.get();
+            } catch (...) {
+                failed = true;
+            }
+            ran = true;
+            manager->finish(id, generation, failed);
+            detail::fulfill(promise, result);
+        }
+    };
+
+    struct Shard {
+        AtlAdaptiveMutex    mutex;
+        EntryMap            futures;
+        std::list<Key>      lru;        //!< Cached keys, most recently used first
+    };
+
+    Shard& shard(const Key& id);
+    bool find(Shard& s, const Key& id, std::shared_future<ReturnType>& fut);
+    uint64_t add(Shard& s, const Key& id, std::shared_future<ReturnType> fut);
+    void finish(const Key& id, uint64_t generation, bool failed, bool dropped = false);
+    bool caching();
+    size_t shardLimit();
+    void erase(Shard& s, typename EntryMap::iterator it);
+    void trim(Shard& s, size_t keep);
+
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    std::atomic<uint64_t> m_generation;
+    std::atomic<Clock::duration> m_ttl;     //!< Zero caches nothing, negative never expires
+    std::atomic<size_t> m_maxCached;        //!< Most cached results, or 0 for no limit
+    std::atomic_bool m_cacheFailures;
 };
 
-template<typename Key, typename ReturnType>
-ReturnType TaskManager<Key, ReturnType>::performJob(Key id, std::function<ReturnType(void)> f)
+/**
+ * \brief creates a task manager
+ *
+ * \param ttl seconds a finished result stays cached; 0 caches nothing and
+ *        a negative time never expires
+ * \param maxCached most results kept, dropping the least recently used; each
+ *        shard keeps its share of them; 0 for no limit
+ * \param cacheFailures keep exceptions thrown by jobs like results
+ * \param shards number of separately locked parts of the key map
+ */
+template<typename Key, typename ReturnType, typename Hash>
+TaskManager<Key, ReturnType, Hash>::TaskManager(double ttl, size_t maxCached, bool cacheFailures, unsigned shards)
+    : m_generation(0), m_ttl(Clock::duration::zero()), m_maxCached(0), m_cacheFailures(false)
+{
+    for (unsigned i = 0; i < std::max(1u, shards); i++) {
+        m_shards.emplace_back(new Shard());
+    }
+    setCaching(ttl, maxCached, cacheFailures);
+}
+
+template<typename Key, typename ReturnType, typename Hash>
+ReturnType TaskManager<Key, ReturnType, Hash>::performJob(Key id, std::function<ReturnType(void)> f)
 {
     std::shared_future<ReturnType> fut;
-    bool added;
+    uint64_t generation = 0;
 
-    std::unique_lock<std::mutex> l(m_mutex);
-    if(m_futureMap.find(id) == m_futureMap.end()) {
+    Shard& s = shard(id);
+    std::unique_lock<AtlAdaptiveMutex> l(s.mutex);
+    if (!find(s, id, fut)) {
         fut = std::async(std::launch::deferred, f).share();
-        m_futureMap[id] = fut;
-        added = true;
-
-    } else {
-        fut = m_futureMap[id];
-        added = false;
+        generation = add(s, id, fut);
     }
     l.unlock();
 
     fut.wait();
 
-    if(added) {
-        l.lock();
-        m_futureMap.erase(id);
-        l.unlock();
+    if (generation) {
+        bool failed = false;
+        try {
+            fut.get();
+        } catch (...) {
+            failed = true;
+        }
+        finish(id, generation, failed);
     }
 
     return fut.get();
 }
 
+/**
+ * \brief starts a job on a pool unless one with the same key is running or
+ * cached, and returns its future without waiting
+ *
+ * If the pool's queue is full the job runs here before this returns. If
+ * shutdown() has closed the pool the job is dropped and its future throws
+ * std::future_error. A job started by performJob() that has not begun yet
+ * runs on the first thread to wait for it. The manager must outlive the
+ * jobs it starts.
+ *
+ * If the token is cancelled before the job starts, the job is dropped and
+ * its future throws std::future_error; callers that share the job share
+ * that outcome. The job can poll its own copy of the token while it runs.
+ *
+ * \param pool the pool that runs the job
+ * \param id the job's key
+ * \param f the job
+ * \param token cancels the job or gives it a deadline
+ * \return the job's future
+ */
+template<typename Key, typename ReturnType, typename Hash>
+std::shared_future<ReturnType> TaskManager<Key, ReturnType, Hash>::performJobAsync(ThreadPool& pool, Key id,
+        std::function<ReturnType(void)> f, CancelToken token)
+{
+    std::shared_future<ReturnType> fut;
+
+    Shard& s = shard(id);
+    std::unique_lock<AtlAdaptiveMutex> l(s.mutex);
+    if (find(s, id, fut)) {
+        return fut;
+    }
+    std::promise<ReturnType> promise;
+    fut = promise.get_future().share();
+    uint64_t generation = add(s, id, fut);
+    l.unlock();
+
+    std::shared_ptr<Job> job(new Job{this, id, generation, f, std::move(promise), false});
+
+    auto run = [job]() { (*job)(); };
+    if (!pool.push_job(run, token) && !token.cancelled() && !pool.isClosed()) {
+        run();
+    }
+    return fut;
+}
+
+/**
+ * \brief changes how finished results are cached; results already cached
+ * keep their expiry time
+ *
+ * \param ttl seconds a finished result stays cached; 0 caches nothing and
+ *        a negative time never expires
+ * \param maxCached most results kept, or 0 for no limit
+ * \param cacheFailures keep exceptions thrown by jobs like results
+ */
+template<typename Key, typename ReturnType, typename Hash>
+void TaskManager<Key, ReturnType, Hash>::setCaching(double ttl, size_t maxCached, bool cacheFailures)
+{
+    m_ttl = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(ttl));
+    m_maxCached = maxCached;
+    m_cacheFailures = cacheFailures;
+
+    size_t keep = shardLimit();
+    for (auto& s : m_shards) {
+        std::lock_guard<AtlAdaptiveMutex> l(s->mutex);
+        if (!caching()) {
+            trim(*s, 0);
+        } else if (keep) {
+            trim(*s, keep);
+        }
+    }
+}
+
+/**
+ * \brief drops the cached result of a key, so the next call runs the job;
+ * a job that is running is not affected
+ *
+ * \return true if a result was dropped
+ */
+template<typename Key, typename ReturnType, typename Hash>
+bool TaskManager<Key, ReturnType, Hash>::invalidate(Key id)
+{
+    Shard& s = shard(id);
+    std::lock_guard<AtlAdaptiveMutex> l(s.mutex);
+    auto it = s.futures.find(id);
+    if (it == s.futures.end() || !it->second.done) {
+        return false;
+    }
+    erase(s, it);
+    return true;
+}
+
+/**
+ * \brief drops every cached result
+ */
+template<typename Key, typename ReturnType, typename Hash>
+void TaskManager<Key, ReturnType, Hash>::clearCache()
+{
+    for (auto& s : m_shards) {
+        std::lock_guard<AtlAdaptiveMutex> l(s->mutex);
+        trim(*s, 0);
+    }
+}
+
+/**
+ * \brief returns the number of cached results, including expired ones not
+ * yet asked for again
+ */
+template<typename Key, typename ReturnType, typename Hash>
+size_t TaskManager<Key, ReturnType, Hash>::cached()
+{
+    size_t count = 0;
+    for (auto& s : m_shards) {
+        std::lock_guard<AtlAdaptiveMutex> l(s->mutex);
+        count += s->lru.size();
+    }
+    return count;
+}
+
+template<typename Key, typename ReturnType, typename Hash>
+typename TaskManager<Key, ReturnType, Hash>::Shard& TaskManager<Key, ReturnType, Hash>::shard(const Key& id)
+{
+    return *m_shards[Hash()(id) % m_shards.size()];
+}
+
+/**
+ * \brief looks up the running or unexpired cached job of a key; the
+ * shard's mutex must be held
+ *
+ * \return true if fut was set
+ */
+template<typename Key, typename ReturnType, typename Hash>
+bool TaskManager<Key, ReturnType, Hash>::find(Shard& s, const Key& id, std::shared_future<ReturnType>& fut)
+{
+    auto it = s.futures.find(id);
+    if (it == s.futures.end()) {
+        return false;
+    }
+    if (it->second.done) {
+        if (Clock::now() >= it->second.expires) {
+            erase(s, it);
+            return false;
+        }
+        s.lru.splice(s.lru.begin(), s.lru, it->second.lru);
+    }
+    fut = it->second.future;
+    return true;
+}
+
+/**
+ * \brief records a job that is about to run; the shard's mutex must be held
+ *
+ * \return the job's generation, never 0
+ */
+template<typename Key, typename ReturnType, typename Hash>
+uint64_t TaskManager<Key, ReturnType, Hash>::add(Shard& s, const Key& id, std::shared_future<ReturnType> fut)
+{
+    Entry entry;
+    entry.future = fut;
+    entry.generation = ++m_generation;
+    entry.done = false;
+    s.futures.emplace(id, entry);
+    return entry.generation;
+}
+
+/**
+ * \brief caches or forgets a job that just finished; a dropped job is
+ * always forgotten
+ */
+template<typename Key, typename ReturnType, typename Hash>
+void TaskManager<Key, ReturnType, Hash>::finish(const Key& id, uint64_t generation, bool failed, bool dropped)
+{
+    Shard& s = shard(id);
+    std::lock_guard<AtlAdaptiveMutex> l(s.mutex);
+
+    // The key may have been invalidated and asked for again meanwhile
+    auto it = s.futures.find(id);
+    if (it == s.futures.end() || it->second.generation != generation) {
+        return;
+    }
+    if (dropped || !caching() || (failed && !m_cacheFailures)) {
+        s.futures.erase(it);
+        return;
+    }
+
+    Clock::duration ttl = m_ttl;
+    it->second.done = true;
+    it->second.expires = ttl < Clock::duration::zero() ? Clock::time_point::max() : Clock::now() + ttl;
+    it->second.lru = s.lru.insert(s.lru.begin(), id);
+    size_t keep = shardLimit();
+    if (keep) {
+        trim(s, keep);
+    }
+}
+
+template<typename Key, typename ReturnType, typename Hash>
+bool TaskManager<Key, ReturnType, Hash>::caching()
+{
+    return m_ttl.load() != Clock::duration::zero();
+}
+
+/**
+ * \brief returns the most results one shard keeps, or 0 for no limit
+ */
+template<typename Key, typename ReturnType, typename Hash>
+size_t TaskManager<Key, ReturnType, Hash>::shardLimit()
+{
+    size_t maxCached = m_maxCached;
+    return (maxCached + m_shards.size() - 1) / m_shards.size();
+}
+
+/**
+ * \brief removes a finished entry; the shard's mutex must be held
+ */
+template<typename Key, typename ReturnType, typename Hash>
+void TaskManager<Key, ReturnType, Hash>::erase(Shard& s, typename EntryMap::iterator it)
+{
+    s.lru.erase(it->second.lru);
+    s.futures.erase(it);
+}
+
+/**
+ * \brief drops a shard's least recently used results until keep are left;
+ * the shard's mutex must be held
+ */
+template<typename Key, typename ReturnType, typename Hash>
+void TaskManager<Key, ReturnType, Hash>::trim(Shard& s, size_t keep)
+{
+    while (s.lru.size() > keep) {
+        erase(s, s.futures.find(s.lru.back()));
+    }
+}
+
 }
@@ -0,0 +1,257 @@
+/**
+ * \file ThreadPlacement.cpp
+ **/
+
+#include "ThreadPlacement.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif //_WIN32
+#ifdef __linux__
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif //__linux__
+
+namespace
+{
+    const size_t MAX_NAME = 15;     //!< Longest name pthread_setname_np accepts
+    const int MPOL_PREFERRED = 1;   //!< From linux/mempolicy.h
+
+    /**
+    * \brief reads a kernel CPU list such as "0-3,8,10-11"
+    *
+    * \param [in] path the sysfs file
+    * \return the CPUs, empty if the file could not be read
+    **/
+    std::vector<int> readCpuList(const std::string& path)
+    {
+        std::vector<int> cpus;
+        std::ifstream file(path);
+        std::string item;
+        while (std::getline(file, item, ',')) {
+            int first, last;
+            char dash = 0;
+            std::istringstream range(item);
+            if (!(range >> first)) {
+                continue;
+            }
+            last = first;
+            if (range >> dash && dash == '-' && !(range >> last)) {
+                last = first;
+            }
+            for (int cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+}
+
+namespace atl
+{
+
+/**
+* \brief applies a placement to the calling thread
+*
+* \param [in] placement the settings
+* \param [in] index the thread's index, used for its name and pinned CPU
+* \return true if every setting took effect
+**/
+bool applyThreadPlacement(const ThreadPlacement& placement, int index)
+{
+    bool rc = true;
+    if (!placement.name.empty()) {
+        rc = setThreadName(placement.name + std::to_string(index)) && rc;
+    }
+
+    std::vector<int> cpus = placement.cpus;
+    if (placement.numaNode >= 0) {
+        if (cpus.empty()) {
+            cpus = numaNodeCpus(placement.numaNode);
+        }
+        rc = preferNumaNode(placement.numaNode) && rc;
+    }
+    if (!cpus.empty()) {
+        if (placement.pinEach) {
+            cpus = std::vector<int>(1, cpus[index % cpus.size()]);
+        }
+        rc = setThreadAffinity(cpus) && rc;
+    }
+
+    if (placement.policy >= 0) {
+        rc = setThreadScheduling(placement.policy, placement.priority) && rc;
+    }
+    return rc;
+}
+
+/**
+* \brief names the calling thread, as shown by top, ps and debuggers
+*
+* \param [in] name the name; only the first 15 characters are kept
+* \return true on success
+**/
+bool setThreadName(const std::string& name)
+{
+    std::string shortName = name.substr(0, MAX_NAME);
+#if defined(__APPLE__)
+    int rc = pthread_setname_np(shortName.c_str());
+#elif defined(__linux__)
+    int rc = pthread_setname_np(pthread_self(), shortName.c_str());
+#else
+    int rc = ENOSYS;
+#endif
+    if (rc) {
+        std::cerr << "WARNING: could not name thread " << shortName << ": " << strerror(rc) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+* \brief restricts the calling thread to a set of CPUs
+*
+* \param [in] cpus the CPU numbers
+* \return true on success
+**/
+bool setThreadAffinity(const std::vector<int>& cpus)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    int rc = ENOSYS;
+#endif
+    if (rc) {
+        std::cerr << "WARNING: could not set thread affinity: " << strerror(rc) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+* \brief sets the scheduling policy of the calling thread
+*
+* Real-time policies take a priority, 1 to 99 on Linux, and usually need
+* privileges. The others take a nice value instead, -20 to 19, which Linux
+* applies per thread.
+*
+* \param [in] policy SCHED_OTHER, SCHED_BATCH, SCHED_IDLE, SCHED_FIFO or SCHED_RR
+* \param [in] priority the real-time priority or nice value
+* \return true on success
+**/
+bool setThreadScheduling(int policy, int priority)
+{
+#ifdef __linux__
+    bool realTime = policy == SCHED_FIFO || policy == SCHED_RR;
+    sched_param param;
+    param.sched_priority = realTime ? priority : 0;
+    int rc = pthread_setschedparam(pthread_self(), policy, &param);
+    if (!rc && !realTime && setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), priority)) {
+        rc = errno;
+    }
+#else
+    int rc = ENOSYS;
+#endif
+    if (rc) {
+        std::cerr << "WARNING: could not set thread scheduling: " << strerror(rc) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+* \brief makes the calling thread allocate memory on a NUMA node when it can
+*
+* Pages are placed when first touched, so buffers a worker fills itself
+* end up next to it.
+*
+* \param [in] node the node number
+* \return true on success
+**/
+bool preferNumaNode(int node)
+{
+    if (node < 0) {
+        std::cerr << "WARNING: no NUMA node " << node << std::endl;
+        return false;
+    }
+#if defined(__linux__) && defined(SYS_set_mempolicy)
+    const size_t bits = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(node / bits + 1, 0);
+    mask[node / bits] = 1UL << (node % bits);
+    int rc = syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask.data(), mask.size() * bits + 1) ? errno : 0;
+#else
+    int rc = ENOSYS;
+#endif
+    if (rc) {
+        std::cerr << "WARNING: could not prefer NUMA node " << node << ": " << strerror(rc) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+* \brief returns the CPUs that are online
+**/
+std::vector<int> onlineCpus()
+{
+    std::vector<int> cpus = readCpuList("/sys/devices/system/cpu/online");
+    if (cpus.empty()) {
+        for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+/**
+* \brief returns the CPUs of a NUMA node
+*
+* Machines without NUMA information are treated as a single node 0.
+*
+* \param [in] node the node number
+* \return the CPUs, empty if there is no such node
+**/
+std::vector<int> numaNodeCpus(int node)
+{
+    std::vector<int> cpus = readCpuList("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    if (cpus.empty() && node == 0 && readCpuList("/sys/devices/system/node/online").empty()) {
+        cpus = onlineCpus();
+    }
+    return cpus;
+}
+
+/**
+* \brief returns one CPU per physical core, skipping hyperthread siblings
+*
+* \param [in] node only cores on this NUMA node, or -1 for all
+* \return the lowest-numbered CPU of each core
+**/
+std::vector<int> physicalCoreCpus(int node)
+{
+    std::vector<int> cpus = node < 0 ? onlineCpus() : numaNodeCpus(node);
+    std::vector<int> cores;
+    for (int cpu : cpus) {
+        std::vector<int> siblings = readCpuList("/sys/devices/system/cpu/cpu" + std::to_string(cpu)
+                                                + "/topology/thread_siblings_list");
+        if (siblings.empty() || *std::min_element(siblings.begin(), siblings.end()) == cpu) {
+            cores.push_back(cpu);
+        }
+    }
+    return cores;
+}
+}
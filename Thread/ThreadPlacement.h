@@ -0,0 +1,41 @@
+/**
+ * \file ThreadPlacement.h
+ *
+ * \brief CPU affinity, NUMA placement, names and scheduling for worker threads
+ *
+ * The functions act on the calling thread and return false, after printing
+ * a warning, when the OS refuses or does not support the setting. On
+ * platforms other than Linux only thread names are supported.
+ **/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace atl
+{
+    /**
+    * \brief where and how the threads of a MultiThread run
+    *
+    * Empty or negative fields leave the OS defaults alone.
+    **/
+    struct ThreadPlacement
+    {
+        std::string         name;               //!< Worker i is named name + i, cut to 15 characters
+        std::vector<int>    cpus;               //!< CPUs the workers may run on
+        bool                pinEach = false;    //!< Pin worker i to cpus[i % cpus.size()] alone
+        int                 numaNode = -1;      //!< Prefer this node's memory, and its CPUs if cpus is empty
+        int                 policy = -1;        //!< SCHED_OTHER, SCHED_BATCH, SCHED_FIFO, SCHED_RR, ...
+        int                 priority = 0;       //!< Real-time priority, or nice value for the other policies
+    };
+
+    bool applyThreadPlacement(const ThreadPlacement& placement, int index);
+    bool setThreadName(const std::string& name);
+    bool setThreadAffinity(const std::vector<int>& cpus);
+    bool setThreadScheduling(int policy, int priority);
+    bool preferNumaNode(int node);
+    std::vector<int> onlineCpus();
+    std::vector<int> numaNodeCpus(int node);
+    std::vector<int> physicalCoreCpus(int node = -1);
+}
@@ -3,6 +3,29 @@
  **/
 
 #include "ThreadPool.h"
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <system_error>
+
+namespace
+{
+    /**
+     * Cheap per-thread random numbers for picking steal victims
+     */
+    uint32_t nextRandom()
+    {
+        static thread_local uint32_t state =
+            (uint32_t)std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+}
 
 namespace atl
 {
@@ -12,43 +35,910 @@ namespace atl
 *
 * \param [in] numThreads the number of threads
 * \param [in] maxJobLength the maximum number of jobs that can be submitted
-* \param [in] timeout the time a thread should process before moving on
+* \param [in] timeout deprecated and ignored; idle workers park until a
+*        job is pushed
+* \param [in] workStealing give each worker its own deque and let idle workers steal
 **/
-ThreadPool::ThreadPool(int numThreads, int maxJobLength, double timeout): MultiThread(numThreads), TSQueue<std::function<void()>>()
+ThreadPool::ThreadPool(int numThreads, int maxJobLength, double /*timeout*/, bool workStealing)
+    : MultiThread(numThreads), TSQueue<std::function<void()>>(), m_workStealing(workStealing),
+      m_scaling(false), m_minThreads(numThreads), m_maxThreads(numThreads),
+      m_growLatency(Clock::duration::zero()), m_idleRetire(Clock::duration::zero()),
+      m_lastStart(Clock::now()), m_lastGrow(Clock::now()), m_workers(0),
+      m_queued(0), m_stale(0), m_sleepers(0), m_cancelled(0), m_closed(false)
 {
     set_max_size(maxJobLength);
-    m_timeout = timeout;
+}
+
+/**
+* \brief stops the workers and deletes jobs that never ran, warning about
+*        them; call shutdown() first to drain or keep them
+**/
+ThreadPool::~ThreadPool()
+{
+    std::vector<Task> dropped = shutdown(false);
+    if (!dropped.empty()) {
+        std::cerr << "WARNING: ThreadPool destroyed with " << dropped.size() << " jobs not run" << std::endl;
+    }
+}
+
+/**
+* \brief starts the workers, first giving each worker slot a deque in
+*        work-stealing mode
+*
+* With scaling enabled the number of threads is clamped to its bounds.
+*
+* \return true if the workers were started
+**/
+bool ThreadPool::Start()
+{
+    bool running = false;
+    m_running.compare_exchange_strong(running, true);
+    if (running) {
+        std::cerr << "WARNING: Threads already running." << std::endl;
+        return false;
+    }
+
+    unsigned threads = m_numThreads;
+    if (m_scaling) {
+        threads = std::min(std::max(threads, m_minThreads.load()), m_maxThreads.load());
+    }
+    if (m_workStealing) {
+        size_t slots = std::max(threads, m_scaling ? m_maxThreads.load() : 0);
+        while (m_deques.size() < slots) {
+            m_deques.emplace_back(new WorkStealingDeque<Task*>());
+        }
+    }
+    {
+        // Join() has reaped everything retired during the last run
+        std::lock_guard<std::mutex> l(m_workerMutex);
+        m_retired.clear();
+    }
+    m_closed = false;
+    m_lastStart = Clock::now();
+    m_lastGrow = Clock::now();
+
+    for (unsigned i = 0; i < threads; i++) {
+        addWorker();
+    }
+    return true;
+}
+
+/**
+* \brief tells the workers to exit and wakes the parked ones
+**/
+void ThreadPool::Stop()
+{
+    Thread::Stop();
+    std::lock_guard<std::mutex> l(m_idleMutex);
+    m_idleCv.notify_all();
+}
+
+/**
+* \brief stops the pool and returns the jobs it did not run
+*
+* Parked workers are woken at once. When draining, the workers first run
+* the queued jobs until none are left or the deadline passes; otherwise
+* they only finish the jobs they are running. Either way this returns once
+* every worker has exited. From the start of the call until the next
+* Start(), push_job() refuses jobs from threads that are not workers of
+* this pool, while running jobs can still queue follow-up work, which is
+* returned if it does not get to run.
+*
+* Must not be called from a worker of this pool.
+*
+* \param [in] drain run the queued jobs first
+* \param [in] deadline the most seconds to spend draining, or negative for
+*        no limit
+* \return the jobs that were not run, oldest first where the queue kept
+*         an order
+**/
+std::vector<std::function<void()>> ThreadPool::shutdown(bool drain, double deadline)
+{
+    if (detail::t_worker.owner == this) {
+        std::cerr << "WARNING: ThreadPool cannot be shut down from its own worker" << std::endl;
+        return std::vector<Task>();
+    }
+    m_closed = true;
+
+    if (drain && isRunning()) {
+        Timer t;
+        while (size()) {
+            double ms = 60000;
+            if (deadline >= 0) {
+                ms = std::min(ms, (deadline - t.elapsed()) * 1e3);
+                if (ms <= 0) {
+                    break;
+                }
+            }
+            wait_until_empty((uint16_t)std::max(ms, 1.0));
+        }
+    }
+
+    Stop();
+    Join();
+    return takeAll();
+}
+
+/**
+* \brief lets the pool add and retire workers while it runs
+*
+* A worker is added when a job waited longer than growLatency to start, or
+* when a job is pushed while every worker is busy and none has started a
+* job for that long; at most one is added per growLatency. A worker parked
+* for idleRetire exits. Running pools are topped up to minThreads at once.
+* In work-stealing mode workers beyond the thread count given at Start()
+* need their deques, so raising maxThreads past it takes effect on the
+* next Start().
+*
+* \param [in] minThreads the fewest workers to keep, at least 1
+* \param [in] maxThreads the most workers to run
+* \param [in] growLatency seconds a job may wait before a worker is added
+* \param [in] idleRetire seconds a worker may stay parked before it exits
+**/
+void ThreadPool::setScaling(unsigned minThreads, unsigned maxThreads, double growLatency, double idleRetire)
+{
+    maxThreads = std::max(maxThreads, 1u);
+    m_minThreads = std::min(std::max(minThreads, 1u), maxThreads);
+    m_maxThreads = maxThreads;
+    m_growLatency = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(growLatency));
+    m_idleRetire = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(idleRetire));
+    m_scaling = true;
+
+    if (isRunning()) {
+        while (m_workers.load() < m_minThreads.load() && addWorker()) {
+        }
+        // Parked workers pick up the new idle period
+        std::lock_guard<std::mutex> l(m_idleMutex);
+        m_idleCv.notify_all();
+    }
+}
+
+/**
+* \brief returns the number of workers currently running
+**/
+unsigned ThreadPool::getNumWorkers()
+{
+    return m_workers.load();
+}
+
+/**
+* \brief one worker per physical core, each pinned to its core
+*
+* Sets the thread count and the placement for the next Start(). With a
+* node the workers use that NUMA node's cores and prefer its memory.
+* Workers are named "atlpool<i>" unless a name was already set.
+*
+* \param [in] node the NUMA node, or -1 for every core of the machine
+* \return false if no cores were found, leaving the pool unchanged
+**/
+bool ThreadPool::pinToPhysicalCores(int node)
+{
+    std::vector<int> cores = physicalCoreCpus(node);
+    if (cores.empty()) {
+        std::cerr << "WARNING: no cores found on NUMA node " << node << std::endl;
+        return false;
+    }
+
+    ThreadPlacement placement = getPlacement();
+    placement.cpus = cores;
+    placement.pinEach = true;
+    placement.numaNode = node;
+    if (placement.name.empty()) {
+        placement.name = "atlpool";
+    }
+    setPlacement(placement);
+    setNumThreads((unsigned)cores.size());
+    return true;
 }
 
 /**
 * \brief adds jobs to the pool
 *
+* In work-stealing mode a job pushed by one of this pool's workers goes on
+* that worker's deque and is never refused.
+*
 * \param [in] f the job to be added
 * \return true if the job has been successfully enqueued
 **/
 bool ThreadPool::push_job(std::function<void()> f)
 {
-    return enqueue(f);
+    if (isClosed()) {
+        return false;
+    }
+    if (m_scaling) {
+        Clock::time_point now = Clock::now();
+        // Every worker busy with long jobs while others queue up
+        if (m_sleepers.load() == 0 && hasWork() && now - m_lastStart.load() > m_growLatency.load()) {
+            grow(now);
+        }
+        TimedTask timed = {this, std::move(f), now};
+        f = std::move(timed);
+    }
+
+    if (!m_workStealing) {
+        if (!enqueue(std::move(f))) {
+            return false;
+        }
+    } else {
+        // Counted before it becomes visible so m_queued never underflows
+        m_queued++;
+        int self = workerIndex();
+        if (self >= 0) {
+            m_deques[self]->push(new Task(std::move(f)));
+        } else if (!enqueue(std::move(f))) {
+            taken();
+            return false;
+        }
+    }
+
+    // Pairs with idle(): either the sleeper sees the job or this sees it
+    if (m_sleepers.load()) {
+        std::lock_guard<std::mutex> l(m_idleMutex);
+        m_idleCv.notify_one();
+    }
+    return true;
+}
+
+/**
+* \brief tells whether shutdown() refuses jobs pushed from this thread
+*
+* Lets callers tell a closed pool from a full queue when push_job() fails.
+* Workers of the pool may still push while it drains.
+*
+* \return true if push_job() from the calling thread would be refused
+**/
+bool ThreadPool::isClosed()
+{
+    return m_closed && detail::t_worker.owner != this;
+}
+
+/**
+* \brief adds a job that is dropped instead of run if its token is
+*        cancelled before a worker takes it
+*
+* The job can also poll its own copy of the token while it runs.
+*
+* \param [in] f the job to be added
+* \param [in] token the job's token
+* \return true if the job has been enqueued or was already cancelled
+**/
+bool ThreadPool::push_job(std::function<void()> f, CancelToken token)
+{
+    if (!token.cancellable()) {
+        return push_job(std::move(f));
+    }
+    if (token.cancelled()) {
+        m_cancelled++;
+        return true;
+    }
+    CancellableTask task = {this, std::move(f), token};
+    return push_job(std::move(task));
 }
 
 /**
-* \brief main function to loop through the queue and run jobs
+* \brief runs one queued job on the calling thread, if there is one
+*
+* A worker of this pool takes from its own deque first. Used by threads
+* that would otherwise block waiting on the pool.
+*
+* \return true if a job was run
 **/
-void ThreadPool::mainLoop()
+bool ThreadPool::run_pending_job()
 {
-    std::function<void()> f;
-    if (dequeue(f, m_timeout) && f) {
+    Task f;
+    if (!findTask(workerIndex(), f)) {
+        return false;
+    }
+    if (f) {
         f();
     }
+    return true;
+}
+
+/**
+* \brief the shared state of one run_partitions() call
+**/
+struct ThreadPool::Partitions {
+    ThreadPool*                     pool;
+    std::function<size_t(size_t)>   f;
+    size_t                          parts;
+    std::atomic<size_t>             next;       //!< Next partition to take
+    std::atomic<size_t>             total;
+    size_t                          remaining;  //!< Partitions not yet finished
+    size_t                          unstarted;  //!< Helpers still queued
+    bool                            returned;   //!< The call has returned; queued helpers are stale
+    std::exception_ptr              error;
+    std::mutex                      mutex;
+    std::condition_variable         cv;
+
+    /**
+    * \brief runs partitions until every one has been taken
+    **/
+    void work()
+    {
+        for (size_t i = next++; i < parts; i = next++) {
+            std::exception_ptr e;
+            try {
+                total += f(i);
+            } catch (...) {
+                e = std::current_exception();
+            }
+            std::lock_guard<std::mutex> l(mutex);
+            if (e && !error) {
+                error = e;
+            }
+            if (--remaining == 0) {
+                cv.notify_all();
+            }
+        }
+    }
+
+    /**
+    * \brief notes that a helper has left the queue
+    *
+    * \return false if the helper is stale
+    **/
+    bool dequeued()
+    {
+        std::lock_guard<std::mutex> l(mutex);
+        if (returned) {
+            pool->m_stale--;
+            return false;
+        }
+        unstarted--;
+        return true;
+    }
+};
+
+/**
+* \brief takes partitions unless the call it helps has returned
+**/
+void ThreadPool::PartitionHelper::operator()()
+{
+    if (run->dequeued()) {
+        run->work();
+    }
+}
+
+/**
+* \brief finds the run_partitions() helper in a queued job
+*
+* \param [in] task the job
+* \return the helper, or nullptr if the job is not one
+**/
+ThreadPool::PartitionHelper* ThreadPool::partitionHelper(Task& task)
+{
+    if (TimedTask* timed = task.target<TimedTask>()) {
+        return timed->f.target<PartitionHelper>();
+    }
+    return task.target<PartitionHelper>();
+}
+
+/**
+* \brief Runs f(0) .. f(parts-1) across the pool and sums the results
+*
+* At most one helper job per worker is pushed; the helpers and the calling
+* thread take partitions from a shared counter. The calling thread does not
+* just block, so this cannot deadlock when called from a worker of this
+* pool or when the job queue is full. Helpers still queued when the call
+* returns do nothing and are not counted by size(), getStats() or
+* shutdown().
+*
+* If f throws, the remaining partitions still run and the first exception
+* is rethrown once every partition has finished, so f never outlives the
+* call.
+*
+* \param [in] parts the number of partitions
+* \param [in] f the work for one partition, returning a count
+* \return the sum of the values returned by f
+**/
+size_t ThreadPool::run_partitions(size_t parts, std::function<size_t(size_t)> f)
+{
+    auto state = std::make_shared<Partitions>();
+    state->pool = this;
+    state->f = f;
+    state->parts = parts;
+    state->next = 0;
+    state->total = 0;
+    state->remaining = parts;
+    state->unstarted = 0;
+    state->returned = false;
+
+    size_t helpers = parts ? std::min<size_t>(parts - 1, getNumWorkers()) : 0;
+    for (size_t i = 0; i < helpers; i++) {
+        {
+            std::lock_guard<std::mutex> l(state->mutex);
+            state->unstarted++;
+        }
+        if (!push_job(PartitionHelper{state})) {
+            std::lock_guard<std::mutex> l(state->mutex);
+            state->unstarted--;
+            break;
+        }
+    }
+    state->work();
+
+    std::unique_lock<std::mutex> l(state->mutex);
+    state->cv.wait(l, [&state] { return state->remaining == 0; });
+    state->returned = true;
+    m_stale += state->unstarted;
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+    return state->total;
+}
+
+/**
+* \brief runs jobs on a worker thread until the pool stops or the worker
+*        retires
+*
+* \param [in] index the worker's slot
+**/
+void ThreadPool::workerMain(int index)
+{
+    bindWorker(index);
+    applyPlacement(index);
+
+    WorkerCounters* counters;
+    {
+        std::lock_guard<std::mutex> l(m_workerMutex);
+        counters = m_counters[index].get();
+    }
+
+    // Counters are only written here, so plain loads and stores will do
+    auto add = [](std::atomic<int64_t>& counter, Clock::duration d) {
+        counter.store(counter.load(std::memory_order_relaxed)
+                      + std::chrono::duration_cast<std::chrono::nanoseconds>(d).count(),
+                      std::memory_order_relaxed);
+    };
+    double cpuStart = getThreadCpuTime();
+    int64_t cpuBase = counters->cpuNs.load(std::memory_order_relaxed);
+    auto sampleCpu = [&]() {
+        counters->cpuNs.store(cpuBase + (int64_t)((getThreadCpuTime() - cpuStart) * 1e9),
+                              std::memory_order_relaxed);
+    };
+
+    Task f;
+    bool retired = false;
+    Clock::time_point idleSince = Clock::now();
+    Clock::time_point cpuSampled = idleSince;
+    while (isRunning()) {
+        if (findTask(index, f)) {
+            if (f) {
+                Clock::time_point start = Clock::now();
+                f();
+                Clock::time_point end = Clock::now();
+                add(counters->busyNs, end - start);
+                int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+                if (ns > counters->longestNs.load(std::memory_order_relaxed)) {
+                    counters->longestNs.store(ns, std::memory_order_relaxed);
+                }
+                counters->jobs.store(counters->jobs.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                if (end - cpuSampled > std::chrono::milliseconds(10)) {
+                    sampleCpu();
+                    cpuSampled = end;
+                }
+            }
+            f = nullptr;
+            idleSince = Clock::now();
+        } else {
+            sampleCpu();
+            Clock::time_point parked = Clock::now();
+            bool stay = idle(idleSince);
+            cpuSampled = Clock::now();
+            add(counters->idleNs, cpuSampled - parked);
+            if (!stay) {
+                retired = true;
+                break;
+            }
+        }
+    }
+    sampleCpu();
+
+    std::lock_guard<std::mutex> l(m_workerMutex);
+    m_slots[index] = false;
+    if (retired) {
+        m_retired.push_back(std::this_thread::get_id());
+    } else {
+        m_workers--;
+    }
+}
+
+/**
+* \brief starts a worker in the lowest free slot and joins workers that
+*        retired since the last call
+*
+* \return false if the pool is stopped or out of slots or threads
+**/
+bool ThreadPool::addWorker()
+{
+    std::vector<std::thread> retired;
+    std::thread thread;
+    {
+        std::lock_guard<std::mutex> l(m_workerMutex);
+        size_t index = std::find(m_slots.begin(), m_slots.end(), false) - m_slots.begin();
+        if (m_workStealing && index >= m_deques.size()) {
+            return false;
+        }
+        if (!isRunning()) {
+            return false;
+        }
+
+        // Created outside m_threadMutex: it is a spinlock, and Join() would
+        // spin for the whole system call
+        try {
+            thread = std::thread(&ThreadPool::workerMain, this, (int)index);
+        } catch (const std::system_error& e) {
+            std::cerr << "WARNING: ThreadPool could not add a worker: " << e.what() << std::endl;
+            return false;
+        }
+        if (index == m_slots.size()) {
+            m_slots.push_back(true);
+            m_counters.emplace_back(new WorkerCounters());
+        } else {
+            m_slots[index] = true;
+        }
+        m_workers++;
+
+        // Published under the lock Join() takes, so a new thread is never missed
+        std::lock_guard<AtlSpinLock> t(m_threadMutex);
+        if (isRunning()) {
+            for (auto it = m_threads.begin(); it != m_threads.end();) {
+                if (std::find(m_retired.begin(), m_retired.end(), it->get_id()) != m_retired.end()) {
+                    retired.push_back(std::move(*it));
+                    it = m_threads.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            m_retired.clear();
+            m_threads.push_back(std::move(thread));
+        }
+    }
+
+    // The pool stopped before the thread was published; it exits at once
+    if (thread.joinable()) {
+        thread.join();
+        return false;
+    }
+
+    // They have left their loop; wait for them to return
+    for (auto& t : retired) {
+        t.join();
+    }
+    return true;
+}
+
+/**
+* \brief notes that a timed job is starting, adding a worker if it waited
+*        too long
+*
+* \param [in] pushed when the job was pushed
+**/
+void ThreadPool::started(Clock::time_point pushed)
+{
+    Clock::time_point now = Clock::now();
+    m_lastStart = now;
+    if (now - pushed > m_growLatency.load()) {
+        grow(now);
+    }
+}
+
+/**
+* \brief adds a worker unless one was added within the latency threshold
+*        or the pool is at its maximum
+*
+* \param [in] now the current time
+**/
+void ThreadPool::grow(Clock::time_point now)
+{
+    Clock::time_point last = m_lastGrow.load();
+    if (now - last < m_growLatency.load() || m_workers.load() >= m_maxThreads.load()) {
+        return;
+    }
+    if (m_lastGrow.compare_exchange_strong(last, now)) {
+        addWorker();
+    }
+}
+
+/**
+* \brief gives up the calling worker's place unless that would leave fewer
+*        than the minimum
+*
+* \return true if the worker should exit
+**/
+bool ThreadPool::retire()
+{
+    unsigned workers = m_workers.load();
+    while (workers > m_minThreads.load()) {
+        if (m_workers.compare_exchange_weak(workers, workers - 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+* \brief returns true if a job is waiting to be taken
+**/
+bool ThreadPool::hasWork()
+{
+    return m_workStealing ? m_queued.load() != 0 : TSQueue<Task>::size() != 0;
+}
+
+/**
+* \brief returns the calling thread's index in this pool
+*
+* \return the index of the worker's deque, or -1 if the caller is not a
+*         work-stealing worker of this pool
+**/
+int ThreadPool::workerIndex()
+{
+    const detail::WorkerSlot& worker = detail::t_worker;
+    if (worker.owner != this || worker.index < 0 || (size_t)worker.index >= m_deques.size()) {
+        return -1;
+    }
+    return worker.index;
+}
+
+/**
+* \brief takes the next job for a worker: its own newest job, else the
+*        oldest injected job, else the oldest job of another worker; in
+*        shared-queue mode, the oldest queued job
+*
+* \param [in] self the worker's index, or -1
+* \param [out] task the job
+* \return true if a job was taken
+**/
+bool ThreadPool::findTask(int self, Task& task)
+{
+    if (!m_workStealing) {
+        return TSQueue<Task>::size() && dequeue(task, 0);
+    }
+
+    Task* p;
+    if (self >= 0 && m_deques[self]->pop(p)) {
+        task = std::move(*p);
+        delete p;
+        taken();
+        return true;
+    }
+
+    if (TSQueue<Task>::size() && dequeue(task, 0)) {
+        taken();
+        return true;
+    }
+
+    size_t n = m_deques.size();
+    size_t start = nextRandom();
+    for (size_t i = 0; i < n; i++) {
+        size_t victim = (start + i) % n;
+        if ((int)victim != self && m_deques[victim]->steal(p)) {
+            task = std::move(*p);
+            delete p;
+            taken();
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+* \brief accounts for a job leaving the queues, waking wait_until_empty()
+*        callers when none are left
+**/
+void ThreadPool::taken()
+{
+    if (--m_queued == 0) {
+        std::lock_guard<std::mutex> l(m_idleMutex);
+        m_emptyCv.notify_all();
+    }
+}
+
+/**
+* \brief parks the worker until a job is pushed or the pool stops
+*
+* With scaling enabled a worker parked since idleSince for the idle period
+* retires, unless the pool is at its minimum.
+*
+* \param [in] idleSince when the worker last finished a job
+* \return false if the worker should exit
+**/
+bool ThreadPool::idle(Clock::time_point idleSince)
+{
+    std::unique_lock<std::mutex> l(m_idleMutex);
+    m_sleepers++;
+    bool retiring = false;
+    if (!hasWork() && isRunning()) {
+        if (!m_scaling) {
+            m_idleCv.wait(l);
+        } else if (m_idleCv.wait_until(l, idleSince + m_idleRetire.load()) == std::cv_status::timeout
+                   && !hasWork()) {
+            retiring = retire();
+        }
+    }
+    m_sleepers--;
+    return !retiring;
+}
+
+/**
+* \brief returns the number of jobs that have not been started
+*
+* \return the number of queued jobs
+**/
+size_t ThreadPool::size()
+{
+    size_t queued = m_workStealing ? m_queued.load() : TSQueue<Task>::size();
+    size_t stale = m_stale.load();
+    return queued > stale ? queued - stale : 0;
+}
+
+/**
+* \brief deletes all jobs that have not been started
+**/
+void ThreadPool::delete_all()
+{
+    takeAll();
+}
+
+/**
+* \brief removes every job that has not been started
+*
+* run_partitions() helpers are dropped rather than handed back; their
+* call runs every partition itself.
+*
+* \return the jobs, injected ones before those on worker deques
+**/
+std::vector<ThreadPool::Task> ThreadPool::takeAll()
+{
+    std::vector<Task> jobs;
+    auto keep = [&jobs](Task& task) {
+        if (PartitionHelper* helper = partitionHelper(task)) {
+            helper->run->dequeued();
+        } else {
+            jobs.push_back(std::move(task));
+        }
+    };
+
+    Task task;
+    while (dequeue(task, 0)) {
+        keep(task);
+        if (m_workStealing) {
+            taken();
+        }
+    }
+    for (auto& deque : m_deques) {
+        Task* p;
+        while (deque->steal(p)) {
+            keep(*p);
+            delete p;
+            taken();
+        }
+    }
+    return jobs;
+}
+
+/**
+* \brief waits until every queued job has been taken by a worker; jobs may
+*        still be running when this returns
+*
+* \param [in] timeout the maximum number of milliseconds to wait, 0 waits indefinitely
+* \return true if the queues emptied, false on timeout
+**/
+bool ThreadPool::wait_until_empty(uint16_t timeout)
+{
+    if (!m_workStealing) {
+        return TSQueue<Task>::wait_until_empty(timeout);
+    }
+
+    std::unique_lock<std::mutex> l(m_idleMutex);
+    auto empty = [this] { return m_queued.load() == 0; };
+    if (!timeout) {
+        m_emptyCv.wait(l, empty);
+        return true;
+    }
+    return m_emptyCv.wait_for(l, std::chrono::milliseconds(timeout), empty);
+}
+
+/**
+* \brief returns a process-wide work-stealing pool, started on first use
+*
+* It has one worker fewer than there are hardware threads (at least one),
+* since threads that wait on it run jobs too. It is never destroyed, so it
+* stays usable from static destructors.
+*
+* \return the shared pool
+**/
+ThreadPool& ThreadPool::shared_pool()
+{
+    static ThreadPool* pool = [] {
+        unsigned threads = std::thread::hardware_concurrency();
+        ThreadPool* p = new ThreadPool(threads > 1 ? threads - 1 : 1, 1000, 100, true);
+        p->Start();
+        return p;
+    }();
+    return *pool;
+}
+
+/**
+* \brief returns true if the pool was created in work-stealing mode
+**/
+bool ThreadPool::isWorkStealing()
+{
+    return m_workStealing;
+}
+
+/**
+* \brief returns the pool's worker count, queue length, cancelled jobs and
+*        what each worker slot has done
+*
+* Taking the snapshot only reads counters, so it does not slow the workers.
+**/
+ThreadPoolStats ThreadPool::getStats()
+{
+    ThreadPoolStats stats;
+    stats.workers = getNumWorkers();
+    stats.queued = size();
+    stats.cancelled = m_cancelled.load();
+
+    std::lock_guard<std::mutex> l(m_workerMutex);
+    for (size_t i = 0; i < m_counters.size(); i++) {
+        const WorkerCounters& c = *m_counters[i];
+        WorkerStats w;
+        w.index = (int)i;
+        w.running = m_slots[i];
+        w.jobs = c.jobs.load(std::memory_order_relaxed);
+        w.busy = c.busyNs.load(std::memory_order_relaxed) / 1e9;
+        w.idle = c.idleNs.load(std::memory_order_relaxed) / 1e9;
+        w.cpu = c.cpuNs.load(std::memory_order_relaxed) / 1e9;
+        w.longestJob = c.longestNs.load(std::memory_order_relaxed) / 1e9;
+        stats.perWorker.push_back(w);
+    }
+    return stats;
+}
+
+/**
+* \brief returns getStats() as JSON
+*
+* Each worker also gets its utilization, the share of its busy and idle
+* time spent in jobs; a worker whose cpu time is far below its busy time
+* spent its jobs blocked.
+*
+* \return JsonBox value with the pool's counts and a "perWorker" array
+**/
+JsonBox::Value ThreadPool::report()
+{
+    ThreadPoolStats stats = getStats();
+
+    JsonBox::Array workers;
+    for (auto& w : stats.perWorker) {
+        JsonBox::Value worker;
+        worker["index"] = w.index;
+        worker["running"] = w.running;
+        worker["jobs"] = (double)w.jobs;
+        worker["busy"] = w.busy;
+        worker["idle"] = w.idle;
+        worker["cpu"] = w.cpu;
+        worker["longestJob"] = w.longestJob;
+        worker["utilization"] = w.busy + w.idle > 0 ? w.busy / (w.busy + w.idle) : 0.0;
+        workers.push_back(worker);
+    }
+
+    JsonBox::Value result;
+    result["workers"] = (int)stats.workers;
+    result["queued"] = (double)stats.queued;
+    result["cancelled"] = (double)stats.cancelled;
+    result["perWorker"] = workers;
+    return result;
 }
 
 /**
-* \brief sets the timeout value
+* \brief does nothing; kept so existing callers still build
 *
-* \param [in] timeout the timeout value to be set
+* \deprecated Workers park until a job is pushed instead of polling, so
+*             there is no timeout to set.
 **/
-void ThreadPool::setTimeout(double timeout)
+void ThreadPool::setTimeout(double /*timeout*/)
 {
-    m_timeout = timeout;
 }
 }
@@ -7,9 +7,20 @@
 
 #include "MultiThread.h"
 #include "TSQueue.tcc"
+#include "WorkStealingDeque.tcc"
+#include "CancelToken.h"
 
 #include <functional>
 #include <atomic>
+#include <chrono>
+#include <future>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include "ThreadPool.h"
 #include <thread>
 #include "Timer.h"
@@ -19,28 +30,285 @@
 
 namespace atl
 {
+    namespace detail
+    {
+        template<size_t... I> struct Indices {};
+        template<size_t N, size_t... I> struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {};
+        template<size_t... I> struct MakeIndices<0, I...> { typedef Indices<I...> type; };
+
+        /**
+        * \brief a callable and its arguments, invoked once with the
+        *        arguments moved in, so move-only arguments work
+        **/
+        template<typename F, typename... Args> class BoundCall
+        {
+        public:
+            typedef decltype(std::declval<F&>()(std::declval<Args>()...)) result_type;
+
+            template<typename G, typename... A>
+            explicit BoundCall(G&& f, A&&... args)
+                : m_f(std::forward<G>(f)), m_args(std::forward<A>(args)...) {}
+
+            result_type operator()()
+            {
+                return call(typename MakeIndices<sizeof...(Args)>::type());
+            }
+
+        private:
+            template<size_t... I> result_type call(Indices<I...>)
+            {
+                return m_f(std::move(std::get<I>(m_args))...);
+            }
+
+            F                   m_f;
+            std::tuple<Args...> m_args;
+        };
+    }
+
+    /**
+    * \brief what one worker slot of a pool has done since the pool was
+    *        created, over every thread that ran in the slot
+    **/
+    struct WorkerStats {
+        int         index;      //!< The worker's slot
+        bool        running;    //!< A worker is in the slot now
+        uint64_t    jobs;       //!< Jobs run
+        double      busy;       //!< Seconds spent in jobs
+        double      idle;       //!< Seconds parked waiting for jobs
+        double      cpu;        //!< CPU seconds, sampled when the worker parks and every 10ms of jobs
+        double      longestJob; //!< Seconds taken by the longest job
+    };
+
+    /**
+    * \brief a snapshot of a pool's state
+    **/
+    struct ThreadPoolStats {
+        unsigned    workers;    //!< Live workers
+        size_t      queued;     //!< Jobs not yet started
+        uint64_t    cancelled;  //!< Jobs dropped because their token was cancelled
+        std::vector<WorkerStats> perWorker;
+    };
 
     /**
     * \brief class to run thread pool
+    *
+    * By default every worker takes jobs from one shared queue. In
+    * work-stealing mode each worker also owns a Chase-Lev deque: jobs
+    * pushed from inside a worker go onto its own deque and are run newest
+    * first, jobs pushed from other threads go onto the shared queue (the
+    * injector), and a worker with nothing local takes from the injector or
+    * steals the oldest job of another worker. The maximum job length only
+    * limits the injector, so a running job can always spawn more work.
+    *
+    * Idle workers park on a condition variable until a job is pushed or
+    * the pool stops. With setScaling() the pool also resizes itself while
+    * running: a worker is added when a job waited longer than the latency
+    * threshold to start, and a worker that stayed parked for the idle period
+    * exits, within the given bounds.
+    *
+    * A job pushed with a CancelToken is dropped instead of run if the token
+    * is cancelled or past its deadline by the time a worker takes it.
+    *
+    * Each worker keeps its own counts and times, which getStats() and
+    * report() gather, so a pool can be sized by how busy its workers are.
+    * Jobs run by other threads through wait() or run_pending_job() are not
+    * counted.
+    *
+    * shutdown() stops the pool either after its queue drains or at once,
+    * and hands back the jobs it did not run instead of dropping them.
     **/
     class ThreadPool: public MultiThread, private TSQueue<std::function<void()>>
     {
     public:
-        ThreadPool(int numThreads = 1, int maxJobLength = 50, double timeout = 1);
+        ThreadPool(int numThreads = 1, int maxJobLength = 50, double timeout = 1, bool workStealing = false);
+        virtual ~ThreadPool();
 
+        virtual bool Start();
+        virtual void Stop();
+        std::vector<std::function<void()>> shutdown(bool drain = true, double deadline = -1);
+        void setScaling(unsigned minThreads, unsigned maxThreads, double growLatency = 0.01, double idleRetire = 5);
+        unsigned getNumWorkers();
+        bool pinToPhysicalCores(int node = -1);
         bool push_job(std::function<void()> f);
+        bool push_job(std::function<void()> f, CancelToken token);
+        template<typename F, typename... Args>
+        auto submit(F&& f, Args&&... args)
+            -> std::future<typename detail::BoundCall<typename std::decay<F>::type,
+                                                      typename std::decay<Args>::type...>::result_type>;
+        template<typename Future> void wait(const Future& f);
+        bool run_pending_job();
+        bool isClosed();
+
+        static ThreadPool& shared_pool();
+        size_t run_partitions(size_t parts, std::function<size_t(size_t)> f);
         void setTimeout(double timeout);
+        bool isWorkStealing();
+        ThreadPoolStats getStats();
+        JsonBox::Value report();
 
-        using TSQueue<std::function<void()>>::size;
-        using TSQueue<std::function<void()>>::delete_all;
+        size_t size();
+        void delete_all();
+        bool wait_until_empty(uint16_t timeout = 0);
         using TSQueue<std::function<void()>>::set_max_size;
         using TSQueue<std::function<void()>>::get_max_size;
-        using TSQueue<std::function<void()>>::wait_until_empty;
 
     private:
-        std::atomic<double> m_timeout;                  //!< Timeout value of the thread pool
-        virtual void mainLoop();
+        typedef std::function<void()> Task;
+        typedef std::chrono::steady_clock Clock;
+
+        /**
+        * \brief a job stamped with its push time, so starting it measures
+        *        how long it waited
+        **/
+        struct TimedTask {
+            ThreadPool*         pool;
+            Task                f;
+            Clock::time_point   pushed;
+
+            void operator()() { pool->started(pushed); f(); }
+        };
+
+        /**
+        * \brief a job that is dropped if its token is cancelled before it
+        *        starts
+        **/
+        struct CancellableTask {
+            ThreadPool*         pool;
+            Task                f;
+            CancelToken         token;
+
+            void operator()()
+            {
+                if (token.cancelled()) {
+                    pool->m_cancelled++;
+                    return;
+                }
+                f();
+            }
+        };
+
+        struct Partitions;
+
+        /**
+        * \brief a job that helps run_partitions() take partitions; one still
+        *        queued after the call returned is stale and does nothing
+        **/
+        struct PartitionHelper {
+            std::shared_ptr<Partitions> run;
+
+            void operator()();
+        };
+
+        /**
+        * \brief one worker slot's counters, written only by the worker in
+        *        the slot
+        **/
+        struct WorkerCounters {
+            std::atomic<uint64_t>   jobs;
+            std::atomic<int64_t>    busyNs;
+            std::atomic<int64_t>    idleNs;
+            std::atomic<int64_t>    cpuNs;
+            std::atomic<int64_t>    longestNs;
+            char                    pad[64];    //!< Keeps other slots' counters off this cache line
+
+            WorkerCounters() : jobs(0), busyNs(0), idleNs(0), cpuNs(0), longestNs(0) {}
+        };
+
+        void workerMain(int index);
+        bool addWorker();
+        void started(Clock::time_point pushed);
+        void grow(Clock::time_point now);
+        bool retire();
+        bool hasWork();
+        int workerIndex();
+        bool findTask(int self, Task& task);
+        void taken();
+        std::vector<Task> takeAll();
+        static PartitionHelper* partitionHelper(Task& task);
+        bool idle(Clock::time_point idleSince);
+
+        const bool m_workStealing;                      //!< Workers have their own deques
+        std::vector<std::unique_ptr<WorkStealingDeque<Task*>>> m_deques; //!< One per worker slot; only grows while stopped
+        std::atomic_bool m_scaling;                     //!< setScaling() was called
+        std::atomic<unsigned> m_minThreads;             //!< Fewest workers left by retiring
+        std::atomic<unsigned> m_maxThreads;             //!< Most workers added by growing
+        std::atomic<Clock::duration> m_growLatency;     //!< Start delay that adds a worker
+        std::atomic<Clock::duration> m_idleRetire;      //!< Parked time that retires a worker
+        std::atomic<Clock::time_point> m_lastStart;     //!< When a worker last started a timed job
+        std::atomic<Clock::time_point> m_lastGrow;      //!< When a worker was last added
+        std::atomic<unsigned> m_workers;                //!< Live workers
+        std::mutex m_workerMutex;                       //!< Guards m_slots, m_counters and m_retired
+        std::vector<bool> m_slots;                      //!< Worker indices in use
+        std::vector<std::unique_ptr<WorkerCounters>> m_counters; //!< One per worker slot
+        std::vector<std::thread::id> m_retired;         //!< Retired workers not yet joined
+        std::atomic<size_t> m_queued;                   //!< Jobs pushed but not yet taken (work-stealing mode)
+        std::atomic<size_t> m_stale;                    //!< Queued run_partitions() helpers whose call has returned
+        std::atomic<unsigned> m_sleepers;               //!< Workers waiting in idle()
+        std::mutex m_idleMutex;                         //!< Guards idle waits and empty waits
+        std::condition_variable m_idleCv;               //!< Signaled when work arrives
+        std::condition_variable m_emptyCv;              //!< Signaled when m_queued reaches 0
+        std::atomic<uint64_t> m_cancelled;              //!< Jobs dropped for a cancelled token
+        std::atomic_bool m_closed;                      //!< shutdown() refuses jobs from other threads
     };
+
+    /**
+    * \brief runs f(args...) on the pool and returns a future for its result
+    *
+    * The callable and arguments are moved into the job and the arguments
+    * are moved into the call, so move-only types can be passed. If the job
+    * queue is full the calling thread runs the job itself before returning,
+    * so a submission is never lost. Exceptions reach the future.
+    *
+    * Once shutdown() has closed the pool the job is not run at all, and the
+    * future throws std::future_error with broken_promise.
+    *
+    * \param [in] f the callable
+    * \param [in] args arguments for f
+    * \return a future that becomes ready when the job has run
+    **/
+    template<typename F, typename... Args>
+    auto ThreadPool::submit(F&& f, Args&&... args)
+        -> std::future<typename detail::BoundCall<typename std::decay<F>::type,
+                                                  typename std::decay<Args>::type...>::result_type>
+    {
+        typedef detail::BoundCall<typename std::decay<F>::type,
+                                  typename std::decay<Args>::type...> Call;
+        typedef typename Call::result_type R;
+
+        // std::function needs a copyable target; the shared task is one
+        auto task = std::make_shared<std::packaged_task<R()>>(
+                Call(std::forward<F>(f), std::forward<Args>(args)...));
+        std::future<R> result = task->get_future();
+        if (!push_job([task] { (*task)(); }) && !isClosed()) {
+            (*task)();
+        }
+        return result;
+    }
+
+    /**
+    * \brief waits for a future, running queued jobs on this thread meanwhile
+    *
+    * Safe to call from a worker of this pool, which would otherwise tie up
+    * the worker (or deadlock a one-thread pool) waiting on jobs behind it.
+    *
+    * \param [in] f a std::future or std::shared_future
+    **/
+    template<typename Future> void ThreadPool::wait(const Future& f)
+    {
+        for (;;) {
+            std::future_status status = f.wait_for(std::chrono::seconds(0));
+            if (status == std::future_status::ready) {
+                return;
+            }
+            if (status == std::future_status::deferred) {
+                f.wait();
+                return;
+            }
+            if (!run_pending_job()) {
+                f.wait_for(std::chrono::microseconds(200));
+            }
+        }
+    }
 }
 
 #endif /* THREADPOOL_H_ */
@@ -9,6 +9,15 @@
  *****************************************************************************/
 
 #include "ThreadWorker.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif //_WIN32
 
 namespace atl {
 
@@ -21,17 +30,229 @@ ThreadWorker::~ThreadWorker()
 {
     Stop();
     Join();
+#ifndef _WIN32
+    for (int fd : m_wakePipe) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+#endif //_WIN32
 }
 
 void ThreadWorker::setMainLoopFunction(std::function<void()> f)
 {
-    std::lock_guard<std::mutex> l(m_mainLoopMutex);
+    std::lock_guard<AtlAdaptiveMutex> l(m_mainLoopMutex);
     m_mainLoopFunction = f;
 }
 
+/**
+ * \brief switches between calling the function back to back and calling it
+ * only when woken
+ *
+ * \param [in] eventDriven true to wait for wakeups
+ **/
+void ThreadWorker::setEventDriven(bool eventDriven)
+{
+    std::lock_guard<std::mutex> l(m_eventMutex);
+    m_eventDriven = eventDriven;
+    wake();
+}
+
+/**
+ * \brief makes an event-driven worker call its function once more
+ **/
+void ThreadWorker::notify()
+{
+    std::lock_guard<std::mutex> l(m_eventMutex);
+    m_notified = true;
+    wake();
+}
+
+/**
+ * \brief makes an event-driven worker call its function after a delay,
+ * unless an earlier deadline is already set
+ *
+ * \param [in] seconds the delay
+ **/
+void ThreadWorker::notifyAfter(double seconds)
+{
+    Clock::time_point deadline = Clock::now()
+        + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    std::lock_guard<std::mutex> l(m_eventMutex);
+    m_deadline = std::min(m_deadline, deadline);
+    wake();
+}
+
+/**
+ * \brief makes an event-driven worker call its function at a fixed rate
+ *
+ * Runs that fall behind are dropped rather than made up in a burst.
+ *
+ * \param [in] seconds the period, or 0 to stop timed runs, including one
+ * set by notifyAfter()
+ **/
+void ThreadWorker::setPeriod(double seconds)
+{
+    std::lock_guard<std::mutex> l(m_eventMutex);
+    m_period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    m_deadline = m_period > Clock::duration::zero() ? Clock::now() + m_period : Clock::time_point::max();
+    wake();
+}
+
+/**
+ * \brief wakes an event-driven worker when a file descriptor is readable
+ *
+ * The function must read what is available, or it will be called again
+ * right away. Not supported on Windows.
+ *
+ * \param [in] fd the descriptor, for example a socket
+ * \return true if the descriptor is watched
+ **/
+bool ThreadWorker::watchFd(int fd)
+{
+#ifndef _WIN32
+    std::lock_guard<std::mutex> l(m_eventMutex);
+    if (m_wakePipe[0] < 0) {
+        if (pipe(m_wakePipe)) {
+            std::cerr << "WARNING: ThreadWorker could not create its wake pipe" << std::endl;
+            return false;
+        }
+        for (int end : m_wakePipe) {
+            fcntl(end, F_SETFL, fcntl(end, F_GETFL) | O_NONBLOCK);
+        }
+    }
+    if (std::find(m_fds.begin(), m_fds.end(), fd) == m_fds.end()) {
+        m_fds.push_back(fd);
+    }
+    wake();
+    return true;
+#else
+    std::cerr << "WARNING: ThreadWorker cannot watch file descriptors on this platform" << std::endl;
+    return false;
+#endif //_WIN32
+}
+
+/**
+ * \brief stops watching a file descriptor
+ *
+ * \param [in] fd a descriptor passed to watchFd()
+ **/
+void ThreadWorker::unwatchFd(int fd)
+{
+    std::lock_guard<std::mutex> l(m_eventMutex);
+    m_fds.erase(std::remove(m_fds.begin(), m_fds.end(), fd), m_fds.end());
+    wake();
+}
+
+/**
+ * \brief stops the worker, waking it if it is waiting for an event
+ **/
+void ThreadWorker::Stop()
+{
+    Thread::Stop();
+    std::lock_guard<std::mutex> l(m_eventMutex);
+    wake();
+}
+
+/**
+ * \brief interrupts waitForEvent(); m_eventMutex must be held
+ **/
+void ThreadWorker::wake()
+{
+    m_eventCv.notify_one();
+#ifndef _WIN32
+    if (m_wakePipe[1] >= 0) {
+        // A full pipe already has a wakeup pending, so errors don't matter
+        char byte = 0;
+        ssize_t rc = write(m_wakePipe[1], &byte, 1);
+        (void)rc;
+    }
+#endif //_WIN32
+}
+
+/**
+ * \brief blocks until the event-driven worker has something to do
+ *
+ * \return true if the function should run
+ **/
+bool ThreadWorker::waitForEvent()
+{
+    std::unique_lock<std::mutex> l(m_eventMutex);
+    while (isRunning() && m_eventDriven) {
+        if (m_notified) {
+            m_notified = false;
+            return true;
+        }
+
+        Clock::time_point now = Clock::now();
+        if (m_deadline <= now) {
+            if (m_period > Clock::duration::zero()) {
+                m_deadline = std::max(m_deadline + m_period, now);
+            } else {
+                m_deadline = Clock::time_point::max();
+            }
+            return true;
+        }
+
+        if (!m_fds.empty()) {
+            if (pollFds(l)) {
+                return true;
+            }
+        } else if (m_deadline == Clock::time_point::max()) {
+            m_eventCv.wait(l);
+        } else {
+            m_eventCv.wait_until(l, m_deadline);
+        }
+    }
+    return isRunning();
+}
+
+/**
+ * \brief waits for a watched descriptor, a wakeup or the deadline
+ *
+ * \param [in] l the held lock on m_eventMutex, released while waiting
+ * \return true if a watched descriptor is readable
+ **/
+bool ThreadWorker::pollFds(std::unique_lock<std::mutex>& l)
+{
+#ifndef _WIN32
+    std::vector<pollfd> fds(1 + m_fds.size());
+    fds[0].fd = m_wakePipe[0];
+    fds[0].events = POLLIN;
+    for (size_t i = 0; i < m_fds.size(); i++) {
+        fds[i + 1].fd = m_fds[i];
+        fds[i + 1].events = POLLIN;
+    }
+    int timeout = -1;
+    if (m_deadline != Clock::time_point::max()) {
+        std::chrono::duration<double, std::milli> left = m_deadline - Clock::now();
+        timeout = (int)std::max(0.0, std::ceil(left.count()));
+    }
+
+    l.unlock();
+    int ready = poll(fds.data(), fds.size(), timeout);
+    char buffer[64];
+    if (ready > 0 && fds[0].revents) {
+        while (read(m_wakePipe[0], buffer, sizeof(buffer)) > 0) {
+        }
+    }
+    l.lock();
+
+    for (size_t i = 1; ready > 0 && i < fds.size(); i++) {
+        if (fds[i].revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL)) {
+            return true;
+        }
+    }
+#endif //_WIN32
+    return false;
+}
+
 void ThreadWorker::mainLoop()
 {
-    std::lock_guard<std::mutex> l(m_mainLoopMutex);
+    if (m_eventDriven && !waitForEvent()) {
+        return;
+    }
+    std::lock_guard<AtlAdaptiveMutex> l(m_mainLoopMutex);
     if (m_mainLoopFunction) {
         m_mainLoopFunction();
     }
@@ -9,12 +9,28 @@
  *****************************************************************************/
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <functional>
 #include <mutex>
+#include <vector>
 #include "Thread.h"
+#include "AtlMutexWrap.h"
+#include "TSQueue.tcc"
 
 namespace atl {
 
+/**
+ * \brief runs a function over and over on its own thread
+ *
+ * By default the function is called back to back while the worker runs.
+ * In event-driven mode the worker sleeps until something wakes it and then
+ * calls the function once: a notify() call, data added to a watched
+ * TSQueue, a deadline from notifyAfter() or setPeriod(), or a watched file
+ * descriptor becoming readable. Wakeups that arrive while the function runs
+ * are coalesced into one more call.
+ **/
 class ThreadWorker : private Thread
 {
     public: 
@@ -22,16 +38,65 @@ class ThreadWorker : private Thread
         ~ThreadWorker();
         void setMainLoopFunction(std::function<void()> f=nullptr);
 
+        void setEventDriven(bool eventDriven);
+        void notify();
+        void notifyAfter(double seconds);
+        void setPeriod(double seconds);
+        template<typename T> void watch(TSQueue<T>& queue);
+        template<typename T> void unwatch(TSQueue<T>& queue);
+        bool watchFd(int fd);
+        void unwatchFd(int fd);
+
         using Thread::Start;
-        using Thread::Stop;
+        void Stop();
         using Thread::Join;
         using Thread::isRunning;
 
     private:
+        typedef std::chrono::steady_clock Clock;
+
         void mainLoop();
+        bool waitForEvent();
+        bool pollFds(std::unique_lock<std::mutex>& l);
+        void wake();
 
-        std::mutex m_mainLoopMutex;
+        AtlAdaptiveMutex m_mainLoopMutex;
         std::function<void()> m_mainLoopFunction = nullptr;
+
+        std::mutex m_eventMutex;                        //!< Guards the event state below
+        std::condition_variable m_eventCv;              //!< Wakes a worker waiting without fds
+        std::atomic_bool m_eventDriven{false};          //!< Run only when woken
+        bool m_notified = false;                        //!< notify() called since the last run
+        Clock::time_point m_deadline = Clock::time_point::max(); //!< Next timed run
+        Clock::duration m_period = Clock::duration::zero();     //!< Time between timed runs, 0 for none
+        std::vector<int> m_fds;                         //!< Watched file descriptors
+        int m_wakePipe[2] = {-1, -1};                   //!< Interrupts poll() when fds are watched
 };
 
+/**
+ * \brief wakes the worker whenever data is added to a queue
+ *
+ * Replaces any enqueue callback the queue had. Call unwatch() before the
+ * worker is destroyed if the queue lives longer.
+ *
+ * \param [in] queue the queue the worker's function consumes
+ **/
+template<typename T> void ThreadWorker::watch(TSQueue<T>& queue)
+{
+    queue.set_enqueue_callback([this] { notify(); });
+    if (queue.size()) {
+        notify();
+    }
+}
+
+/**
+ * \brief stops waking the worker for a queue
+ *
+ * \param [in] queue a queue passed to watch()
+ **/
+template<typename T> void ThreadWorker::unwatch(TSQueue<T>& queue)
+{
+    queue.set_enqueue_callback(nullptr);
+}
+
 } //end namespace atl
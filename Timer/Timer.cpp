@@ -333,6 +333,30 @@ double getTime()
     return (double)getUsecTime() / (double)1e6;
 }
 
+/**
+ * Gets the CPU time used by the calling thread
+ *
+ * @return seconds of CPU time, or 0 if the platform cannot tell
+ */
+double getThreadCpuTime()
+{
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user)) {
+        return 0;
+    }
+    uint64_t k = ((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+    uint64_t u = ((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime;
+    return (k + u) / 1e7;
+#else
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        return 0;
+    }
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
 /**
  * Gets the number of microseconds since the epoch
  *
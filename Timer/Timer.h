@@ -97,6 +97,7 @@ public:
 
 //Support functions
 double      getTime();
+double      getThreadCpuTime();
 uint64_t    getUsecTime();
 uint64_t    getTimestamp();
 timeval     convertUsecTimeToTimeval(uint64_t t);
@@ -0,0 +1,107 @@
+/**
+ * \file ParallelBenchmark.cpp
+ *
+ * \brief Scaling of parallel_for, parallel_reduce, parallel_transform and
+ *        parallel_sort from 1 to N threads
+ *
+ * Usage: ./benchmarkParallel [maxThreads] [numElements]
+ *        (default hardware_concurrency threads, 10000000 elements)
+ **/
+
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Parallel.tcc"
+#include "Timer.h"
+
+using namespace atl;
+
+int main(int argc, char* argv[])
+{
+    unsigned maxThreads = argc > 1 ? atoi(argv[1]) : std::thread::hardware_concurrency();
+    size_t n = argc > 2 ? strtoull(argv[2], nullptr, 10) : 10000000;
+    if (maxThreads == 0) {
+        maxThreads = 1;
+    }
+
+    std::vector<double> input(n);
+    std::mt19937_64 gen(42);
+    std::uniform_real_distribution<double> dist(0, 1000);
+    for (auto& v : input) {
+        v = dist(gen);
+    }
+    std::vector<double> output(n);
+
+    std::cout << n << " elements; times in ms, speedup against 1 thread" << std::endl;
+    std::cout << "threads      for       reduce    transform        sort" << std::endl;
+
+    double base[4] = {0, 0, 0, 0};
+    for (unsigned threads = 1; threads <= maxThreads; threads++) {
+        // The calling thread works too, so it counts as one of the threads
+        ThreadPool pool(threads > 1 ? threads - 1 : 1, 1000, 1, true);
+        pool.Start();
+        double t[4];
+        Timer timer;
+
+        if (threads == 1) {
+            for (size_t i = 0; i < n; i++) {
+                output[i] = std::sqrt(input[i]) * std::log1p(input[i]);
+            }
+        } else {
+            parallel_for(pool, (size_t)0, n, [&](size_t i) {
+                output[i] = std::sqrt(input[i]) * std::log1p(input[i]);
+            });
+        }
+        t[0] = timer.elapsed();
+
+        timer.start();
+        auto reduce = [](std::vector<double>::const_iterator b, std::vector<double>::const_iterator e,
+                         double init) {
+            for (; b != e; ++b) {
+                init += std::sin(*b);
+            }
+            return init;
+        };
+        double sum = threads == 1 ? reduce(input.cbegin(), input.cend(), 0.0)
+            : parallel_reduce(pool, input.cbegin(), input.cend(), 0.0, reduce,
+                              [](double a, double b) { return a + b; });
+        t[1] = timer.elapsed();
+
+        timer.start();
+        auto transform = [](double v) { return std::exp(-v / 1000) * v; };
+        if (threads == 1) {
+            std::transform(input.begin(), input.end(), output.begin(), transform);
+        } else {
+            parallel_transform(pool, input.begin(), input.end(), output.begin(), transform);
+        }
+        t[2] = timer.elapsed();
+
+        output = input;
+        timer.start();
+        if (threads == 1) {
+            std::sort(output.begin(), output.end());
+        } else {
+            parallel_sort(pool, output.begin(), output.end());
+        }
+        t[3] = timer.elapsed();
+
+        pool.Stop();
+        pool.Join();
+
+        std::cout << std::setw(7) << threads << std::fixed;
+        for (int k = 0; k < 4; k++) {
+            if (threads == 1) {
+                base[k] = t[k];
+            }
+            std::cout << std::setprecision(1) << std::setw(8) << t[k] * 1e3
+                      << std::setprecision(2) << " " << std::setw(4) << base[k] / t[k] << "x";
+        }
+        std::cout << "  (" << (int64_t)sum % 2 << ")" << std::endl;
+    }
+    return 0;
+}
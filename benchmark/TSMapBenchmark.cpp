@@ -0,0 +1,100 @@
+/**
+ * \file TSMapBenchmark.cpp
+ *
+ * \brief Compares the std::map and B+tree TSMap backends
+ *
+ * Usage: ./benchmarkTSMap [numKeys ...]   (default 1000 1000000 10000000)
+ **/
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "TSMap.tcc"
+#include "Timer.h"
+
+using namespace atl;
+
+/**
+ * \brief Times inserts, lookups and a full ordered scan on one map type
+ *
+ * \param [in] name Label printed with the results
+ * \param [in] keys Keys to insert, in random order
+ * \param [in] probes Keys to look up
+ **/
+template<typename MapType>
+void runBenchmark(const std::string& name, const std::vector<uint64_t>& keys,
+                  const std::vector<uint64_t>& probes)
+{
+    MapType map;
+    Timer t;
+
+    for (auto k : keys) {
+        map.emplace(k, k);
+    }
+    double insertTime = t.elapsed();
+
+    t.start();
+    size_t hits = 0;
+    for (auto k : probes) {
+        hits += map.find(k).second;
+    }
+    double findTime = t.elapsed();
+
+    t.start();
+    for (auto k : probes) {
+        hits += map.lower_bound(k).second;
+    }
+    double lowerTime = t.elapsed();
+
+    t.start();
+    for (auto k : probes) {
+        hits += map.findInfimum(k).second;
+    }
+    double infTime = t.elapsed();
+
+    t.start();
+    uint64_t sum = 0;
+    map.for_each_ro([&](uint64_t k, const uint64_t& v)->bool { sum += v; return true; });
+    double scanTime = t.elapsed();
+
+    double ns = 1e9 / probes.size();
+    std::cout << std::setw(8) << name
+              << std::fixed << std::setprecision(1)
+              << "  insert " << std::setw(7) << insertTime * 1e9 / keys.size() << " ns"
+              << "  find " << std::setw(7) << findTime * ns << " ns"
+              << "  lower_bound " << std::setw(7) << lowerTime * ns << " ns"
+              << "  findInfimum " << std::setw(7) << infTime * ns << " ns"
+              << "  for_each " << std::setw(6) << scanTime * 1e9 / keys.size() << " ns/key"
+              << "  (" << hits + sum % 2 << ")" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; i++) {
+        sizes.push_back(strtoull(argv[i], nullptr, 10));
+    }
+    if (sizes.empty()) {
+        sizes = {1000, 1000000, 10000000};
+    }
+
+    std::mt19937_64 gen(42);
+    for (size_t n : sizes) {
+        std::vector<uint64_t> keys(n);
+        for (auto& k : keys) {
+            k = getUsecTime() + gen() % (n * 16);
+        }
+        std::vector<uint64_t> probes(1000000);
+        for (auto& p : probes) {
+            p = keys[gen() % n] + gen() % 3;
+        }
+
+        std::cout << n << " keys:" << std::endl;
+        runBenchmark<TSMap<uint64_t, uint64_t>>("std::map", keys, probes);
+        runBenchmark<BTreeTSMap<uint64_t, uint64_t>>("B+tree", keys, probes);
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+/**
+ * \file ThreadPoolBenchmark.cpp
+ *
+ * \brief Compares task throughput of the shared-queue and work-stealing
+ *        ThreadPool modes
+ *
+ * Usage: ./benchmarkThreadPool [numThreads] [numTasks]
+ *        (default hardware_concurrency threads, 200000 tasks)
+ **/
+
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "ThreadPool.h"
+#include "Timer.h"
+
+using namespace atl;
+
+/**
+ * \brief Small job with a little arithmetic so the queue dominates
+ **/
+static void work(std::atomic<uint64_t>& sink, uint64_t seed)
+{
+    uint64_t x = seed;
+    for (int i = 0; i < 64; i++) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    }
+    sink.fetch_add(x & 1, std::memory_order_relaxed);
+}
+
+/**
+ * \brief Pushes every task from the calling thread
+ **/
+static double flat(ThreadPool& pool, size_t tasks, std::atomic<uint64_t>& sink)
+{
+    Timer t;
+    for (size_t i = 0; i < tasks; i++) {
+        while (!pool.push_job([&sink, i] { work(sink, i); })) {
+            std::this_thread::yield();
+        }
+    }
+    pool.wait_until_empty();
+    return t.elapsed();
+}
+
+/**
+ * \brief Splits a range recursively inside the pool, the way divide and
+ *        conquer code spawns work
+ **/
+static double nested(ThreadPool& pool, size_t tasks, std::atomic<uint64_t>& sink)
+{
+    std::atomic<size_t> done(0);
+    std::function<void(size_t, size_t)> split = [&](size_t begin, size_t end) {
+        while (end - begin > 1) {
+            size_t mid = begin + (end - begin) / 2;
+            // A full shared queue cannot be waited on from a worker
+            if (!pool.push_job([&split, mid, end] { split(mid, end); })) {
+                split(mid, end);
+            }
+            end = mid;
+        }
+        work(sink, begin);
+        done++;
+    };
+
+    Timer t;
+    pool.push_job([&split, tasks] { split(0, tasks); });
+    while (done < tasks) {
+        std::this_thread::yield();
+    }
+    return t.elapsed();
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned threads = argc > 1 ? atoi(argv[1]) : std::thread::hardware_concurrency();
+    size_t tasks = argc > 2 ? strtoull(argv[2], nullptr, 10) : 200000;
+    if (threads == 0) {
+        threads = 1;
+    }
+
+    std::cout << threads << " threads, " << tasks << " tasks" << std::endl;
+    for (int stealing = 0; stealing < 2; stealing++) {
+        ThreadPool pool(threads, 1000, 1, stealing);
+        std::atomic<uint64_t> sink(0);
+        pool.Start();
+        double flatTime = flat(pool, tasks, sink);
+        double nestedTime = nested(pool, tasks, sink);
+        pool.Stop();
+        pool.Join();
+
+        std::cout << std::setw(14) << (stealing ? "work stealing" : "shared queue")
+                  << std::fixed << std::setprecision(0)
+                  << "  external " << std::setw(9) << tasks / flatTime << " tasks/s"
+                  << "  nested " << std::setw(9) << tasks / nestedTime << " tasks/s"
+                  << "  (" << sink % 2 << ")" << std::endl;
+    }
+    return 0;
+}
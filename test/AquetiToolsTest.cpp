@@ -104,6 +104,60 @@ JsonBox::Value testAquetiTools(bool testSubmodules, bool printFlag, bool assertF
                 std::cout << "ThreadPool failed to pass!" << std::endl;
                 pass = pass && false;
             } 
+        } else if (!it->compare("Parallel")) {
+            std::cout << "Testing Parallel..." <<std::endl;
+            jsonValue = atl::testParallel(printFlag, assertFlag, valgrind);
+            jsonUnits["Parallel"] = jsonValue;
+            jsonReturn["units"] = jsonUnits;
+
+            if (jsonValue["pass"].getBoolean()) {
+                std::cout << "Parallel passed successfully!" << std::endl;
+                pass = pass && true;
+            } else {
+                std::cout << "Parallel failed to pass!" << std::endl;
+                pass = pass && false;
+            } 
+        } else if (!it->compare("Scheduler")) {
+            std::cout << "Testing Scheduler..." <<std::endl;
+            jsonValue = atl::testScheduler(printFlag, assertFlag);
+            jsonUnits["Scheduler"] = jsonValue;
+            jsonReturn["units"] = jsonUnits;
+
+            if (jsonValue["pass"].getBoolean()) {
+                std::cout << "Scheduler passed successfully!" << std::endl;
+                pass = pass && true;
+            } else {
+                std::cout << "Scheduler failed to pass!" << std::endl;
+                pass = pass && false;
+            } 
+        } else if (!it->compare("Pipeline")) {
+            std::cout << "Testing Pipeline..." <<std::endl;
+            jsonValue = atl::testPipeline(printFlag, assertFlag);
+            jsonUnits["Pipeline"] = jsonValue;
+            jsonReturn["units"] = jsonUnits;
+
+            if (jsonValue["pass"].getBoolean()) {
+                std::cout << "Pipeline passed successfully!" << std::endl;
+                pass = pass && true;
+            } else {
+                std::cout << "Pipeline failed to pass!" << std::endl;
+                pass = pass && false;
+            } 
+#ifdef USE_COROUTINES
+        } else if (!it->compare("Coroutine")) {
+            std::cout << "Testing Coroutine..." <<std::endl;
+            jsonValue = atl::testCoroutine(printFlag, assertFlag);
+            jsonUnits["Coroutine"] = jsonValue;
+            jsonReturn["units"] = jsonUnits;
+
+            if (jsonValue["pass"].getBoolean()) {
+                std::cout << "Coroutine passed successfully!" << std::endl;
+                pass = pass && true;
+            } else {
+                std::cout << "Coroutine failed to pass!" << std::endl;
+                pass = pass && false;
+            } 
+#endif
         } else if (!it->compare("LruCache")) {
             int threads = 100;
             std::cout << "Testing LruCache with " << threads << " threads..." << std::endl;
@@ -119,6 +173,48 @@ JsonBox::Value testAquetiTools(bool testSubmodules, bool printFlag, bool assertF
                 pass = pass && false;
             } 
         } 
+        else if(!it->compare("SharedMutex")) {
+            std::cout << "Testing SharedMutex" <<std::endl;
+            jsonValue = atl::testSharedMutex(printFlag, assertFlag, valgrind);
+            jsonUnits["SharedMutex"] = jsonValue;
+            jsonReturn["units"] = jsonUnits;
+            if(jsonValue["pass"].getBoolean()) {
+                std::cout << "SharedMutex passed successfully!" << std::endl;
+                pass = pass && true;
+            }
+            else{
+                std::cout << "SharedMutex failed to pass!" << std::endl;
+                pass = pass && false;
+            }
+        }
+        else if(!it->compare("LockProfiler")) {
+            std::cout << "Testing LockProfiler" <<std::endl;
+            jsonValue = atl::testLockProfiler(printFlag, assertFlag);
+            jsonUnits["LockProfiler"] = jsonValue;
+            jsonReturn["units"] = jsonUnits;
+            if(jsonValue["pass"].getBoolean()) {
+                std::cout << "LockProfiler passed successfully!" << std::endl;
+                pass = pass && true;
+            }
+            else{
+                std::cout << "LockProfiler failed to pass!" << std::endl;
+                pass = pass && false;
+            }
+        }
+        else if(!it->compare("SpinLock")) {
+            std::cout << "Testing SpinLock" <<std::endl;
+            jsonValue = atl::testSpinLock(printFlag, assertFlag, valgrind);
+            jsonUnits["SpinLock"] = jsonValue;
+            jsonReturn["units"] = jsonUnits;
+            if(jsonValue["pass"].getBoolean()) {
+                std::cout << "SpinLock passed successfully!" << std::endl;
+                pass = pass && true;
+            }
+            else{
+                std::cout << "SpinLock failed to pass!" << std::endl;
+                pass = pass && false;
+            }
+        }
         else if(!it->compare("TSMap")) {
             std::cout << "Testing TSMap" <<std::endl;
             jsonValue = atl::testTSMap(printFlag, assertFlag, valgrind);
@@ -133,6 +229,34 @@ JsonBox::Value testAquetiTools(bool testSubmodules, bool printFlag, bool assertF
                 pass = pass && false;
             }
         } 
+        else if(!it->compare("BTreeMap")) {
+            std::cout << "Testing BTreeMap" <<std::endl;
+            jsonValue = atl::testBTreeMap(printFlag, assertFlag, valgrind);
+            jsonUnits["BTreeMap"] = jsonValue;
+            jsonReturn["units"] = jsonUnits;
+            if(jsonValue["pass"].getBoolean()) {
+                std::cout << "BTreeMap passed successfully!" << std::endl;
+                pass = pass && true;
+            }
+            else{
+                std::cout << "BTreeMap failed to pass!" << std::endl;
+                pass = pass && false;
+            }
+        }
+        else if(!it->compare("StripedTSMap")) {
+            std::cout << "Testing StripedTSMap" <<std::endl;
+            jsonValue = atl::testStripedTSMap(printFlag, assertFlag, valgrind);
+            jsonUnits["StripedTSMap"] = jsonValue;
+            jsonReturn["units"] = jsonUnits;
+            if(jsonValue["pass"].getBoolean()) {
+                std::cout << "StripedTSMap passed successfully!" << std::endl;
+                pass = pass && true;
+            }
+            else{
+                std::cout << "StripedTSMap failed to pass!" << std::endl;
+                pass = pass && false;
+            }
+        }
         else if (!it->compare("TSQueue")) {
             std::cout << "Testing TSQueue..." <<std::endl;
             jsonValue = atl::testTSQueue();
@@ -12,6 +12,8 @@
 #include <ThreadPool.h>
 #include <LruCache.tcc>
 #include <TSMap.tcc>
+#include <BTreeMap.tcc>
+#include <StripedTSMap.tcc>
 #include <revision.h>
 #include <iostream>
 #include <fstream>
@@ -19,6 +21,8 @@
 #include <TSQueue.tcc>
 #include <FileIO.h>
 #include "ThreadPool.h"
+#include "TaskGroup.h"
+#include "TaskGraph.h"
 #include "TaskManager.tcc"
 #include <assert.h>
 #include <ctime>
@@ -43,8 +47,12 @@ JsonBox::Value testAquetiTools( bool testSubmodules = true
                               , bool printFlag = true
                               , bool assertFlag = false
                               , bool valgrind = false
-                              , std::vector<std::string> unitList = {"Timer", "Thread", "MultiThread", "ThreadPool", 
-	"LruCache", "TSMap", "TSQueue", "TaskManager", "StringTools", "FileIO"});
+                              , std::vector<std::string> unitList = {"Timer", "Thread", "MultiThread", "ThreadPool", "Parallel", "Scheduler", "Pipeline", 
+	"LruCache", "SharedMutex", "LockProfiler", "SpinLock", "TSMap", "BTreeMap", "StripedTSMap", "TSQueue", "TaskManager", "StringTools", "FileIO"
+#ifdef USE_COROUTINES
+	, "Coroutine"
+#endif
+	});
 
 /**
  * Runs the tests for Timer
@@ -78,6 +86,45 @@ JsonBox::Value testMultiThread(bool printFlag = true);
  */
 JsonBox::Value testThreadPool();
 
+/**
+ * Runs the tests for the parallel algorithms
+ *
+ * @param printFlag A boolean, if true tests print out messages to the console
+ * @param assertFlag A boolean, if true program halts on error
+ * @param valgrind A boolean, if true sets valgrind settings for unit testing
+ * @return JsonBox value of the test results
+ */
+JsonBox::Value testParallel(bool printFlag = false, bool assertFlag = false, bool valgrind = false);
+
+/**
+ * Runs the tests for Scheduler
+ *
+ * @param printFlag A boolean, if true tests print out messages to the console
+ * @param assertFlag A boolean, if true program halts on error
+ * @return JsonBox value of the test results
+ */
+JsonBox::Value testScheduler(bool printFlag = false, bool assertFlag = false);
+
+/**
+ * Runs the tests for Pipeline
+ *
+ * @param printFlag A boolean, if true tests print out messages to the console
+ * @param assertFlag A boolean, if true program halts on error
+ * @return JsonBox value of the test results
+ */
+JsonBox::Value testPipeline(bool printFlag = false, bool assertFlag = false);
+
+#ifdef USE_COROUTINES
+/**
+ * Runs the tests for coroutine tasks
+ *
+ * @param printFlag A boolean, if true tests print out messages to the console
+ * @param assertFlag A boolean, if true program halts on error
+ * @return JsonBox value of the test results
+ */
+JsonBox::Value testCoroutine(bool printFlag = false, bool assertFlag = false);
+#endif
+
 /**
  * Runs the tests for LruCache
  *
@@ -98,6 +145,35 @@ JsonBox::Value testLruCache(unsigned int numThreads = 100, bool printFlag = true
  */
 JsonBox::Value testTSQueue(unsigned int numThreads = 20, bool printFlag = true, bool assertFlag = false);
 
+/**
+ * Runs the tests for shared_mutex, big_shared_mutex and shared_lock
+ *
+ * @param printFlag A boolean, if true tests print out messages to the console
+ * @param assertFlag A boolean, if true program halts on error
+ * @param valgrind A boolean, if true sets valgrind settings for unit testing
+ * @return JsonBox value of the test results
+ */
+JsonBox::Value testSharedMutex(bool printFlag = false, bool assertFlag = false, bool valgrind = false);
+
+/**
+ * Runs the tests for LockProfiler
+ *
+ * @param printFlag A boolean, if true tests print out messages to the console
+ * @param assertFlag A boolean, if true program halts on error
+ * @return JsonBox value of the test results
+ */
+JsonBox::Value testLockProfiler(bool printFlag = false, bool assertFlag = false);
+
+/**
+ * Runs the tests for SpinLock and AdaptiveMutex
+ *
+ * @param printFlag A boolean, if true tests print out messages to the console
+ * @param assertFlag A boolean, if true program halts on error
+ * @param valgrind A boolean, if true sets valgrind settings for unit testing
+ * @return JsonBox value of the test results
+ */
+JsonBox::Value testSpinLock(bool printFlag = false, bool assertFlag = false, bool valgrind = false);
+
 /**
  * Runs the tests for TSMap
  *
@@ -108,6 +184,26 @@ JsonBox::Value testTSQueue(unsigned int numThreads = 20, bool printFlag = true,
  */
 JsonBox::Value testTSMap(bool printFlag = false, bool assertFlag = false, bool valgrind = false);
 
+/**
+ * Runs the tests for BTreeMap and the B+tree TSMap backend
+ *
+ * @param printFlag A boolean, if true tests print out messages to the console
+ * @param assertFlag A boolean, if true program halts on error
+ * @param valgrind A boolean, if true sets valgrind settings for unit testing
+ * @return JsonBox value of the test results
+ */
+JsonBox::Value testBTreeMap(bool printFlag = false, bool assertFlag = false, bool valgrind = false);
+
+/**
+ * Runs the tests for StripedTSMap
+ *
+ * @param printFlag A boolean, if true tests print out messages to the console
+ * @param assertFlag A boolean, if true program halts on error
+ * @param valgrind A boolean, if true sets valgrind settings for unit testing
+ * @return JsonBox value of the test results
+ */
+JsonBox::Value testStripedTSMap(bool printFlag = false, bool assertFlag = false, bool valgrind = false);
+
 /**
  * Runs the tests for TaskManager
  *
@@ -0,0 +1,223 @@
+/**
+ * \file BTreeMapTest.cpp
+ **/
+
+#include "AquetiToolsTest.h"
+
+using namespace atl;
+
+/**
+* Compares the contents of a BTreeMap with a std::map in both directions
+*
+* @param tree The BTreeMap under test
+* @param ref The std::map holding the expected contents
+* @return True if sizes, keys and values agree in forward and reverse order
+*/
+template<typename Tree>
+bool btree_matches(const Tree& tree, const std::map<int, int>& ref)
+{
+    if (tree.size() != ref.size()) {
+        return false;
+    }
+
+    auto rit = ref.begin();
+    for (auto it = tree.cbegin(); it != tree.cend(); ++it, ++rit) {
+        if (rit == ref.end() || it->first != rit->first || it->second != rit->second) {
+            return false;
+        }
+    }
+    if (rit != ref.end()) {
+        return false;
+    }
+
+    auto rrit = ref.rbegin();
+    for (auto it = tree.cend(); it != tree.cbegin(); ++rrit) {
+        --it;
+        if (it->first != rrit->first) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+* Applies the same random inserts, erases and lookups to a BTreeMap
+* and a std::map and checks they agree
+*
+* @param iter The number of random operations
+* @param range Keys are drawn from [0, range)
+* @return True if every operation agreed with std::map
+*/
+template<typename Tree>
+bool btree_random_ops(int iter, int range)
+{
+    Tree tree;
+    std::map<int, int> ref;
+    std::mt19937 gen(1234);
+
+    for (int i = 0; i < iter; i++) {
+        int k = gen() % range;
+        switch (gen() % 5) {
+            case 0:
+            case 1: {
+                bool a = tree.emplace(k, i).second;
+                bool b = ref.emplace(k, i).second;
+                if (a != b) return false;
+                break;
+            }
+            case 2: {
+                if (tree.erase(k) != ref.erase(k)) return false;
+                break;
+            }
+            case 3: {
+                auto a = tree.lower_bound(k);
+                auto b = ref.lower_bound(k);
+                if ((a == tree.end()) != (b == ref.end())) return false;
+                if (b != ref.end() && a->first != b->first) return false;
+                break;
+            }
+            case 4: {
+                auto a = tree.upper_bound(k);
+                auto b = ref.upper_bound(k);
+                if ((a == tree.end()) != (b == ref.end())) return false;
+                if (b != ref.end() && a->first != b->first) return false;
+                break;
+            }
+        }
+    }
+    if (!btree_matches(tree, ref)) {
+        return false;
+    }
+
+    // Iterator erasure of every other element, then drain completely
+    bool odd = false;
+    for (auto it = tree.begin(); it != tree.end(); ) {
+        if (odd) {
+            ref.erase(it->first);
+            it = tree.erase(it);
+        } else {
+            ++it;
+        }
+        odd = !odd;
+    }
+    if (!btree_matches(tree, ref)) {
+        return false;
+    }
+
+    for (auto it = tree.begin(); it != tree.end(); ) {
+        it = tree.erase(it);
+    }
+    return tree.empty() && tree.begin() == tree.end() && tree.node_count() == 1;
+}
+
+namespace atl {
+
+/**
+ * \brief unit test function for BTreeMap and the B+tree TSMap backend
+ **/
+JsonBox::Value testBTreeMap(bool printFlag, bool assertFlag, bool valgrind)
+{
+    JsonBox::Value resultString; //!< Brief JsonBox value with unit test results
+
+    if (printFlag) {
+        std::cout << "Testing BTreeMap against std::map..." << std::endl;
+    }
+
+    // Minimum fanout forces deep trees and frequent splits/merges
+    int iter = valgrind ? 2000 : 200000;
+    bool rc = btree_random_ops<BTreeMap<int, int, std::less<int>, 1>>(iter, iter / 4);
+    rc = btree_random_ops<BTreeMap<int, int>>(iter, iter / 4) && rc;
+    if (!rc) {
+        if (printFlag) {
+            std::cout << "BTreeMap disagreed with std::map" << std::endl;
+        }
+        if (assertFlag) {
+            assert(false);
+        }
+        resultString["Random operations"] = "fail";
+        resultString["pass"] = false;
+    } else {
+        resultString["Random operations"] = "pass";
+    }
+
+    if (printFlag) {
+        std::cout << "Testing TSMap with B+tree backend..." << std::endl;
+    }
+
+    BTreeTSMap<int, int> map;
+    for (int i = 0; i < 1000; i++) {
+        map.emplace(2*i, i);
+    }
+
+    rc = map.size() == 1000
+        && map.find(10).first == 5
+        && !map.find(11).second
+        && map.lower_bound(11).first == 6
+        && !map.lower_bound(2000).second
+        && map.lower_bound_key(-5).first.first == 0
+        && map.findInfimum(11).first == 5
+        && map.findInfimum(10).first == 5
+        && !map.findInfimum(-1).second
+        && map.findInfimum_key(5000).first.first == 1998
+        && map.replace(10, 50).first == 5
+        && map.find(10).first == 50
+        && map.createInPlace(1, 7)
+        && !map.createInPlace(1, 8)
+        && map.remove(1).first == 7
+        && map.try_emplace(3, 9)
+        && map.upsert(3, 1, [](int& e, const int& v) { e += v; }).first == 10
+        && map.remove(3).first == 10;
+    if (!rc) {
+        if (printFlag) {
+            std::cout << "B+tree TSMap lookup failed" << std::endl;
+        }
+        if (assertFlag) {
+            assert(false);
+        }
+        resultString["TSMap lookup"] = "fail";
+        resultString["pass"] = false;
+    } else {
+        resultString["TSMap lookup"] = "pass";
+    }
+
+    int last = -1;
+    bool ordered = true;
+    map.for_each_ro([&](int k, const int& v)->bool {
+        ordered = ordered && k > last;
+        last = k;
+        return true;
+    });
+    size_t erased = map.delete_if([](int k, int& v)->bool { return k % 4 == 0; });
+    std::vector<int> keys = map.getKeyList();
+    rc = ordered && erased == 500 && keys.size() == 500 && keys.front() == 2 && keys.back() == 1998;
+
+    // Range-partitioned purge re-finds each range after erasing
+    ThreadPool pool(3, 100);
+    pool.Start();
+    erased = map.parallel_delete_if(pool, [](int k, int& v)->bool { return k % 3 == 0; }, 5);
+    pool.Stop();
+    pool.Join();
+    rc = rc && erased == 167 && map.size() == 333 && !map.find(6).second && map.find(10).second;
+    if (!rc) {
+        if (printFlag) {
+            std::cout << "B+tree TSMap iteration failed" << std::endl;
+        }
+        if (assertFlag) {
+            assert(false);
+        }
+        resultString["TSMap iteration"] = "fail";
+        resultString["pass"] = false;
+    } else {
+        resultString["TSMap iteration"] = "pass";
+    }
+
+    if (resultString["pass"] == false) {
+        std::cout << "BTreeMap Unit Test failed!\n" << std::endl;
+        return resultString;
+    }
+
+    std::cout << "BTreeMap Unit Test passed!\n" << std::endl;
+    resultString["pass"] = true;
+    return resultString;
+}
+}
@@ -0,0 +1,165 @@
+/**
+ * \file CoroutineTest.cpp
+ **/
+
+#include "AquetiToolsTest.h"
+#include "Coroutine.h"
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace atl {
+
+task<int> square(int i)
+{
+    co_await sleep_for(0.001);
+    co_return i * i;
+}
+
+task<int> sumSquares(int n)
+{
+    int sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum += co_await square(i);
+    }
+    co_return sum;
+}
+
+task<void> failing()
+{
+    co_await sleep_for(0.001);
+    throw std::runtime_error("task failed");
+}
+
+task<int> napping(int i)
+{
+    co_await sleep_for(0.05);
+    co_return i;
+}
+
+task<int> consume(TSQueue<int>& queue, int count)
+{
+    int sum = 0;
+    for (int i = 0; i < count; i++) {
+        sum += co_await dequeue(queue);
+    }
+    co_return sum;
+}
+
+task<int> readByte(CoreSocket::SOCKET s, double timeout)
+{
+    if (!co_await readable(s, timeout)) {
+        co_return -1;
+    }
+    char c = 0;
+    if (recv(s, &c, 1, 0) != 1) {
+        co_return -2;
+    }
+    co_return c;
+}
+
+task<bool> hop(ThreadPool& other)
+{
+    co_await resume_on(other);
+    co_await sleep_for(0.001);
+    co_return detail::t_worker.owner == &other;
+}
+
+/**
+* \brief runs timer, queue and socket waits and nested tasks on a small pool
+*
+* \param [in] printFlag print what went wrong
+* \return true if every task finished with the right result
+**/
+bool doCoroutineThing(bool printFlag)
+{
+    ThreadPool pool(2, 100000);
+    ThreadPool other(1, 100);
+    pool.Start();
+    other.Start();
+
+    // Nested tasks and exceptions
+    bool rc = spawn(pool, sumSquares(10)).get() == 285;
+    try {
+        spawn(pool, failing()).get();
+        rc = false;
+    } catch (const std::runtime_error&) {
+    }
+
+    // Many sleeping tasks hold no threads: 2000 naps of 50ms on two workers
+    Timer t;
+    std::vector<std::future<int>> naps;
+    for (int i = 0; i < 2000; i++) {
+        naps.push_back(spawn(pool, napping(i)));
+    }
+    long napSum = 0;
+    for (auto& f : naps) {
+        napSum += f.get();
+    }
+    double napTime = t.elapsed();
+    rc = rc && napSum == 1999 * 2000 / 2 && napTime < 2;
+
+    // Consumers wait on a queue without blocking workers
+    TSQueue<int> queue;
+    std::vector<std::future<int>> consumers;
+    for (int i = 0; i < 4; i++) {
+        consumers.push_back(spawn(pool, consume(queue, 25)));
+    }
+    for (int i = 1; i <= 100; i++) {
+        queue.enqueue(i);
+    }
+    int queueSum = 0;
+    for (auto& f : consumers) {
+        queueSum += f.get();
+    }
+    rc = rc && queueSum == 5050 && queue.size() == 0;
+
+    // Socket readiness and timeouts
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0) {
+        std::future<int> timedOut = spawn(pool, readByte(fds[0], 0.02));
+        rc = rc && timedOut.get() == -1;
+        std::future<int> byte = spawn(pool, readByte(fds[0], 2));
+        atl::sleep(0.02);
+        char c = 42;
+        rc = rc && send(fds[1], &c, 1, 0) == 1 && byte.get() == 42;
+        close(fds[0]);
+        close(fds[1]);
+    } else {
+        rc = false;
+    }
+
+    rc = rc && spawn(pool, hop(other)).get();
+
+    pool.Stop();
+    pool.Join();
+    other.Stop();
+    other.Join();
+    if (!rc && printFlag) {
+        std::cout << "Coroutine: naps took " << napTime << "s, queue sum " << queueSum << std::endl;
+    }
+    return rc;
+}
+
+/**
+* \brief unit test function for coroutine tasks
+**/
+JsonBox::Value testCoroutine(bool printFlag, bool assertFlag)
+{
+    JsonBox::Value resultString; //!< Brief JsonBox value with unit test results
+
+    if (!doCoroutineThing(printFlag)) {
+        if (assertFlag) {
+            assert(false);
+        }
+        resultString["Tasks"] = "fail";
+        resultString["pass"] = false;
+        std::cout << "Coroutine Unit Test failed!\n" << std::endl;
+        return resultString;
+    }
+
+    resultString["Tasks"] = "pass";
+    std::cout << "Coroutine Unit Test passed!\n" << std::endl;
+    resultString["pass"] = true;
+    return resultString;
+}
+}
@@ -0,0 +1,133 @@
+/**
+ * \file LockProfilerTest.cpp
+ **/
+
+#include <cstdio>
+#include "AquetiToolsTest.h"
+#include "LockProfiler.h"
+
+using namespace atl;
+
+namespace atl {
+
+/**
+ * \brief unit test function for the LockProfiler
+ **/
+JsonBox::Value testLockProfiler(bool printFlag, bool assertFlag)
+{
+    JsonBox::Value resultString; //!< Brief JsonBox value with unit test results
+
+    if (printFlag) {
+        std::cout << "Testing LockProfiler aggregation..." << std::endl;
+    }
+
+    // Synthetic sites; the addresses only need to be distinct
+    static int quietSite;
+    static int busySite;
+    LockProfiler::reset();
+    LockProfiler::setSampleInterval(1);
+
+    for (int i = 0; i < 10; i++) {
+        LockProfiler::acquired(&quietSite, 0, false);
+    }
+    LockProfiler::acquired(&busySite, 4000, true);
+    LockProfiler::held(&busySite, 3000);
+
+    // Statistics of exited threads must survive in the report
+    std::thread worker([]() {
+        LockProfiler::acquired(&busySite, 6000, true);
+        LockProfiler::held(&busySite, 1000);
+    });
+    worker.join();
+
+    bool sampled = LockProfiler::sample() && LockProfiler::sample();
+    JsonBox::Value report = LockProfiler::report();
+    JsonBox::Array sites = report["sites"].getArray();
+
+    bool rc = sampled && sites.size() == 2;
+    if (rc) {
+        JsonBox::Value busy = sites[0];
+        JsonBox::Value quiet = sites[1];
+        rc = busy["acquisitions"].getDouble() == 2
+            && busy["contended"].getDouble() == 2
+            && busy["waitTotalUs"].getDouble() == 10
+            && busy["waitMaxUs"].getDouble() == 6
+            && busy["holdSamples"].getDouble() == 2
+            && busy["holdMeanUs"].getDouble() == 2
+            && busy["holdMaxUs"].getDouble() == 3
+            && !busy["stack"].getArray().empty()
+            && quiet["acquisitions"].getDouble() == 10
+            && quiet["contended"].getDouble() == 0;
+    }
+    if (!rc) {
+        if (printFlag) {
+            std::cout << "LockProfiler report was wrong: " << report << std::endl;
+        }
+        if (assertFlag) {
+            assert(false);
+        }
+        resultString["Aggregation"] = "fail";
+        resultString["pass"] = false;
+    } else {
+        resultString["Aggregation"] = "pass";
+    }
+
+    std::string filename = "lockProfileTest.json";
+    rc = LockProfiler::writeReport(filename);
+    std::ifstream in(filename);
+    rc = rc && in.good() && in.peek() != std::ifstream::traits_type::eof();
+    in.close();
+    remove(filename.c_str());
+
+    LockProfiler::reset();
+    rc = rc && LockProfiler::report()["sites"].getArray().empty();
+
+#ifdef USE_LOCK_PROFILE
+    // Real contention on a wrapped mutex shows up under its lock site
+    AtlMutex m;
+    std::atomic_int inside(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < 200; i++) {
+                std::lock_guard<AtlMutex> lock(m);
+                inside++;
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    JsonBox::Array live = LockProfiler::report()["sites"].getArray();
+    double acquisitions = 0;
+    for (auto& s : live) {
+        acquisitions += s["acquisitions"].getDouble();
+    }
+    rc = rc && !live.empty() && acquisitions >= 800 && live[0]["contended"].getDouble() > 0;
+#endif
+    LockProfiler::setSampleInterval(LockProfiler::DEFAULT_SAMPLE_INTERVAL);
+
+    if (!rc) {
+        if (printFlag) {
+            std::cout << "LockProfiler report output failed" << std::endl;
+        }
+        if (assertFlag) {
+            assert(false);
+        }
+        resultString["Report"] = "fail";
+        resultString["pass"] = false;
+    } else {
+        resultString["Report"] = "pass";
+    }
+
+    if (resultString["pass"] == false) {
+        std::cout << "LockProfiler Unit Test failed!\n" << std::endl;
+        return resultString;
+    }
+
+    std::cout << "LockProfiler Unit Test passed!\n" << std::endl;
+    resultString["pass"] = true;
+    return resultString;
+}
+}
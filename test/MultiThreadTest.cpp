@@ -3,8 +3,46 @@
  **/
 
 #include "AquetiToolsTest.h"
+#ifdef __linux__
+#include <sched.h>
+#endif //__linux__
 
 namespace atl {
+/**
+* \brief threads that record the name and CPU count they run with
+**/
+class PlacementProbe : public MultiThread
+{
+public:
+    PlacementProbe(int numThreads): MultiThread(numThreads), m_seen(0) {}
+
+    std::mutex                  m_mutex;    //!< Guards the records
+    std::map<int, std::string>  m_names;    //!< Thread name by id
+    std::map<int, int>          m_cpus;     //!< Allowed CPU count by id
+    std::atomic_int             m_seen;     //!< Threads that recorded
+
+private:
+    virtual void mainLoop()
+    {
+        int id = getMyId();
+        if (id != this_worker()) {
+            id = -1;
+        }
+        std::lock_guard<std::mutex> l(m_mutex);
+        if (!m_names.count(id)) {
+#ifdef __linux__
+            char name[16] = {0};
+            pthread_getname_np(pthread_self(), name, sizeof(name));
+            m_names[id] = name;
+            cpu_set_t set;
+            sched_getaffinity(0, sizeof(set), &set);
+            m_cpus[id] = CPU_COUNT(&set);
+#endif
+            m_seen++;
+        }
+    }
+};
+
 /**
 * \brief Test function
 * 
@@ -47,6 +85,37 @@ JsonBox::Value testMultiThread(bool printFlag)
         std::cout << "Joined" << std::endl;
     }
 
+    // Names and pinning of every thread
+    std::vector<int> cores = physicalCoreCpus();
+    PlacementProbe probe(3);
+    ThreadPlacement placement;
+    placement.name = "probe";
+    placement.cpus = cores;
+    placement.pinEach = true;
+    probe.setPlacement(placement);
+    probe.Start();
+    Timer wait;
+    while (probe.m_seen < 3 && wait.elapsed() < 5) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    probe.Stop();
+    rc = probe.Join() && !cores.empty() && onlineCpus().size() >= cores.size()
+        && probe.m_seen == 3 && !probe.m_names.count(-1) && this_worker() == -1;
+#ifdef __linux__
+    for (int id = 0; id < 3; id++) {
+        rc = rc && probe.m_names[id] == "probe" + std::to_string(id) && probe.m_cpus[id] == 1;
+    }
+#endif
+    if (!rc) {
+        if (printFlag) {
+            std::cout << "Threads were not named or pinned" << std::endl;
+        }
+        resultString["Placement"] = "fail";
+        resultString["pass"] = false;
+    } else {
+        resultString["Placement"] = "pass";
+    }
+
     //Vector tests (timed)
     size_t threadCount = 50;
     std::vector<Thread> threadVect(threadCount);
@@ -0,0 +1,169 @@
+/**
+ * \file ParallelTest.cpp
+ **/
+
+#include <numeric>
+#include <random>
+#include "AquetiToolsTest.h"
+#include "Parallel.tcc"
+
+namespace atl {
+
+/**
+* \brief checks the parallel algorithms against their serial results
+*
+* \param [in] pool the pool to run on
+* \param [in] n the number of elements
+* \return true if every algorithm matched
+**/
+bool doParallelThing(ThreadPool& pool, size_t n)
+{
+    // Every index visited exactly once
+    std::vector<std::atomic_int> visits(n);
+    for (auto& v : visits) {
+        v = 0;
+    }
+    parallel_for(pool, (size_t)0, n, [&visits](size_t i) { visits[i]++; });
+    bool rc = std::all_of(visits.begin(), visits.end(), [](const std::atomic_int& v) { return v == 1; });
+
+    // Pieces respect an explicit grain and cover the range
+    std::atomic<size_t> covered(0);
+    std::atomic_bool tooBig(false);
+    parallel_for_range(pool, (size_t)0, n, [&](size_t b, size_t e) {
+        covered += e - b;
+        if (e - b > 100) {
+            tooBig = true;
+        }
+    }, 100);
+    rc = rc && covered == n && !tooBig;
+
+    std::vector<uint64_t> values(n);
+    std::iota(values.begin(), values.end(), 1);
+    uint64_t sum = parallel_reduce(pool, values.begin(), values.end(), (uint64_t)0,
+            [](std::vector<uint64_t>::iterator b, std::vector<uint64_t>::iterator e, uint64_t init) {
+                return std::accumulate(b, e, init);
+            },
+            [](uint64_t a, uint64_t b) { return a + b; });
+    rc = rc && sum == (uint64_t)n * (n + 1) / 2;
+
+    // Pieces must be combined in order: concatenation is not commutative
+    std::string digits = parallel_reduce(pool, (size_t)0, std::min<size_t>(n, 2000), std::string(),
+            [](size_t b, size_t e, std::string init) {
+                for (; b < e; b++) {
+                    init += (char)('0' + b % 10);
+                }
+                return init;
+            },
+            [](std::string a, const std::string& b) { return a + b; }, 7);
+    std::string expected;
+    for (size_t i = 0; i < std::min<size_t>(n, 2000); i++) {
+        expected += (char)('0' + i % 10);
+    }
+    rc = rc && digits == expected;
+
+    std::vector<uint64_t> squares(n);
+    auto end = parallel_transform(pool, values.begin(), values.end(), squares.begin(),
+            [](uint64_t v) { return v * v; });
+    rc = rc && end == squares.end();
+    for (size_t i = 0; i < n && rc; i++) {
+        rc = squares[i] == values[i] * values[i];
+    }
+
+    // Random, many duplicates, already sorted and reversed inputs
+    std::mt19937 gen(1234);
+    std::vector<std::vector<int>> inputs(4, std::vector<int>(n));
+    for (size_t i = 0; i < n; i++) {
+        inputs[0][i] = (int)gen();
+        inputs[1][i] = (int)(gen() % 3);
+        inputs[2][i] = (int)i;
+        inputs[3][i] = (int)(n - i);
+    }
+    for (auto& input : inputs) {
+        std::vector<int> sorted = input;
+        std::sort(sorted.begin(), sorted.end());
+        parallel_sort(pool, input.begin(), input.end());
+        rc = rc && input == sorted;
+    }
+    std::vector<int> descending = inputs[0];
+    parallel_sort(pool, descending.begin(), descending.end(), std::greater<int>());
+    rc = rc && std::is_sorted(descending.begin(), descending.end(), std::greater<int>());
+
+    return rc;
+}
+
+/**
+* \brief unit test function for the parallel algorithms
+**/
+JsonBox::Value testParallel(bool printFlag, bool assertFlag, bool valgrind)
+{
+    JsonBox::Value resultString; //!< Brief JsonBox value with unit test results
+
+    size_t n = valgrind ? 20000 : 300000;
+    ThreadPool stealing(4, 100, 1, true);
+    ThreadPool shared(4, 100, 1, false);
+    stealing.Start();
+    shared.Start();
+
+    bool rc = doParallelThing(stealing, n) && doParallelThing(shared, n)
+        && doParallelThing(stealing, 5) && doParallelThing(stealing, 0);
+    if (!rc) {
+        if (printFlag) {
+            std::cout << "Parallel algorithms gave wrong results" << std::endl;
+        }
+        if (assertFlag) {
+            assert(false);
+        }
+        resultString["Algorithms"] = "fail";
+        resultString["pass"] = false;
+    } else {
+        resultString["Algorithms"] = "pass";
+    }
+
+    // Nested calls from inside pool jobs, on the shared pool, and with a
+    // failing body
+    std::atomic<size_t> total(0);
+    parallel_for(stealing, 0, 64, [&](int) {
+        parallel_for(stealing, 0, 1000, [&](int) { total++; });
+    });
+    std::vector<int> v(10000);
+    std::iota(v.rbegin(), v.rend(), 0);
+    parallel_sort(v.begin(), v.end());
+    bool threw = false;
+    try {
+        parallel_for(stealing, 0, 10000, [](int i) {
+            if (i == 7777) {
+                throw std::runtime_error("bad element");
+            }
+        });
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    rc = total == 64000 && std::is_sorted(v.begin(), v.end()) && threw;
+    if (!rc) {
+        if (printFlag) {
+            std::cout << "Nested parallel_for counted " << total << " of 64000, threw " << threw << std::endl;
+        }
+        if (assertFlag) {
+            assert(false);
+        }
+        resultString["Nesting"] = "fail";
+        resultString["pass"] = false;
+    } else {
+        resultString["Nesting"] = "pass";
+    }
+
+    stealing.Stop();
+    shared.Stop();
+    stealing.Join();
+    shared.Join();
+
+    if (resultString["pass"] == false) {
+        std::cout << "Parallel Unit Test failed!\n" << std::endl;
+        return resultString;
+    }
+
+    std::cout << "Parallel Unit Test passed!\n" << std::endl;
+    resultString["pass"] = true;
+    return resultString;
+}
+}
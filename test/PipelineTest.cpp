@@ -0,0 +1,116 @@
+/**
+ * \file PipelineTest.cpp
+ **/
+
+#include "AquetiToolsTest.h"
+#include "Pipeline.tcc"
+#include <sstream>
+
+namespace atl {
+
+/**
+* \brief runs items through a parallel stage, a slow stage and an ordered stage
+*
+* \param [in] printFlag print what went wrong
+* \return true if every item came out once, in order, without the queues
+*         growing past their limits
+**/
+bool doPipelineThing(bool printFlag)
+{
+    std::atomic<size_t> mostInFlight(0);
+    auto pipeline = atl::Pipeline<int>(4)
+        .then("square", [](int i) {
+            // Uneven work, so the parallel workers finish out of order
+            atl::sleep(0.0001 * (i % 5));
+            if (i == 13) {
+                throw std::runtime_error("unlucky");
+            }
+            return i * i;
+        }, 4, 8)
+        .then("slow", [](int i) {
+            atl::sleep(0.001);
+            return (long)i;
+        }, 1, 2)
+        .then("format", [](long i) {
+            std::ostringstream s;
+            s << i;
+            return s.str();
+        }, 2, 4, true);
+
+    const int items = 200;
+    bool rc = pipeline.Start();
+    std::thread producer([&pipeline, &mostInFlight] {
+        for (int i = 0; i < items; i++) {
+            pipeline.push(i);
+            size_t now = pipeline.size();
+            size_t most = mostInFlight;
+            while (now > most && !mostInFlight.compare_exchange_weak(most, now)) {
+            }
+        }
+    });
+
+    // The item that threw is dropped; the rest keep their order
+    std::string value;
+    int next = 0;
+    int popped = 0;
+    while (popped < items - 1 && pipeline.pop(value, 1000)) {
+        if (next == 13) {
+            next++;
+        }
+        std::ostringstream expected;
+        expected << next * next;
+        rc = rc && value == expected.str();
+        next++;
+        popped++;
+    }
+    producer.join();
+
+    // The slow stage is the bottleneck
+    std::vector<atl::StageStats> stats = pipeline.getStats();
+    rc = rc && popped == items - 1 && mostInFlight <= 8 + 2 + 4 + 4
+        && stats.size() == 3 && stats[0].items == items - 1 && stats[0].errors == 1
+        && stats[1].items == items - 1 && pipeline.bottleneck() == 1
+        && stats[1].meanLatency >= 0.001 && stats[1].utilization > 0.5 && stats[2].throughput > 0;
+
+    // A restarted pipeline starts over with fresh sequence numbers
+    pipeline.Stop();
+    pipeline.Join();
+    rc = rc && pipeline.Start() && pipeline.push(3) && pipeline.pop(value, 1000) && value == "9";
+    pipeline.Stop();
+    rc = rc && !pipeline.push(4);
+    pipeline.Join();
+
+    if (!rc && printFlag) {
+        std::cout << "Pipeline: " << popped << " items, " << mostInFlight << " in flight at most" << std::endl;
+        for (auto& s : stats) {
+            std::cout << s.name << ": " << s.items << " items, " << s.errors << " errors, "
+                      << s.throughput << "/s, latency " << s.meanLatency << " mean " << s.maxLatency
+                      << " max, utilization " << s.utilization << std::endl;
+        }
+    }
+    return rc;
+}
+
+/**
+* \brief unit test function for Pipeline
+**/
+JsonBox::Value testPipeline(bool printFlag, bool assertFlag)
+{
+    JsonBox::Value resultString; //!< Brief JsonBox value with unit test results
+
+    if (!doPipelineThing(printFlag)) {
+        if (assertFlag) {
+            assert(false);
+        }
+        resultString["Stages"] = "fail";
+        resultString["pass"] = false;
+        std::cout << "Pipeline Unit Test failed!\n" << std::endl;
+        return resultString;
+    }
+
+    resultString["Stages"] = "pass";
+    std::cout << "Pipeline Unit Test passed!\n" << std::endl;
+    resultString["pass"] = true;
+    return resultString;
+}
+}
@@ -0,0 +1,101 @@
+/**
+ * \file SchedulerTest.cpp
+ **/
+
+#include "AquetiToolsTest.h"
+#include "Scheduler.h"
+
+namespace atl {
+
+/**
+* \brief runs one-shot, periodic and cancelled tasks on a scheduler
+*
+* \param [in] pool the pool to run tasks on, or null
+* \param [in] printFlag print what went wrong
+* \return true if every task ran when and as often as it should
+**/
+bool doSchedulerThing(ThreadPool* pool, bool printFlag)
+{
+    Scheduler scheduler(pool);
+    scheduler.Start();
+    Timer t;
+
+    // One-shot tasks run once, in deadline order, not before they are due
+    std::mutex mutex;
+    std::vector<int> order;
+    std::atomic<double> firstAt(0);
+    scheduler.scheduleAfter(0.04, [&] { std::lock_guard<std::mutex> l(mutex); order.push_back(2); });
+    scheduler.scheduleAfter(0.02, [&] {
+        firstAt = t.elapsed();
+        std::lock_guard<std::mutex> l(mutex);
+        order.push_back(1);
+    });
+    Scheduler::TaskId dropped = scheduler.scheduleAfter(0.03, [&] { order.push_back(99); });
+    bool rc = scheduler.cancel(dropped) && !scheduler.cancel(dropped);
+
+    // Periodic tasks keep to their period even though each run takes time
+    std::atomic_int ticks(0);
+    Scheduler::TaskId every = scheduler.scheduleEvery(0.01, [&ticks] {
+        ticks++;
+        atl::sleep(0.004);
+    });
+
+    // Many mostly idle tasks share the one thread
+    std::atomic_int many(0);
+    for (int i = 0; i < 40; i++) {
+        scheduler.scheduleEvery(0.005, [&many] { many++; });
+    }
+    scheduler.scheduleAfter(0.001, [] { throw std::runtime_error("task failed"); });
+
+    atl::sleep(0.2);
+    scheduler.cancel(every);
+    int ticksAtCancel = ticks;
+    atl::sleep(0.03);
+    scheduler.Stop();
+    scheduler.Join();
+    if (pool) {
+        pool->wait_until_empty();
+    }
+
+    // Under load runs can be skipped, but never added
+    std::lock_guard<std::mutex> l(mutex);
+    rc = rc && order == std::vector<int>({1, 2}) && firstAt >= 0.02
+        && ticksAtCancel >= 5 && ticksAtCancel <= 21 && ticks <= ticksAtCancel + 1
+        && many >= 40 * 10 && many <= 40 * 47 && scheduler.size() == 40;
+    if (!rc && printFlag) {
+        std::cout << "Scheduler" << (pool ? " with pool" : "") << ": order " << order.size()
+                  << ", first at " << firstAt << ", " << ticksAtCancel << " ticks, "
+                  << many << " of the 40 tasks' runs" << std::endl;
+    }
+    return rc;
+}
+
+/**
+* \brief unit test function for Scheduler
+**/
+JsonBox::Value testScheduler(bool printFlag, bool assertFlag)
+{
+    JsonBox::Value resultString; //!< Brief JsonBox value with unit test results
+
+    ThreadPool pool(2, 1000);
+    pool.Start();
+    bool rc = doSchedulerThing(nullptr, printFlag) && doSchedulerThing(&pool, printFlag);
+    pool.Stop();
+    pool.Join();
+
+    if (!rc) {
+        if (assertFlag) {
+            assert(false);
+        }
+        resultString["Deadlines"] = "fail";
+        resultString["pass"] = false;
+        std::cout << "Scheduler Unit Test failed!\n" << std::endl;
+        return resultString;
+    }
+
+    resultString["Deadlines"] = "pass";
+    std::cout << "Scheduler Unit Test passed!\n" << std::endl;
+    resultString["pass"] = true;
+    return resultString;
+}
+}
@@ -0,0 +1,272 @@
+/**
+ * \file SharedMutexTest.cpp
+ **/
+
+#include "AquetiToolsTest.h"
+
+using namespace atl;
+
+/**
+* Checks that readers never observe a half-finished write
+*
+* @param numThreads Half of the threads also write
+* @param iter The number of lock operations per thread
+* @param print The boolean to determine if a message is printed out
+* @return True if no torn state was seen and no write was lost
+*/
+template<typename M>
+bool rwlock_exclusion(int numThreads, int iter, bool print)
+{
+    // Writers keep a == b; readers must never see them differ
+    M m;
+    int a = 0;
+    int b = 0;
+    std::atomic_bool torn(false);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < iter; i++) {
+                if (t % 2 == 0 && i % 8 == 0) {
+                    std::lock_guard<M> lock(m);
+                    a++;
+                    b++;
+                } else {
+                    basic_shared_lock<M> lock(m);
+                    if (a != b) {
+                        torn = true;
+                    }
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    int expected = (numThreads / 2) * ((iter + 7) / 8);
+    if (torn || a != expected || b != expected) {
+        if (print) {
+            std::cout << "Readers saw a partial write: "
+                  << a << " " << b << " of " << expected << std::endl;
+        }
+        return false;
+    }
+    return true;
+}
+
+/**
+* Checks shared_lock ownership and the try_lock variants
+*
+* @return True if every lock attempt succeeded or failed as expected
+*/
+template<typename M>
+bool rwlock_ownership()
+{
+    M m;
+    bool rc = true;
+    {
+        basic_shared_lock<M> first(m);
+        basic_shared_lock<M> second(m, std::try_to_lock);
+        basic_shared_lock<M> deferred(m, std::defer_lock);
+        rc = rc && first.owns_lock() && second.owns_lock() && !deferred.owns_lock();
+        rc = rc && !m.try_lock();
+        deferred.lock();
+        rc = rc && deferred.owns_lock();
+    }
+    rc = rc && m.try_lock();
+    {
+        basic_shared_lock<M> blocked(m, std::try_to_lock);
+        rc = rc && !blocked.owns_lock() && !m.try_lock_shared();
+    }
+    m.unlock();
+    rc = rc && m.try_lock_shared();
+    m.unlock_shared();
+    return rc;
+}
+
+/**
+* Checks that a waiting writer gets in before readers that arrive after it
+*
+* @param print The boolean to determine if a message is printed out
+* @return True if the late reader was held back until the writer finished
+*/
+template<typename M>
+bool rwlock_writer_preference(bool print)
+{
+    M m;
+    std::mutex orderMutex;
+    std::string order;
+    m.lock_shared();
+    std::thread writer([&]() {
+        std::lock_guard<M> lock(m);
+        std::lock_guard<std::mutex> l(orderMutex);
+        order += "W";
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    bool readerBlocked = !m.try_lock_shared();
+    std::thread reader([&]() {
+        basic_shared_lock<M> lock(m);
+        std::lock_guard<std::mutex> l(orderMutex);
+        order += "R";
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    m.unlock_shared();
+    writer.join();
+    reader.join();
+
+    if (!readerBlocked || order != "WR") {
+        if (print) {
+            std::cout << "Late reader was not held behind the writer: " << order << std::endl;
+        }
+        return false;
+    }
+    return true;
+}
+
+/**
+* Checks that read locks do not nest: with a writer waiting, a thread that
+* holds a read lock cannot take a second one
+*
+* A blocking lock_shared() in place of the try here would hang both this
+* thread and the writer, which waits for the first read lock.
+*
+* @param print The boolean to determine if a message is printed out
+* @return True if the nested read was refused until the writer finished
+*/
+template<typename M>
+bool rwlock_no_nested_reads(bool print)
+{
+    M m;
+    std::atomic_bool written(false);
+    m.lock_shared();
+    std::thread writer([&]() {
+        std::lock_guard<M> lock(m);
+        written = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    bool nested = m.try_lock_shared();
+    if (nested) {
+        m.unlock_shared();
+    }
+    bool writerWaited = !written;
+    m.unlock_shared();
+    writer.join();
+
+    if (nested || !writerWaited || !written) {
+        if (print) {
+            std::cout << "Nested read lock was granted past a waiting writer" << std::endl;
+        }
+        return false;
+    }
+    return true;
+}
+
+/**
+* Runs every reader/writer lock check on one lock type
+*
+* @param name Prefix for the result keys
+* @param result JsonBox value the results are added to
+* @param printFlag A boolean, if true tests print out messages to the console
+* @param assertFlag A boolean, if true program halts on error
+* @param valgrind A boolean, if true sets valgrind settings for unit testing
+*/
+template<typename M>
+void rwlock_checks(const std::string& name, JsonBox::Value& result,
+                   bool printFlag, bool assertFlag, bool valgrind)
+{
+    if (printFlag) {
+        std::cout << "Testing " << name << "..." << std::endl;
+    }
+
+    bool excl = rwlock_exclusion<M>(8, valgrind ? 1000 : 100000, printFlag);
+    bool owner = rwlock_ownership<M>();
+    bool pref = rwlock_writer_preference<M>(printFlag);
+    bool nested = rwlock_no_nested_reads<M>(printFlag);
+    if (!owner && printFlag) {
+        std::cout << name << " lock ownership was wrong" << std::endl;
+    }
+    if (assertFlag) {
+        assert(excl && owner && pref && nested);
+    }
+
+    result[name + " exclusion"] = excl ? "pass" : "fail";
+    result[name + " ownership"] = owner ? "pass" : "fail";
+    result[name + " writer preference"] = pref ? "pass" : "fail";
+    result[name + " no nested reads"] = nested ? "pass" : "fail";
+    if (!excl || !owner || !pref || !nested) {
+        result["pass"] = false;
+    }
+}
+
+namespace atl {
+
+/**
+ * \brief unit test function for shared_mutex, big_shared_mutex and shared_lock
+ **/
+JsonBox::Value testSharedMutex(bool printFlag, bool assertFlag, bool valgrind)
+{
+    JsonBox::Value resultString; //!< Brief JsonBox value with unit test results
+
+    rwlock_checks<shared_mutex>("shared_mutex", resultString, printFlag, assertFlag, valgrind);
+    rwlock_checks<big_shared_mutex>("big_shared_mutex", resultString, printFlag, assertFlag, valgrind);
+
+    if (printFlag) {
+        std::cout << "Testing TSMap with big_shared_mutex..." << std::endl;
+    }
+
+    // Readers hammer the map while a writer keeps revoking the reader bias
+    TSMap<int, int, std::map<int, int, std::function<bool(int,int)>>, big_shared_mutex> map;
+    for (int i = 0; i < 100; i++) {
+        map.emplace(i, 0);
+    }
+    std::atomic_bool done(false);
+    std::atomic_bool bad(false);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&]() {
+            while (!done) {
+                // Every write bumps all values together
+                int seen = -1;
+                map.for_each_ro([&](int k, const int& v)->bool {
+                    if (seen < 0) {
+                        seen = v;
+                    } else if (v != seen) {
+                        bad = true;
+                    }
+                    return true;
+                });
+            }
+        });
+    }
+    int numWrites = valgrind ? 50 : 2000;
+    for (int i = 0; i < numWrites; i++) {
+        map.for_each([](int k, int& v)->bool { v++; return true; });
+    }
+    done = true;
+    for (auto& t : readers) {
+        t.join();
+    }
+
+    if (bad || map.find(99).first != numWrites) {
+        if (printFlag) {
+            std::cout << "TSMap with big_shared_mutex lost or tore writes" << std::endl;
+        }
+        if (assertFlag) {
+            assert(false);
+        }
+        resultString["big_shared_mutex TSMap"] = "fail";
+        resultString["pass"] = false;
+    } else {
+        resultString["big_shared_mutex TSMap"] = "pass";
+    }
+
+    if (resultString["pass"] == false) {
+        std::cout << "SharedMutex Unit Test failed!\n" << std::endl;
+        return resultString;
+    }
+
+    std::cout << "SharedMutex Unit Test passed!\n" << std::endl;
+    resultString["pass"] = true;
+    return resultString;
+}
+}
@@ -0,0 +1,164 @@
+/**
+ * \file SpinLockTest.cpp
+ **/
+
+#include "AquetiToolsTest.h"
+#include "Timer.h"
+
+using namespace atl;
+
+/**
+* Increments a shared counter from several threads under a lock
+*
+* @param numThreads The number of threads
+* @param iter The number of increments per thread
+* @param seconds Set to the wall time the increments took
+* @return True if no increment was lost
+*/
+template<typename M>
+bool lock_exclusion(int numThreads, int iter, double& seconds)
+{
+    M m;
+    uint64_t counter = 0;
+    std::vector<std::thread> threads;
+    Timer timer;
+    for (int t = 0; t < numThreads; t++) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < iter; i++) {
+                std::lock_guard<M> lock(m);
+                counter++;
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    seconds = timer.elapsed();
+    return counter == (uint64_t)numThreads * iter;
+}
+
+/**
+* Checks try_lock against a lock held by another thread
+*
+* @return True if try_lock fails while held and succeeds once released
+*/
+template<typename M>
+bool lock_try(void)
+{
+    M m;
+    bool rc = m.try_lock();
+    bool other = true;
+    std::thread t([&]() { other = m.try_lock(); });
+    t.join();
+    m.unlock();
+    std::thread t2([&]() {
+        rc = rc && m.try_lock();
+        m.unlock();
+    });
+    t2.join();
+    return rc && !other;
+}
+
+/**
+* Runs the checks for one lock type
+*
+* @param name Section name in the results
+* @param resultString Results of the unit test
+* @param numThreads Threads contending for the lock
+* @param iter Increments per thread
+* @param printFlag Print timing and failures
+* @param assertFlag Halt on failure
+* @return True if all checks passed
+*/
+template<typename M>
+bool lock_checks(std::string name, JsonBox::Value& resultString, int numThreads, int iter,
+        bool printFlag, bool assertFlag)
+{
+    double seconds = 0;
+    bool rc = lock_exclusion<M>(numThreads, iter, seconds) && lock_try<M>();
+    if (printFlag) {
+        std::cout << name << ": " << numThreads * iter << " locks in " << seconds << "s" << std::endl;
+    }
+    if (!rc) {
+        if (printFlag) {
+            std::cout << name << " lost an update or try_lock was wrong" << std::endl;
+        }
+        if (assertFlag) {
+            assert(false);
+        }
+        resultString[name] = "fail";
+        resultString["pass"] = false;
+        return false;
+    }
+    resultString[name] = "pass";
+    return true;
+}
+
+namespace atl {
+
+/**
+ * \brief unit test function for SpinLock and AdaptiveMutex
+ **/
+JsonBox::Value testSpinLock(bool printFlag, bool assertFlag, bool valgrind)
+{
+    JsonBox::Value resultString; //!< Brief JsonBox value with unit test results
+
+    int numThreads = 4;
+    int iter = 200000;
+    if (valgrind) {
+        iter = 2000;
+    }
+
+    lock_checks<std::mutex>("std::mutex", resultString, numThreads, iter, printFlag, assertFlag);
+    lock_checks<SpinLock>("SpinLock", resultString, numThreads, iter, printFlag, assertFlag);
+    lock_checks<AdaptiveMutex>("AdaptiveMutex", resultString, numThreads, iter, printFlag, assertFlag);
+    lock_checks<AtlSpinLock>("AtlSpinLock", resultString, numThreads, iter / 10, printFlag, assertFlag);
+    lock_checks<AtlAdaptiveMutex>("AtlAdaptiveMutex", resultString, numThreads, iter / 10, printFlag, assertFlag);
+
+    // Holding the lock far longer than the spin limit must park the
+    // waiters, and the failed spins must pull the estimate down
+    AdaptiveMutex m;
+    std::atomic_int inside(0);
+    bool overlap = false;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < 20; i++) {
+                std::lock_guard<AdaptiveMutex> lock(m);
+                if (inside++ != 0) {
+                    overlap = true;
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                inside--;
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    if (printFlag) {
+        std::cout << "AdaptiveMutex spin estimate after long holds: " << m.spinEstimate() << std::endl;
+    }
+    if (overlap || m.spinEstimate() >= 100) {
+        if (printFlag) {
+            std::cout << "AdaptiveMutex failed with long critical sections" << std::endl;
+        }
+        if (assertFlag) {
+            assert(false);
+        }
+        resultString["Long holds"] = "fail";
+        resultString["pass"] = false;
+    } else {
+        resultString["Long holds"] = "pass";
+    }
+
+    if (resultString["pass"] == false) {
+        std::cout << "SpinLock Unit Test failed!\n" << std::endl;
+        return resultString;
+    }
+
+    std::cout << "SpinLock Unit Test passed!\n" << std::endl;
+    resultString["pass"] = true;
+    return resultString;
+}
+}
@@ -0,0 +1,164 @@
+/**
+ * \file StripedTSMapTest.cpp
+ **/
+
+#include "AquetiToolsTest.h"
+
+using namespace atl;
+
+/**
+* Checks ordered lookups on a striped map against a std::map reference
+*
+* @param map The striped map under test
+* @param ref The std::map with the same contents and key order
+* @param range Probe keys are drawn from [-10, range+10)
+* @return True if every lookup and the key list agree with the reference
+*/
+template<typename Striped, typename Ref>
+bool striped_matches(Striped& map, const Ref& ref, int range)
+{
+    if (map.size() != ref.size()) {
+        return false;
+    }
+
+    std::vector<int> keys = map.getKeyList();
+    if (keys.size() != ref.size() || !std::equal(keys.begin(), keys.end(), ref.begin(),
+                [](int k, const std::pair<const int, int>& p) { return k == p.first; })) {
+        return false;
+    }
+
+    for (int k = -10; k < range + 10; k++) {
+        auto lb = map.lower_bound_key(k);
+        auto rlb = ref.lower_bound(k);
+        if (lb.second != (rlb != ref.end()) || (lb.second && lb.first.first != rlb->first)) {
+            return false;
+        }
+
+        auto inf = map.findInfimum_key(k);
+        auto rub = ref.upper_bound(k);
+        bool hasInf = rub != ref.begin();
+        if (inf.second != hasInf || (hasInf && inf.first.first != std::prev(rub)->first)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+namespace atl {
+
+/**
+ * \brief unit test function for the StripedTSMap
+ **/
+JsonBox::Value testStripedTSMap(bool printFlag, bool assertFlag, bool valgrind)
+{
+    JsonBox::Value resultString; //!< Brief JsonBox value with unit test results
+
+    if (printFlag) {
+        std::cout << "Testing StripedTSMap ordered lookups..." << std::endl;
+    }
+
+    const int range = 1000;
+    StripedTSMap<int, int> byHash(8);
+    StripedTSMap<int, int> byRange(std::vector<int>{600, 200, 400, 800});
+    std::map<int, int> ref;
+
+    // Sparse keys leave some stripes empty so lookups must cross them
+    for (int i = 0; i < range; i += 7) {
+        if (i > 200 && i < 600) {
+            continue;
+        }
+        byHash.emplace(i, i);
+        byRange.emplace(i, i);
+        ref.emplace(i, i);
+    }
+
+    // Descending keys: split keys, routing and merges follow the comparator
+    typedef StripedTSMap<int, int, std::map<int, int, std::greater<int>>, big_shared_mutex> Descending;
+    Descending descHash(8);
+    Descending descRange(std::vector<int>{200, 800, 400, 600});
+    std::map<int, int, std::greater<int>> descRef(ref.begin(), ref.end());
+    for (auto& kv : ref) {
+        descHash.emplace(kv.first, kv.second);
+        descRange.emplace(kv.first, kv.second);
+    }
+
+    bool rc = byRange.stripes() == 5
+        && striped_matches(byHash, ref, range)
+        && striped_matches(byRange, ref, range)
+        && descRange.stripes() == 5
+        && striped_matches(descHash, descRef, range)
+        && striped_matches(descRange, descRef, range);
+    if (!rc) {
+        if (printFlag) {
+            std::cout << "Striped lookups disagreed with std::map" << std::endl;
+        }
+        if (assertFlag) {
+            assert(false);
+        }
+        resultString["Ordered lookup"] = "fail";
+        resultString["pass"] = false;
+    } else {
+        resultString["Ordered lookup"] = "pass";
+    }
+
+    if (printFlag) {
+        std::cout << "Testing StripedTSMap concurrent writes..." << std::endl;
+    }
+
+    const int numWriters = 8;
+    const int numKeys = valgrind ? 200 : 10000;
+    StripedTSMap<int, int> counters(16);
+    std::vector<std::thread> writers;
+
+    // Keys [0, numKeys) are shared counters; each writer also adds its own keys
+    for (int i = 0; i < numKeys; i++) {
+        counters.emplace(i, 0);
+    }
+    for (int t = 0; t < numWriters; t++) {
+        writers.emplace_back([&counters, t, numKeys]() {
+            for (int i = 0; i < numKeys; i++) {
+                counters.emplace((t + 1) * numKeys + i, 0);
+                counters.perform(i, [](int k, int& v)->bool { v++; return true; });
+            }
+        });
+    }
+    for (auto& w : writers) {
+        w.join();
+    }
+
+    ThreadPool pool(4, 100);
+    pool.Start();
+    size_t numCounted = counters.parallel_for_each_ro(pool,
+            [numWriters](int k, const int& v)->bool { return v == numWriters; });
+    size_t numPurged = counters.parallel_delete_if(pool,
+            [](int k, int& v)->bool { return v == 0; });
+    pool.Stop();
+    pool.Join();
+
+    rc = (int)numCounted == numKeys
+        && (int)numPurged == numWriters * numKeys
+        && (int)counters.size() == numKeys;
+    if (!rc) {
+        if (printFlag) {
+            std::cout << "Striped writes counted " << numCounted
+                  << " and purged " << numPurged << std::endl;
+        }
+        if (assertFlag) {
+            assert(false);
+        }
+        resultString["Concurrent writes"] = "fail";
+        resultString["pass"] = false;
+    } else {
+        resultString["Concurrent writes"] = "pass";
+    }
+
+    if (resultString["pass"] == false) {
+        std::cout << "StripedTSMap Unit Test failed!\n" << std::endl;
+        return resultString;
+    }
+
+    std::cout << "StripedTSMap Unit Test passed!\n" << std::endl;
+    resultString["pass"] = true;
+    return resultString;
+}
+}
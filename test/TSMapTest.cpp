@@ -1067,6 +1067,194 @@ JsonBox::Value testTSMap(bool printFlag, bool assertFlag, bool valgrind)
 
     delete [] threads;
 
+    //*************************************
+    // Partitioned iterators on a ThreadPool
+    // ************************************
+    if (printFlag) {
+        std::cout << "Testing parallel function iterators..." << std::endl;
+    }
+
+    ThreadPool pool(4, 1000);
+    pool.Start();
+
+    TSMap<int, int> testMap5;
+    int numPEntries = valgrind ? 1000 : 100000;
+    for (int i = 0; i < numPEntries; i++) {
+        testMap5.emplace(i, i % 3);
+    }
+
+    size_t numChanged = testMap5.parallel_for_each(pool,
+            [](int k, int& v)->bool {
+                v++;
+                return true;
+            });
+    size_t numTwos = testMap5.parallel_for_each_ro(pool,
+            [](int k, const int& v)->bool {
+                return v == 2;
+            }, 7);
+    size_t numPurged = testMap5.parallel_delete_if(pool,
+            [](int k, int& v)->bool {
+                return v == 1;
+            }, 13);
+
+    pool.Stop();
+    pool.Join();
+
+    int expectedTwos = numPEntries / 3 + (numPEntries % 3 > 1 ? 1 : 0);
+    int expectedOnes = (numPEntries + 2) / 3;
+    if ((int)numChanged != numPEntries || (int)numTwos != expectedTwos
+            || (int)numPurged != expectedOnes
+            || (int)testMap5.size() != numPEntries - expectedOnes
+            || testMap5.find(0).second || !testMap5.find(1).second) {
+        if (printFlag) {
+            std::cout << "Parallel iterators returned " << numChanged << ", "
+                  << numTwos << ", " << numPurged << std::endl;
+        }
+        if (assertFlag) {
+            assert(false);
+        }
+        resultString["Parallel iterators"] = "fail";
+        resultString["pass"] = false;
+    } else {
+        resultString["Parallel iterators"] = "pass";
+    }
+
+    //*************************************
+    // Single-lookup compute/upsert operations
+    // ************************************
+    if (printFlag) {
+        std::cout << "Testing compute/upsert operations..." << std::endl;
+    }
+
+    TSMap<int, std::string> testMap6;
+    int numFactoryCalls = 0;
+    auto factory = [&numFactoryCalls](int k)->std::string {
+        numFactoryCalls++;
+        return std::to_string(k);
+    };
+    auto append = [](std::string& existing, const std::string& v) { existing += v; };
+
+    bool rc = testMap6.try_emplace(1, 3, 'a')
+        && !testMap6.try_emplace(1, 3, 'b')
+        && testMap6.find(1).first == "aaa"
+        && testMap6.compute_if_absent(2, factory) == std::make_pair(std::string("2"), true)
+        && testMap6.compute_if_absent(2, factory) == std::make_pair(std::string("2"), false)
+        && numFactoryCalls == 1
+        && testMap6.upsert(3, "x").second
+        && testMap6.upsert(3, "y", append) == std::make_pair(std::string("xy"), false)
+        && testMap6.upsert(3, "z") == std::make_pair(std::string("z"), false)
+        && testMap6.compute(1, [](int k, std::string& v, bool exists)->bool {
+                v += "!";
+                return exists;
+            }) == std::make_pair(std::string("aaa!"), true)
+        && !testMap6.compute(4, [](int k, std::string& v, bool exists)->bool {
+                return exists;
+            }).second
+        && !testMap6.find(4).second
+        && testMap6.compute(4, [](int k, std::string& v, bool exists)->bool {
+                v = "new";
+                return true;
+            }).second
+        && !testMap6.compute(2, [](int k, std::string& v, bool exists)->bool {
+                return false;
+            }).second
+        && !testMap6.find(2).second
+        && testMap6.size() == 3;
+
+    // Concurrent increments must not lose updates
+    TSMap<int, int> testMap7;
+    const int numComputeThreads = 4;
+    const int numIncrements = valgrind ? 100 : 10000;
+    std::vector<std::thread> computeThreads;
+    for (int t = 0; t < numComputeThreads; t++) {
+        computeThreads.emplace_back([&testMap7, numIncrements]() {
+            for (int i = 0; i < numIncrements; i++) {
+                testMap7.upsert(i % 10, 1, [](int& existing, const int& v) { existing += v; });
+            }
+        });
+    }
+    for (auto& t : computeThreads) {
+        t.join();
+    }
+    int total = 0;
+    testMap7.for_each_ro([&total](int k, const int& v)->bool { total += v; return true; });
+    rc = rc && testMap7.size() == 10 && total == numComputeThreads * numIncrements;
+
+    if (!rc) {
+        if (printFlag) {
+            std::cout << "Compute operations failed" << std::endl;
+        }
+        if (assertFlag) {
+            assert(false);
+        }
+        resultString["Compute operations"] = "fail";
+        resultString["pass"] = false;
+    } else {
+        resultString["Compute operations"] = "pass";
+    }
+
+    //*************************************
+    // Memory usage and compaction
+    // ************************************
+    if (printFlag) {
+        std::cout << "Testing memory_usage() and shrink()..." << std::endl;
+    }
+
+    TSMap<int, int> plainMap;
+    PooledTSMap<int, int> pooledMap;
+    BTreeTSMap<int, int> btreeMap;
+    int numShrinkEntries = valgrind ? 2000 : 100000;
+    for (int i = 0; i < numShrinkEntries; i++) {
+        plainMap.emplace(i, i);
+        pooledMap.emplace(i, i);
+        btreeMap.emplace(i, i);
+    }
+
+    size_t pooledFull = pooledMap.memory_usage();
+    size_t btreeFull = btreeMap.memory_usage();
+    rc = plainMap.memory_usage() > numShrinkEntries * 2 * sizeof(int)
+        && pooledFull > numShrinkEntries * 2 * sizeof(int)
+        && btreeFull > numShrinkEntries * 2 * sizeof(int)
+        && btreeFull < pooledFull;
+
+    // Erasing keeps freed nodes for reuse until the map is compacted
+    auto sparse = [](int k, int& v)->bool { return k % 10 != 0; };
+    plainMap.delete_if(sparse);
+    pooledMap.delete_if(sparse);
+    btreeMap.delete_if(sparse);
+    rc = rc && pooledMap.memory_usage() == pooledFull
+        && pooledMap.shrink() > 0
+        && pooledMap.memory_usage() < pooledFull
+        && btreeMap.shrink() > 0
+        && btreeMap.memory_usage() < btreeFull / 5
+        && plainMap.shrink() == 0;
+
+    for (int i = 0; i < numShrinkEntries; i++) {
+        bool present = i % 10 == 0;
+        if (pooledMap.find(i).second != present || btreeMap.find(i).second != present
+                || plainMap.find(i).second != present) {
+            rc = false;
+            break;
+        }
+    }
+    rc = rc && pooledMap.find(numShrinkEntries / 10 * 10 - 10).first == numShrinkEntries / 10 * 10 - 10
+        && pooledMap.emplace(5, 5) && pooledMap.size() == (size_t)numShrinkEntries / 10 + 1;
+
+    if (!rc) {
+        if (printFlag) {
+            std::cout << "Compaction failed: pooled " << pooledMap.memory_usage()
+                  << " of " << pooledFull << ", btree " << btreeMap.memory_usage()
+                  << " of " << btreeFull << std::endl;
+        }
+        if (assertFlag) {
+            assert(false);
+        }
+        resultString["Memory compaction"] = "fail";
+        resultString["pass"] = false;
+    } else {
+        resultString["Memory compaction"] = "pass";
+    }
+
     //Test getKeyList()
     if (printFlag) {
         std::cout << "Testing getKeyList()..." << std::endl;
@@ -263,6 +263,29 @@ JsonBox::Value testTSQueue(unsigned int numThreads, bool printFlag, bool assertF
         resultString["Dequeue 2"] = "pass";
     }
 
+    // Async waiters get data in order, ahead of the queue
+    int first = 0;
+    int second = 0;
+    int ready = 0;
+    bool now = q.async_dequeue(first, [&ready] { ready++; });
+    now = q.async_dequeue(second, [&ready] { ready++; }) || now;
+    q.enqueue(1);
+    q.enqueue(2);
+    q.enqueue(3);
+    if (now || ready != 2 || first != 1 || second != 2 || q.size() != 1
+            || !q.async_dequeue(result, [&ready] { ready++; }) || result != 3 || ready != 2) {
+        if (printFlag) {
+            std::cout << "Async dequeue got " << first << ", " << second << " with " << ready << " ready" << std::endl;
+        }
+        if (assertFlag) {
+            assert(false);
+        }
+        resultString["Async dequeue"] = "fail";
+        resultString["pass"] = false;
+    } else {
+        resultString["Async dequeue"] = "pass";
+    }
+
     // Test thread safety
     std::thread* t = new std::thread[numThreads];
     if (printFlag) {
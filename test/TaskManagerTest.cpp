@@ -6,6 +6,137 @@
 
 namespace atl {
 
+/**
+* \brief checks that finished results are cached for the TTL, within the
+*        LRU bound, and failures only when asked to
+*
+* \return true if jobs ran exactly when they should
+**/
+bool doTaskManagerCacheThing()
+{
+    std::atomic_int runs(0);
+    auto job = [&runs]() -> int { return runs++; };
+
+    // One shard, so the LRU bound is exact
+    atl::TaskManager<int, int> cache(0.05, 3, false, 1);
+    bool rc = cache.performJob(1, job) == 0 && cache.performJob(1, job) == 0 && runs == 1
+        && cache.cached() == 1;
+
+    // Expired results run again
+    atl::sleep(0.06);
+    rc = rc && cache.performJob(1, job) == 1 && runs == 2;
+
+    // The least recently used result goes first
+    cache.performJob(2, job);
+    cache.performJob(3, job);
+    cache.performJob(1, job);
+    cache.performJob(4, job);
+    rc = rc && cache.cached() == 3 && runs == 5 && cache.performJob(1, job) == 1
+        && cache.performJob(2, job) == 5 && runs == 6;
+
+    rc = rc && cache.invalidate(2) && !cache.invalidate(2) && cache.performJob(2, job) == 6;
+    cache.clearCache();
+    rc = rc && cache.cached() == 0;
+
+    // Failures are forgotten unless they are cached too
+    auto fail = [&runs]() -> int { runs++; throw std::runtime_error("job failed"); };
+    for (int cacheFailures = 0; cacheFailures < 2; cacheFailures++) {
+        cache.setCaching(-1, 0, cacheFailures);
+        int before = runs;
+        for (int i = 0; i < 2; i++) {
+            try {
+                cache.performJob(10, fail);
+                rc = false;
+            } catch (const std::runtime_error&) {
+            }
+        }
+        rc = rc && runs == before + (cacheFailures ? 1 : 2);
+    }
+
+    // Turning caching off drops everything
+    cache.setCaching(0);
+    rc = rc && cache.cached() == 0;
+    if (!rc) {
+        std::cout << "TaskManager caching failed after " << runs << " runs" << std::endl;
+    }
+    return rc;
+}
+
+/**
+* \brief starts jobs for many keys on a pool at once and checks that each
+*        key runs once and the callers do not wait for each other
+*
+* \param threads pool size
+* \return true if every key ran once with the right result
+**/
+bool doTaskManagerAsyncThing(int threads)
+{
+    atl::ThreadPool pool(threads, 10000);
+    atl::TaskManager<int, int> man(-1);
+    pool.Start();
+
+    std::atomic_int runs(0);
+    std::vector<std::shared_future<int>> futures;
+    atl::Timer t;
+    for (int round = 0; round < 4; round++) {
+        for (int key = 0; key < 50; key++) {
+            futures.push_back(man.performJobAsync(pool, key, [&runs, key]() -> int {
+                atl::sleep(0.01);
+                runs++;
+                return key * key;
+            }));
+        }
+    }
+    double started = t.elapsed();
+
+    bool rc = true;
+    for (size_t i = 0; i < futures.size(); i++) {
+        int key = i % 50;
+        rc = rc && futures[i].get() == key * key;
+    }
+
+    // Cached results come back ready, and failures reach every caller
+    rc = rc && runs == 50 && man.cached() == 50 && started < 0.2
+        && man.performJobAsync(pool, 7, [] { return -1; }).get() == 49;
+    std::shared_future<int> failed = man.performJobAsync(pool, 100, []() -> int {
+        throw std::runtime_error("job failed");
+    });
+    try {
+        failed.get();
+        rc = false;
+    } catch (const std::runtime_error&) {
+    }
+
+    // A job cancelled before it starts breaks its future and is forgotten
+    pool.Stop();
+    pool.Join();
+    atl::CancelToken token;
+    std::shared_future<int> dropped = man.performJobAsync(pool, 200, [] { return 1; }, token);
+    rc = rc && man.performJobAsync(pool, 200, [] { return 2; }).valid();
+    token.cancel();
+    pool.Start();
+    try {
+        dropped.get();
+        rc = false;
+    } catch (const std::future_error&) {
+    }
+    rc = rc && pool.getStats().cancelled == 1 && man.performJobAsync(pool, 200, [] { return 3; }).get() == 3;
+
+    // A closed pool drops the job rather than running it on this thread
+    pool.shutdown();
+    std::shared_future<int> closed = man.performJobAsync(pool, 300, [&runs] { return ++runs; });
+    try {
+        closed.get();
+        rc = false;
+    } catch (const std::future_error&) {
+    }
+    rc = rc && runs == 50;
+    if (!rc) {
+        std::cout << "TaskManager async failed after " << runs << " runs, " << man.cached() << " cached, started in " << started << "s" << std::endl;
+    }
+    return rc;
+}
+
 JsonBox::Value testTaskManager(int threads, bool printFlag, bool assertFlag, bool valgrind)
 {
 	JsonBox::Value resultString; //!< Brief JsonBox value with unit test results
@@ -42,7 +173,8 @@ JsonBox::Value testTaskManager(int threads, bool printFlag, bool assertFlag, boo
     double time = t.elapsed();
     std::cout << "elapsed time: " << time << std::endl;
 
-    bool ret = (i < 10 && time < 0.15) || valgrind;
+    bool ret = ((i < 10 && time < 0.15) || valgrind) && doTaskManagerCacheThing()
+        && doTaskManagerAsyncThing(std::min(threads, 8));
     if (!ret) {
         if (printFlag) {
             std::cout << "Test failed!" << std::endl;
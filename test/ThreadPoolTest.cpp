@@ -3,6 +3,9 @@
  **/
 
 #include "AquetiToolsTest.h"
+#ifdef __linux__
+#include <sched.h>
+#endif //__linux__
 
 namespace atl {
     /**
@@ -11,14 +14,18 @@ namespace atl {
 * \param [in] threads the number of threads to be run
 * \return true if the number of threads run equals the number of threads entered
 **/
-bool doThreadPoolThing(int threads)
+bool doThreadPoolThing(int threads, bool workStealing = false)
 {
-    std::cout << threads << " threads: ";
-    atl::ThreadPool tp(threads, 1000);
+    std::cout << threads << " threads" << (workStealing ? " (work stealing): " : ": ");
+    atl::ThreadPool tp(threads, 1000, 1, workStealing);
     std::atomic_int i(0);
+    std::atomic_bool badId(false);
 
     auto fun = [&](){
         i++;
+        if (atl::this_worker() < 0 || atl::this_worker() >= threads) {
+            badId = true;
+        }
         atl::sleep(0.001);
     };
 
@@ -34,7 +41,541 @@ bool doThreadPoolThing(int threads)
 
     tp.Stop();
     tp.Join();
-    return i == 1000;
+    return i == 1000 && !badId && atl::this_worker() == -1;
+}
+
+/**
+* \brief spawns a binary tree of jobs from inside the workers
+*
+* \param [in] threads the number of threads to be run
+* \return true if every job ran, the queue bounds were respected and
+*         unstarted jobs could be deleted
+**/
+bool doWorkStealingThing(int threads)
+{
+    // Leaf jobs far outnumber the injector limit, which nested jobs bypass
+    atl::ThreadPool tp(threads, 4, 1, true);
+    std::atomic_int leaves(0);
+    std::function<void(int)> spawn = [&](int depth) {
+        if (depth == 0) {
+            leaves++;
+            return;
+        }
+        tp.push_job([&spawn, depth] { spawn(depth - 1); });
+        tp.push_job([&spawn, depth] { spawn(depth - 1); });
+    };
+
+    tp.Start();
+    bool rc = tp.push_job([&spawn] { spawn(12); });
+    while (leaves < (1 << 12)) {
+        tp.wait_until_empty(100);
+    }
+    rc = rc && tp.size() == 0
+        && tp.run_partitions(100, [](size_t i) -> size_t { return i; }) == 4950;
+
+    // A throwing partition is rethrown only after every partition has run
+    std::atomic<int> ran(0);
+    bool threw = false;
+    try {
+        tp.run_partitions(100, [&ran](size_t i) -> size_t {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            ran++;
+            if (i % 10 == 3) {
+                throw std::runtime_error("partition failed");
+            }
+            return i;
+        });
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    rc = rc && threw && ran == 100;
+
+    // Full injector refuses external jobs; delete_all drops what never ran
+    tp.wait_until_empty();
+    tp.Stop();
+    tp.Join();
+    int pushed = 0;
+    while (tp.push_job([] {})) {
+        pushed++;
+    }
+    rc = rc && pushed == 4 && tp.size() == 4 && !tp.wait_until_empty(10);
+    tp.delete_all();
+    rc = rc && tp.size() == 0 && tp.wait_until_empty(10);
+
+    if (!rc) {
+        std::cout << "Work-stealing pool failed: " << leaves << " leaves, " << pushed << " pushed" << std::endl;
+    }
+    return rc && leaves == (1 << 12);
+}
+
+/**
+* \brief checks submit() futures and TaskGroup waits
+*
+* \param [in] threads the number of threads to be run
+* \param [in] workStealing the pool mode
+* \return true if results, exceptions and group counts were right
+**/
+bool doTaskGroupThing(int threads, bool workStealing)
+{
+    atl::ThreadPool tp(threads, 8, 1, workStealing);
+    tp.Start();
+
+    // Move-only callable and argument
+    std::unique_ptr<int> seven(new int(7));
+    std::future<int> sum = tp.submit([](std::unique_ptr<int> a, int b) { return *a + b; },
+                                     std::move(seven), 5);
+    std::future<void> thrown = tp.submit([] { throw std::runtime_error("job failed"); });
+    tp.wait(sum);
+    bool rc = sum.get() == 12;
+    try {
+        thrown.get();
+        rc = false;
+    } catch (const std::runtime_error&) {
+    }
+
+    // Groups nested inside jobs; more jobs than the queue holds, and a
+    // one-thread pool, only finish because waiters help
+    std::atomic_int leaves(0);
+    std::function<void(int)> tree = [&](int depth) {
+        if (depth == 0) {
+            leaves++;
+            return;
+        }
+        atl::TaskGroup group(tp);
+        for (int i = 0; i < 4; i++) {
+            group.run([&tree, depth] { tree(depth - 1); });
+        }
+        group.wait();
+    };
+    std::future<void> root = tp.submit([&tree] { tree(4); });
+    tp.wait(root);
+    rc = rc && leaves == 256;
+
+    // A group only waits for its own jobs. The blocker must be on a worker
+    // before the group starts, or the waiting thread could pick it up.
+    std::atomic_bool started(false);
+    std::atomic_bool release(false);
+    std::future<void> blocker = tp.submit([&started, &release] {
+        started = true;
+        while (!release) {
+            std::this_thread::yield();
+        }
+    });
+    while (!started) {
+        std::this_thread::yield();
+    }
+    atl::TaskGroup group(tp);
+    std::atomic_int ran(0);
+    for (int i = 0; i < 20; i++) {
+        group.run([&ran] { ran++; });
+    }
+    group.wait();
+    rc = rc && ran == 20 && group.pending() == 0
+        && blocker.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+    release = true;
+    tp.wait(blocker);
+
+    group.run([] { throw std::logic_error("group job failed"); });
+    try {
+        group.wait();
+        rc = false;
+    } catch (const std::logic_error&) {
+    }
+
+    tp.Stop();
+    tp.Join();
+    if (!rc) {
+        std::cout << "submit/TaskGroup failed with " << threads << " threads, "
+                  << leaves << " leaves, " << ran << " ran" << std::endl;
+    }
+    return rc;
+}
+
+/**
+* \brief runs a fan-out/fan-in TaskGraph for several frames
+*
+* \param [in] threads the number of threads to be run
+* \param [in] workStealing the pool mode
+* \return true if every node ran once per frame after its predecessors
+**/
+bool doTaskGraphThing(int threads, bool workStealing)
+{
+    atl::ThreadPool tp(threads, 4, 1, workStealing);
+    tp.Start();
+
+    const int tiles = 16;
+    std::atomic_int stage(0);
+    std::atomic_int tilesDone(0);
+    std::atomic_bool badOrder(false);
+    int frames = 0;
+
+    atl::TaskGraph graph(tp);
+    atl::TaskGraph::Node first = graph.add([&] {
+        tilesDone = 0;
+        stage = 1;
+    });
+    atl::TaskGraph::Node last = graph.add([&] {
+        if (tilesDone != tiles) {
+            badOrder = true;
+        }
+        frames++;
+    });
+    for (int i = 0; i < tiles; i++) {
+        atl::TaskGraph::Node tile = graph.add([&] {
+            if (stage != 1) {
+                badOrder = true;
+            }
+            tilesDone++;
+        });
+        graph.precede(first, tile);
+        graph.precede(tile, last);
+    }
+
+    // More ready tiles than the queue holds, so some run inline
+    bool rc = true;
+    for (int i = 0; i < 50; i++) {
+        rc = graph.run() && rc;
+        graph.wait();
+        stage = 0;
+    }
+    rc = rc && frames == 50 && !badOrder && !graph.isRunning();
+
+    // A throwing node skips what depends on it
+    atl::TaskGraph failing(tp);
+    std::atomic_int after(0);
+    atl::TaskGraph::Node thrower = failing.add([] { throw std::runtime_error("node failed"); });
+    failing.precede(thrower, failing.add([&after] { after++; }));
+    failing.run();
+    try {
+        failing.wait();
+        rc = false;
+    } catch (const std::runtime_error&) {
+    }
+    rc = rc && after == 0;
+
+    // Cycles are refused
+    atl::TaskGraph cycle(tp);
+    atl::TaskGraph::Node a = cycle.add([] {});
+    atl::TaskGraph::Node b = cycle.add([] {});
+    cycle.precede(a, b);
+    cycle.precede(b, a);
+    rc = rc && !cycle.run() && !cycle.precede(a, a);
+
+    tp.Stop();
+    tp.Join();
+    if (!rc) {
+        std::cout << "TaskGraph failed with " << threads << " threads, "
+                  << frames << " frames" << std::endl;
+    }
+    return rc;
+}
+
+/**
+* \brief grows a scaling pool under a burst of slow jobs and lets it shrink
+*        back when the burst is over
+*
+* \param [in] workStealing the pool mode
+* \return true if the pool stayed in its bounds, grew and shrank
+**/
+bool doScalingThing(bool workStealing)
+{
+    atl::ThreadPool tp(2, 1000, 1, workStealing);
+    tp.setScaling(1, 6, 0.005, 0.05);
+    tp.Start();
+    bool rc = tp.getNumWorkers() == 2;
+
+    std::atomic_int ran(0);
+    unsigned most = 0;
+    for (int i = 0; i < 100; i++) {
+        tp.push_job([&ran] {
+            atl::sleep(0.002);
+            ran++;
+        });
+    }
+    while (ran < 100) {
+        most = std::max(most, tp.getNumWorkers());
+        atl::sleep(0.001);
+    }
+    rc = rc && most > 2 && most <= 6;
+
+    // Parked workers retire down to the minimum, which still runs jobs
+    atl::Timer t;
+    while (tp.getNumWorkers() > 1 && t.elapsed() < 5) {
+        atl::sleep(0.01);
+    }
+    unsigned parked = tp.getNumWorkers();
+    std::future<int> last = tp.submit([] { return 3; });
+    rc = rc && parked == 1 && last.wait_for(std::chrono::seconds(5)) == std::future_status::ready;
+
+    // Raising the minimum adds workers at once
+    tp.setScaling(3, 6, 0.005, 10);
+    rc = rc && tp.getNumWorkers() == 3;
+
+    tp.Stop();
+    tp.Join();
+    rc = rc && tp.getNumWorkers() == 0;
+    if (!rc) {
+        std::cout << "Scaling failed" << (workStealing ? " (work stealing)" : "") << ": grew to "
+                  << most << ", shrank to " << parked << std::endl;
+    }
+    return rc;
+}
+
+/**
+* \brief cancels queued jobs, lets deadlines pass and stops a running job
+*        through its token
+*
+* \param [in] workStealing the pool mode
+* \return true if exactly the live jobs ran and the drops were counted
+**/
+bool doCancelThing(bool workStealing)
+{
+    atl::ThreadPool tp(1, 1000, 1, workStealing);
+    std::atomic_int ran(0);
+    auto job = [&ran] { ran++; };
+
+    // Queued while stopped, so every token is checked at dequeue
+    atl::CancelToken cancelled;
+    atl::CancelToken expired(0.01);
+    atl::CancelToken live(10);
+    for (int i = 0; i < 10; i++) {
+        tp.push_job(job, cancelled);
+        tp.push_job(job, expired);
+        tp.push_job(job, live);
+        tp.push_job(job);
+    }
+    cancelled.cancel();
+    atl::sleep(0.02);
+    bool rc = tp.push_job(job, cancelled) && tp.getStats().cancelled == 1;
+
+    // A running job polls its token
+    atl::CancelToken stop;
+    std::atomic_bool stopped(false);
+    tp.Start();
+    tp.wait_until_empty();
+    tp.push_job([stop, &stopped] {
+        while (!stop.cancelled()) {
+            atl::sleep(0.001);
+        }
+        stopped = true;
+    }, stop);
+    atl::sleep(0.01);
+    stop.cancel();
+    atl::Timer t;
+    while (!stopped && t.elapsed() < 5) {
+        atl::sleep(0.001);
+    }
+
+    tp.Stop();
+    tp.Join();
+    atl::ThreadPoolStats stats = tp.getStats();
+    rc = rc && stopped && ran == 20 && stats.cancelled == 21 && stats.queued == 0;
+    if (!rc) {
+        std::cout << "Cancel failed" << (workStealing ? " (work stealing)" : "") << ": ran " << ran
+                  << ", cancelled " << stats.cancelled << std::endl;
+    }
+    return rc;
+}
+
+/**
+* \brief runs spinning and sleeping jobs and checks that each worker's
+*        counts, busy, idle and CPU times add up
+*
+* \return true if the accounting matches the jobs
+**/
+bool doAccountingThing()
+{
+    atl::ThreadPool tp(2, 1000);
+    tp.Start();
+
+    // Spinning jobs use CPU, sleeping ones are busy without it
+    for (int i = 0; i < 10; i++) {
+        tp.push_job([] {
+            double start = atl::getThreadCpuTime();
+            while (atl::getThreadCpuTime() - start < 0.005) {
+            }
+        });
+        tp.push_job([] { atl::sleep(0.005); });
+    }
+    tp.wait_until_empty();
+    atl::sleep(0.05);
+    tp.Stop();
+    tp.Join();
+
+    atl::ThreadPoolStats stats = tp.getStats();
+    uint64_t jobs = 0;
+    double busy = 0;
+    double idle = 0;
+    double cpu = 0;
+    double longest = 0;
+    for (auto& w : stats.perWorker) {
+        jobs += w.jobs;
+        busy += w.busy;
+        idle += w.idle;
+        cpu += w.cpu;
+        longest = std::max(longest, w.longestJob);
+    }
+    bool rc = stats.perWorker.size() == 2 && !stats.perWorker[0].running && jobs == 20
+        && busy >= 0.1 && cpu >= 0.05 && cpu < busy && idle > 0.05 && longest >= 0.005;
+    tp.report();
+    if (!rc) {
+        std::cout << "Accounting failed: " << jobs << " jobs, " << busy << "s busy, " << idle << "s idle, "
+                  << cpu << "s cpu, longest " << longest << "s" << std::endl;
+    }
+    return rc;
+}
+
+/**
+* \brief shuts pools down with and without draining and with a deadline,
+*        checking that every job either ran or came back
+*
+* \param [in] workStealing the pool mode
+* \return true if no job was lost and no shutdown stalled
+**/
+bool doShutdownThing(bool workStealing)
+{
+    std::atomic_int ran(0);
+    auto job = [&ran] {
+        atl::sleep(0.005);
+        ran++;
+    };
+
+    // Draining runs everything on every worker and then refuses new jobs
+    atl::ThreadPool drained(4, 1000, 1, workStealing);
+    drained.Start();
+    for (int i = 0; i < 40; i++) {
+        drained.push_job(job);
+    }
+    atl::Timer t;
+    bool rc = drained.shutdown().empty() && ran == 40 && t.elapsed() < 0.5 && !drained.push_job(job);
+
+    // A closed pool breaks submitted futures instead of running the job here
+    std::future<void> refused = drained.submit(job);
+    try {
+        refused.get();
+        rc = false;
+    } catch (const std::future_error& e) {
+        rc = rc && e.code() == std::future_errc::broken_promise;
+    }
+    rc = rc && ran == 40;
+
+    // A fast shutdown finishes the running job and hands back the rest
+    ran = 0;
+    atl::ThreadPool fast(1, 1000, 1, workStealing);
+    fast.Start();
+    for (int i = 0; i < 40; i++) {
+        fast.push_job(job);
+    }
+    atl::sleep(0.01);
+    t.start();
+    std::vector<std::function<void()>> left = fast.shutdown(false);
+    double fastTime = t.elapsed();
+    rc = rc && fastTime < 0.05 && ran + left.size() == 40 && left.size() > 30;
+
+    // Draining stops at the deadline
+    ran = 0;
+    atl::ThreadPool late(1, 1000, 1, workStealing);
+    late.Start();
+    for (int i = 0; i < 40; i++) {
+        late.push_job(job);
+    }
+    t.start();
+    left = late.shutdown(true, 0.05);
+    rc = rc && t.elapsed() < 0.15 && ran + left.size() == 40 && ran > 0 && !left.empty();
+    for (auto& f : left) {
+        f();
+    }
+    rc = rc && ran == 40;
+
+    // Parked workers wake at once, and the pool restarts
+    atl::ThreadPool idle(4, 1000, 1, workStealing);
+    idle.Start();
+    atl::sleep(0.01);
+    t.start();
+    rc = rc && idle.shutdown(false).empty() && t.elapsed() < 0.05 && idle.Start() && idle.push_job(job);
+    idle.shutdown();
+
+    if (!rc) {
+        std::cout << "Shutdown failed" << (workStealing ? " (work stealing)" : "") << ": fast stop took "
+                  << fastTime << "s, " << ran << " ran" << std::endl;
+    }
+    return rc;
+}
+
+/**
+* \brief runs a parallel TSMap pass while every worker is busy, so the
+*        calling thread takes all partitions and the helpers stay queued
+*
+* \param [in] workStealing the pool mode
+* \return true if the stale helpers were neither counted nor handed back
+**/
+bool doPartitionHelperThing(bool workStealing)
+{
+    atl::ThreadPool tp(2, 100, 1, workStealing);
+    atl::TSMap<int, int> map;
+    for (int i = 0; i < 1000; i++) {
+        map.emplace(i, i);
+    }
+
+    tp.Start();
+    std::atomic_int started(0);
+    std::atomic_bool release(false);
+    for (int i = 0; i < 2; i++) {
+        tp.push_job([&started, &release] {
+            started++;
+            while (!release) {
+                std::this_thread::yield();
+            }
+        });
+    }
+    while (started < 2) {
+        std::this_thread::yield();
+    }
+
+    size_t visited = map.parallel_for_each(tp, [](int k, int& v) { v++; return true; }, 8);
+    bool rc = visited == 1000 && tp.size() == 0 && tp.getStats().queued == 0;
+    release = true;
+
+    // Stale helpers are not jobs to drain or hand back, so a destructor
+    // would not warn about them
+    rc = rc && tp.shutdown(false).empty() && tp.size() == 0;
+    if (!rc) {
+        std::cout << "run_partitions left helpers counted" << (workStealing ? " (work stealing)" : "")
+                  << ": " << visited << " visited, " << tp.size() << " queued" << std::endl;
+    }
+    return rc;
+}
+
+/**
+* \brief runs a pool with one pinned worker per physical core
+*
+* \return true if the workers were pinned and named and ran jobs
+**/
+bool doPlacementThing()
+{
+    atl::ThreadPool tp(1, 100, 1, true);
+    if (!tp.pinToPhysicalCores(0) || tp.getNumThreads() != atl::physicalCoreCpus(0).size()) {
+        std::cout << "No physical cores on node 0" << std::endl;
+        return false;
+    }
+    tp.Start();
+    std::future<int> cpus = tp.submit([] {
+        int count = 1;
+#ifdef __linux__
+        cpu_set_t set;
+        sched_getaffinity(0, sizeof(set), &set);
+        count = CPU_COUNT(&set);
+#endif
+        return count;
+    });
+    tp.wait(cpus);
+    bool rc = cpus.get() == 1 && tp.getPlacement().name == "atlpool" && tp.getPlacement().numaNode == 0;
+    tp.Stop();
+    tp.Join();
+    if (!rc) {
+        std::cout << "Pool workers were not pinned" << std::endl;
+    }
+    return rc;
 }
 
 /**
@@ -48,6 +589,27 @@ JsonBox::Value testThreadPool()
 
     bool ret = doThreadPoolThing(5);
     ret = doThreadPoolThing(1) && ret;
+    ret = doThreadPoolThing(5, true) && ret;
+    ret = doThreadPoolThing(1, true) && ret;
+    ret = doWorkStealingThing(4) && ret;
+    ret = doWorkStealingThing(1) && ret;
+    ret = doTaskGroupThing(4, false) && ret;
+    ret = doTaskGroupThing(1, false) && ret;
+    ret = doTaskGroupThing(4, true) && ret;
+    ret = doTaskGroupThing(1, true) && ret;
+    ret = doTaskGraphThing(4, false) && ret;
+    ret = doTaskGraphThing(1, false) && ret;
+    ret = doTaskGraphThing(4, true) && ret;
+    ret = doScalingThing(false) && ret;
+    ret = doScalingThing(true) && ret;
+    ret = doCancelThing(false) && ret;
+    ret = doCancelThing(true) && ret;
+    ret = doAccountingThing() && ret;
+    ret = doShutdownThing(false) && ret;
+    ret = doShutdownThing(true) && ret;
+    ret = doPartitionHelperThing(false) && ret;
+    ret = doPartitionHelperThing(true) && ret;
+    ret = doPlacementThing() && ret;
 
     if (!ret) {
         std::cout << "Threadpool test failed." << std::endl;
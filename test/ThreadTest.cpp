@@ -3,6 +3,11 @@
  **/
 
 #include "AquetiToolsTest.h"
+#include "ThreadWorker.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif //_WIN32
 
 namespace atl {
 /**
@@ -77,6 +82,84 @@ JsonBox::Value testThread(bool printFlag)
         threadVect[i].Join();
     }
 
+    // Event-driven worker: runs only when woken, by each kind of source
+    std::atomic_int calls(0);
+    std::atomic_int sum(0);
+    std::atomic_int bytes(0);
+    TSQueue<int> queue;
+    int fds[2] = {-1, -1};
+#ifndef _WIN32
+    rc = pipe(fds) == 0 && fcntl(fds[0], F_SETFL, O_NONBLOCK) == 0;
+#endif //_WIN32
+    ThreadWorker worker([&] {
+        calls++;
+        int value;
+        while (queue.dequeue(value, 0)) {
+            sum += value;
+        }
+#ifndef _WIN32
+        char buffer[16];
+        ssize_t n;
+        while (fds[0] >= 0 && (n = read(fds[0], buffer, sizeof(buffer))) > 0) {
+            bytes += (int)n;
+        }
+#endif //_WIN32
+    });
+    auto waitFor = [](std::function<bool()> done) {
+        Timer t;
+        while (!done() && t.elapsed() < 5) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return done();
+    };
+
+    worker.setEventDriven(true);
+    worker.Start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    rc = rc && calls == 0;
+
+    worker.notify();
+    rc = rc && waitFor([&] { return calls >= 1; });
+
+    worker.watch(queue);
+    for (int i = 1; i <= 100; i++) {
+        queue.enqueue(i);
+    }
+    rc = rc && waitFor([&] { return sum == 5050; });
+
+#ifndef _WIN32
+    rc = rc && worker.watchFd(fds[0]) && write(fds[1], "wake", 4) == 4
+        && waitFor([&] { return bytes == 4; });
+#endif //_WIN32
+
+    int before = calls;
+    worker.setPeriod(0.005);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    worker.setPeriod(0);
+    int timed = calls - before;
+    rc = rc && timed >= 3 && timed <= 40;
+
+    Timer stopTimer;
+    worker.unwatch(queue);
+    worker.Stop();
+    worker.Join();
+    rc = rc && stopTimer.elapsed() < 1;
+#ifndef _WIN32
+    close(fds[0]);
+    close(fds[1]);
+#endif //_WIN32
+
+    if (!rc) {
+        if (printFlag) {
+            std::cout << "Event-driven worker failed: " << calls << " calls, sum " << sum
+                      << ", " << bytes << " bytes, " << timed << " timed runs" << std::endl;
+        }
+        resultString["EventDriven"] = "fail";
+        resultString["pass"] = false;
+    } else {
+        resultString["EventDriven"] = "pass";
+    }
+
     if (resultString["pass"] == false) {
         return resultString;
     }
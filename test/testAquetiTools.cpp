@@ -4,7 +4,11 @@
 
 #include "AquetiToolsTest.h"
 
-std::vector<std::string> unitList{"Timer", "CRC", "Thread", "MultiThread", "ThreadPool", "LruCache", "TSMap", "TSQueue", "TaskManager", "StringTools", "FileIO"}; //!< List of units that tests must be run on 
+std::vector<std::string> unitList{"Timer", "CRC", "Thread", "MultiThread", "ThreadPool", "Parallel", "Scheduler", "Pipeline", "LruCache", "SharedMutex", "LockProfiler", "SpinLock", "TSMap", "BTreeMap", "StripedTSMap", "TSQueue", "TaskManager", "StringTools", "FileIO"
+#ifdef USE_COROUTINES
+    , "Coroutine"
+#endif
+}; //!< List of units that tests must be run on 
 
 /**
  * \brief prints out help to user